@@ -49,7 +49,7 @@ sub mk_rsock {
 sub send_benchmark {
     print "Starting send benchmark\n";
 
-    my ($lib, $file, $saddr, $raddr, $port, $iter, $threads, $gen_recv, $e, $format, $srtp, @fps_vals) = @_;
+    my ($lib, $file, $saddr, $raddr, $port, $iter, $threads, $gen_recv, $e, $format, $srtp, $nal_index, $stream, $pacing, $mmsg, $lean, @fps_vals) = @_;
     my ($socket, $remote, $data);
     my @execs = split ",", $e;
 
@@ -83,15 +83,34 @@ sub send_benchmark {
                 {
                     $logname = "send_$format" . "_SRTP" . "_$thread" . "threads_$fps". "fps_$iter" . "rounds";
                 }
+                $logname .= "_nalindex" if $nal_index;
+                $logname .= "_stream" if $stream;
+                $logname .= "_lean" if $lean;
+                $logname .= "_mmsg" if $mmsg;
+                $logname .= "_trace" . (split "@", $pacing)[-1] . "x" if $pacing;
+
+                # <fps>@<trace>@<speed>, see get_send_schedule()
+                my $fps_arg = $pacing ? "$fps$pacing" : $fps;
 
                 my $result_file = "$lib/results/$logname";
 
                 unlink $result_file if -e $result_file; # erase old results if they exist
+                unlink "${result_file}_cpu" if -e "${result_file}_cpu";
+                unlink "${result_file}_stream" if -e "${result_file}_stream";
+                unlink "${result_file}_setup" if -e "${result_file}_setup";
+
+                my $nal_mode = $nal_index ? "index" : "";
+                $nal_mode = ($nal_index ? "index" : "scan") . "+stream" if $stream;
+                # [lean][+mmsg] of the ffmpeg sender
+                my @ffmpeg_mode = ();
+                push @ffmpeg_mode, "lean" if $lean;
+                push @ffmpeg_mode, "mmsg" if $mmsg;
+                $nal_mode = join "+", @ffmpeg_mode if @ffmpeg_mode;
 
                 for ((1 .. $iter)) {
                     print "Starting to benchmark sending at $fps fps, round $_\n";
                     $remote->recv($data, 16);
-                    my $exit_code = system ("(time ./$lib/$exec $file $result_file $saddr $port $raddr $port $thread $fps $format $srtp) 2>> $result_file");
+                    my $exit_code = system ("(time ./$lib/$exec $file $result_file $saddr $port $raddr $port $thread $fps_arg $format $srtp $nal_mode) 2>> $result_file");
                     $remote->send("end") if $gen_recv;
                     
                     die "Sender failed! \n" if ($exit_code ne 0);
@@ -106,7 +125,7 @@ sub send_benchmark {
 
 sub recv_benchmark {
     print "Receive benchmark\n";
-    my ($lib, $saddr, $raddr, $port, $iter, $threads, $e, $format, $srtp, @fps_vals) = @_;
+    my ($lib, $saddr, $raddr, $port, $iter, $threads, $e, $format, $srtp, $mmsg, @fps_vals) = @_;
     
     print "Connecting to the TCP socket of the sender\n";
     my $socket = mk_rsock($saddr, $port);
@@ -137,7 +156,9 @@ sub recv_benchmark {
                 {
                     $logname = "recv_$format" . "_SRTP" . "_$thread" . "threads_$fps". "fps_$iter" . "rounds";
                 }
+                $logname .= "_mmsg" if $mmsg;
 
+                my $io_mode = $mmsg ? "mmsg" : "";
                 my $result_file = "$lib/results/$logname";
 
                 unlink $result_file if -e $result_file; # erase old results if they exist
@@ -147,7 +168,7 @@ sub recv_benchmark {
                     print "Starting to benchmark receive at $fps fps, round $_\n";
                     $socket->send("start"); # I believe this is used to avoid firewall from blocking traffic
                     # please note that the local address for receiver is raddr
-                    my $exit_code = system ("(time ./$lib/receiver $result_file $raddr $port $saddr $port $thread $format $srtp) 2>> $result_file");
+                    my $exit_code = system ("(time ./$lib/receiver $result_file $raddr $port $saddr $port $thread $format $srtp $io_mode) 2>> $result_file");
                     die "Receiver failed! \n" if ($exit_code ne 0);
                 }
             }
@@ -161,7 +182,7 @@ sub recv_benchmark {
 sub vpcc_send_benchmark {
     print "V-PCC benchmark sender\n";
 
-    my ($lib, $file, $saddr, $raddr, $port, $iter, $threads, $gen_recv, $e, $format, $srtp, @fps_vals) = @_;
+    my ($lib, $file, $saddr, $raddr, $port, $iter, $threads, $gen_recv, $e, $format, $srtp, $objects, @fps_vals) = @_;
     my ($socket, $remote, $data);
     my @execs = split ",", $e;
 
@@ -195,6 +216,7 @@ sub vpcc_send_benchmark {
                 {
                     $logname = "send_$format" . "_SRTP" . "_$thread" . "threads_$fps". "fps_$iter" . "rounds";
                 }
+                $logname .= "_$objects" . "objects" if $objects > 1;
 
                 my $result_file = "$lib/results/$logname";
 
@@ -203,7 +225,7 @@ sub vpcc_send_benchmark {
                 for ((1 .. $iter)) {
                     print "Starting to benchmark sending at $fps fps, round $_\n";
                     $remote->recv($data, 16);
-                    my $exit_code = system ("(time ./$lib/$exec $file $result_file $saddr $port $raddr $port $thread $fps $format $srtp) 2>> $result_file");
+                    my $exit_code = system ("(time ./$lib/$exec $file $result_file $saddr $port $raddr $port $thread $fps $format $srtp $objects) 2>> $result_file");
                     $remote->send("end") if $gen_recv;
                     
                     die "Sender failed! \n" if ($exit_code ne 0);
@@ -218,7 +240,7 @@ sub vpcc_send_benchmark {
 
 sub vpcc_recv_benchmark {
     print "V-PCC benchmark receiver\n";
-    my ($lib, $saddr, $raddr, $port, $iter, $threads, $e, $format, $srtp, @fps_vals) = @_;
+    my ($lib, $saddr, $raddr, $port, $iter, $threads, $e, $format, $srtp, $layout, $objects, $file, @fps_vals) = @_;
     
     print "Connecting to the TCP socket of the sender\n";
     my $socket = mk_rsock($saddr, $port);
@@ -249,6 +271,7 @@ sub vpcc_recv_benchmark {
                 {
                     $logname = "recv_$format" . "_SRTP" . "_$thread" . "threads_$fps". "fps_$iter" . "rounds";
                 }
+                $logname .= "_$objects" . "objects" if $objects > 1;
 
                 my $result_file = "$lib/results/$logname";
 
@@ -259,7 +282,10 @@ sub vpcc_recv_benchmark {
                     print "Starting to benchmark receive at $fps fps, round $_\n";
                     $socket->send("start"); # I believe this is used to avoid firewall from blocking traffic
                     # please note that the local address for receiver is raddr
-                    my $exit_code = system ("(time ./$lib/vpcc_receiver $result_file $raddr $port $saddr $port $thread $format $srtp) 2>> $result_file");
+                    my $args = "$layout $objects";
+                    # the reconstruction receiver verifies the received GoPs against a copy of the sent file
+                    $args = "$file" if $exec eq "vpcc_reconstruct_receiver";
+                    my $exit_code = system ("(time ./$lib/$exec $result_file $raddr $port $saddr $port $thread $format $srtp $args) 2>> $result_file");
                     die "Receiver failed! \n" if ($exit_code ne 0);
                 }
             }
@@ -313,7 +339,7 @@ sub recv_generic {
 
 sub send_latency {
     
-    my ($lib, $file, $saddr, $raddr, $port, $fps, $iter, $format, $srtp) = @_;
+    my ($lib, $file, $saddr, $raddr, $port, $fps, $iter, $format, $srtp, $nal_index, $pacing) = @_;
     my ($socket, $remote, $data);
     print "Latency send benchmark for $lib\n";
     
@@ -329,8 +355,11 @@ sub send_latency {
     {
         $logname = "latencies_$format" . "_SRTP_$fps". "fps_$iter" . "rounds";
     }
+    $logname .= "_nalindex" if $nal_index;
+    $logname .= "_trace" . (split "@", $pacing)[-1] . "x" if $pacing;
     
-
+    my $fps_arg = $pacing ? "$fps$pacing" : $fps;
+    my $nal_mode = $nal_index ? "index" : "";
     
     my $result_file = "$lib/results/$logname";
     unlink $result_file if -e $result_file; # erase old results if they exist
@@ -339,7 +368,7 @@ sub send_latency {
         print "Latency send benchmark round $_" . "/$iter\n";
         $remote->recv($data, 16);
         
-        my $exit_code = system ("./$lib/latency_sender $file $saddr $port $raddr $port $fps $format $srtp 2>> $result_file 2>&1");
+        my $exit_code = system ("./$lib/latency_sender $file $saddr $port $raddr $port $fps_arg $format $srtp $nal_mode 2>> $result_file 2>&1");
         die "Latency sender failed! \n" if ($exit_code ne 0);
     }
     print "Latency send benchmark finished\n";
@@ -370,7 +399,7 @@ sub recv_latency {
 
 sub vpcc_send_latency {
     
-    my ($lib, $file, $saddr, $raddr, $port, $fps, $iter, $format, $srtp) = @_;
+    my ($lib, $file, $saddr, $raddr, $port, $fps, $iter, $format, $srtp, $objects) = @_;
     my ($socket, $remote, $data);
     print "VPCC latency send benchmark for $lib\n";
     
@@ -386,6 +415,7 @@ sub vpcc_send_latency {
     {
         $logname = "latencies_$format" . "_SRTP_$fps". "fps_$iter" . "rounds";
     }
+    $logname .= "_$objects" . "objects" if $objects > 1;
     
 
     
@@ -396,7 +426,7 @@ sub vpcc_send_latency {
         print "Latency send benchmark round $_" . "/$iter\n";
         $remote->recv($data, 16);
         
-        my $exit_code = system ("./$lib/vpcc_latency_sender $file $saddr $port $raddr $port $fps $format $srtp 2>> $result_file 2>&1");
+        my $exit_code = system ("./$lib/vpcc_latency_sender $file $saddr $port $raddr $port $fps $format $srtp $objects 2>> $result_file 2>&1");
         die "Latency sender failed! \n" if ($exit_code ne 0);
     }
     print "VPCC latency send benchmark finished\n";
@@ -404,7 +434,7 @@ sub vpcc_send_latency {
 }
 
 sub vpcc_recv_latency {
-    my ($lib, $saddr, $raddr, $port, $iter, $format, $srtp) = @_;
+    my ($lib, $saddr, $raddr, $port, $iter, $format, $srtp, $layout, $objects) = @_;
     print "VPCC latency receive benchmark for $lib\n";
     
     unless(-e "./$lib/vpcc_latency_receiver") {
@@ -418,7 +448,7 @@ sub vpcc_recv_latency {
         sleep 1; # 1 s, make sure the sender has managed to catch up
         $socket->send("start");
         
-        my $exit_code = system ("./$lib/vpcc_latency_receiver $raddr $port $saddr $port $format $srtp");
+        my $exit_code = system ("./$lib/vpcc_latency_receiver $raddr $port $saddr $port $format $srtp $layout $objects");
         die "Latency receiver failed! \n" if ($exit_code ne 0);
     }
     print "VPCC latency receive benchmark finished\n";
@@ -428,7 +458,7 @@ sub vpcc_recv_latency {
 # TODO explain every parameter
 sub print_help {
     print "usage (benchmark):\n  ./benchmark.pl \n"
-    . "\t--lib     <uvgrtp|ffmpeg|live555>\n"
+    . "\t--lib     <uvgrtp|ffmpeg|live555|gstreamer>\n"
     . "\t--role    <send|recv>\n"
     . "\t--file    <test filename> make sure you also have the companion file\n"
     . "\t--saddr   <sender address>\n"
@@ -437,6 +467,14 @@ sub print_help {
     . "\t--threads <# of threads>\n"
     . "\t--srtp\n"
     . "\t--format  <hevc/vvc> \n"
+    . "\t--layout  <V3C sub-bitstream layout printed by the vpcc sender> (vpcc receivers)\n"
+    . "\t--trace     <trace file|index> Send frames at the times of a trace instead of at a constant fps\n"
+    . "\t--speed     <x> Play the trace x times faster (defaults to 1)\n"
+    . "\t--stream    (uvgrtp goodput sender only) Read the file while sending instead of loading it into memory\n"
+    . "\t--nal-index (uvgrtp sender only) Push each NAL unit from the chunk index separately, without start code lookup\n"
+    . "\t--mmsg    (ffmpeg goodput only) Send and receive through a custom AVIOContext with sendmmsg/recvmmsg\n"
+    . "\t--lean    (ffmpeg goodput sender only) Set up the streams without an encoder context and picture buffer\n"
+    . "\t--objects <# of point cloud objects streamed at once> (vpcc only). The sender accepts comma separated files\n"
     . "\t--start   <start fps>\n"
     . "\t--end     <end fps>\n\n"
     . "\t--fps     <a list of individual fps values> Alternative to --start and --end\n\n"
@@ -452,7 +490,7 @@ sub print_help {
     . "\t--format  <hevc/vvc> \n"
     . "\t--fps <the fps at which benchmarking is done>\n"
     . "\t--rounds  <how many times the test is run>\n"
-    . "\t--lib <uvgrtp|ffmpeg|live555>\n\n" and exit;
+    . "\t--lib <uvgrtp|ffmpeg|live555|gstreamer>\n\n" and exit;
 }
 
 GetOptions(
@@ -473,6 +511,14 @@ GetOptions(
     "srtp"                       => \(my $srtp = 0),
     "exec=s"                     => \(my $exec = "default"),
     "format|form=s"              => \(my $format = ""),
+    "layout=s"                   => \(my $layout = "default"),
+    "objects=i"                  => \(my $objects = 1),
+    "nal-index"                  => \(my $nal_index = 0),
+    "stream"                     => \(my $stream = 0),
+    "mmsg"                       => \(my $mmsg = 0),
+    "lean"                       => \(my $lean = 0),
+    "trace=s"                    => \(my $trace = ""),
+    "speed=f"                    => \(my $speed = 1),
     "help"                       => \(my $help = 0)
 ) or die "failed to parse command line!\n";
 
@@ -483,9 +529,18 @@ $raddr = $DEFAULT_ADDR if !$raddr;
 print_help() if ((!$start or !$end) and !$fps) and !$lat;
 die "Please specify library with --lib" if !$lib;
 die "Please specify role with --role" if !$role;
+die "--nal-index is only supported by the uvgrtp sender" if $nal_index and $lib ne "uvgrtp";
+die "--stream is only supported by the uvgrtp goodput sender" if $stream and ($lib ne "uvgrtp" or $lat);
+die "--mmsg is only supported by the ffmpeg goodput sender and receiver" if $mmsg and ($lib ne "ffmpeg" or $lat);
+die "--mmsg does not support --srtp" if $mmsg and $srtp;
+die "--lean is only supported by the ffmpeg goodput sender" if $lean and ($lib ne "ffmpeg" or $lat);
+die "--trace is only supported by the uvgrtp and gstreamer latency senders" if $trace and $lat and $lib ne "uvgrtp" and $lib ne "gstreamer";
+
+# appended to the fps given to the senders
+my $pacing = $trace ? "\@$trace\@$speed" : "";
 
 
-die "library not supported\n" if !grep (/$lib/, ("uvgrtp", "ffmpeg", "live555"));
+die "library not supported\n" if !grep (/$lib/, ("uvgrtp", "ffmpeg", "live555", "gstreamer"));
 die "format not supported\n"  if !grep (/$format/, ("hevc", "vvc", "h265", "h266", "atlas", "vpcc"));
 
 $fps = 30.0 if $lat and !$fps;
@@ -523,11 +578,11 @@ if ($role eq "send" or $role eq "sender") {
     if ($lat) {
         if($format eq "vpcc") {
             system "make $lib" . "_vpcc_latency_sender";
-            vpcc_send_latency($lib, $file, $saddr, $raddr, $port, $fps, $iter, $format, $srtp);  
+            vpcc_send_latency($lib, $file, $saddr, $raddr, $port, $fps, $iter, $format, $srtp, $objects);  
         }
         else {
             system "make $lib" . "_latency_sender";
-            send_latency($lib, $file, $saddr, $raddr, $port, $fps, $iter, $format, $srtp);  
+            send_latency($lib, $file, $saddr, $raddr, $port, $fps, $iter, $format, $srtp, $nal_index, $pacing);  
         }
 
     } else {
@@ -536,14 +591,14 @@ if ($role eq "send" or $role eq "sender") {
                 system "make $lib" . "_vpcc_sender";
                 $exec = "vpcc_sender";
             }
-            vpcc_send_benchmark($lib, $file, $saddr, $raddr, $port, $iter, $threads, $nc, $exec, $format, $srtp, @fps_vals);
+            vpcc_send_benchmark($lib, $file, $saddr, $raddr, $port, $iter, $threads, $nc, $exec, $format, $srtp, $objects, @fps_vals);
         }
         else {
             if ($exec eq "default") {
                 system "make $lib" . "_sender";
                 $exec = "sender";
             }
-            send_benchmark($lib, $file, $saddr, $raddr, $port, $iter, $threads, $nc, $exec, $format, $srtp, @fps_vals);
+            send_benchmark($lib, $file, $saddr, $raddr, $port, $iter, $threads, $nc, $exec, $format, $srtp, $nal_index, $stream, $pacing, $mmsg, $lean, @fps_vals);
         }
     }
 } elsif ($role eq "recv" or $role eq "receive" or $role eq "receiver") {
@@ -552,7 +607,7 @@ if ($role eq "send" or $role eq "sender") {
     if ($lat) {
         if($format eq "vpcc") {
             system "make $lib" . "_vpcc_latency_receiver";
-            vpcc_recv_latency($lib, $saddr, $raddr, $port, $iter, $format, $srtp);
+            vpcc_recv_latency($lib, $saddr, $raddr, $port, $iter, $format, $srtp, $layout, $objects);
         }
         else {
             system "make $lib" . "_latency_receiver";
@@ -564,14 +619,15 @@ if ($role eq "send" or $role eq "sender") {
                 system "make $lib" . "_vpcc_receiver";
                 $exec = "vpcc_receiver";
             }
-            vpcc_recv_benchmark($lib, $saddr, $raddr, $port, $iter, $threads, $exec, $format, $srtp, @fps_vals);
+            die "Please specify the sent file with --file for $exec" if $exec eq "vpcc_reconstruct_receiver" and !$file;
+            vpcc_recv_benchmark($lib, $saddr, $raddr, $port, $iter, $threads, $exec, $format, $srtp, $layout, $objects, $file, @fps_vals);
         }
         else {
             if ($exec eq "default") {
                 system "make $lib" . "_receiver";
                 $exec = "receiver";
             }
-            recv_benchmark($lib, $saddr, $raddr, $port, $iter, $threads, $exec, $format, $srtp, @fps_vals);
+            recv_benchmark($lib, $saddr, $raddr, $port, $iter, $threads, $exec, $format, $srtp, $mmsg, @fps_vals);
         }
     } else {
         recv_generic($lib, $saddr, $port, $iter, $threads, @fps_vals);
@@ -15,24 +15,82 @@ sub print_help {
     . "\t--fps        <file framerate value>\n"
     . "\t--intra      <intra period>\n"
     . "\t--preset     <encoding preset>\n"
+    . "\n"
+    . "usage (batch, all combinations are encoded concurrently):\n"
+    . "./create.pl \n"
+    . "\t--input      <comma separated YUV420 files> (mandatory)\n"
+    . "\t--res        <comma separated {width}x{height}, one per input or one for all>\n"
+    . "\t--qp         <comma separated qp values>\n"
+    . "\t--fps        <file framerate value>\n"
+    . "\t--intra      <comma separated intra periods>\n"
+    . "\t--preset     <comma separated encoding presets>\n"
+    . "\t--split      <comma separated none|wpp|{columns}x{rows}> (slices per WPP row or tile)\n"
+    . "\t--workers    <# of concurrent encoders> (mandatory)\n"
+    . "\t--kvz-threads <# of kvazaar threads per encoder>\n"
+    . "\n"
+    . "usage (synthetic, no encoder or YUV file needed):\n"
+    . "./create.pl \n"
+    . "\t--synthetic  <output filename> (mandatory)\n"
+    . "\t--format     <hevc|vvc>\n"
+    . "\t--res        <{width}x{height}>\n"
+    . "\t--fps        <file framerate value>\n"
+    . "\t--intra      <intra period>\n"
+    . "\t--frames     <number of frames>\n"
+    . "\t--bitrate    <kbps> (default: 0.05 bits per pixel)\n"
+    . "\t--ratio      <intra frame size / inter frame size>\n"
+    . "\t--slices     <slices per frame>\n"
 }
 
 GetOptions(
     "input|file|filename|i=s" => \(my $filename = ""),
     "resolution|res=s"        => \(my $resolution = "3840x2160"),
-    "quantization|qp=i"       => \(my $qp = 27),
+    "quantization|qp=s"       => \(my $qp = 27),
     "framerate|fps=i"         => \(my $fps = 30),
-    "intra-period|intra=i"    => \(my $period = 64),
+    "intra-period|intra=s"    => \(my $period = 64),
     "preset|pre=s"            => \(my $preset = "ultrafast"),
+    "synthetic=s"             => \(my $synthetic = ""),
+    "format|form=s"           => \(my $format = "hevc"),
+    "frames=i"                => \(my $frames = 600),
+    "bitrate=i"               => \(my $bitrate = 0),
+    "ratio=f"                 => \(my $ratio = 5),
+    "slices=i"                => \(my $slices = 1),
+    "split=s"                 => \(my $split = "none"),
+    "workers=i"               => \(my $workers = 0),
+    "kvz-threads=i"           => \(my $kvz_threads = -1),
     "help"                    => \(my $help = 0)
 ) or die "failed to parse command line!\n";
 
-print_help() if $help or !$filename;
+print_help() if $help or (!$filename and !$synthetic);
 
 # check that parameters make sense
 die "" if $help;
-die "please specify input file with --input" if !$filename;
-die "invalid preset" if !grep (/$preset/, ("ultrafast", "superfast", "veryfast", "faster", "fast", "medium", "slow", "slower", "veryslow", "placebo"));
+die "please specify input file with --input" if !$filename and !$synthetic;
+foreach (split ",", $preset) {
+    my $p = $_;
+    die "invalid preset" if !grep (/^$p$/, ("ultrafast", "superfast", "veryfast", "faster", "fast", "medium", "slow", "slower", "veryslow", "placebo"));
+}
+
+die "--split is only supported in batch mode, give the number of encoders with --workers\n" if $split ne "none" and !$workers;
+
+if ($workers) {
+    my @files = split ",", $filename;
+    my @resolutions = split ",", $resolution;
+    die "give one resolution for all inputs or one per input\n" if @resolutions != 1 and @resolutions != @files;
+
+    my @inputs;
+    for my $i (0 .. $#files) {
+        my $res = $resolutions[@resolutions == 1 ? 0 : $i];
+        die "check resolution format, for example: --res 3840x2160\n" if $res !~ /^\d+x\d+$/;
+        push @inputs, "$files[$i]:$res";
+    }
+    my $input_list = join ",", @inputs;
+
+    system "make test_file_creation";
+
+    my $exit_code = system ("./test_file_creation --batch $input_list $fps $qp $period $preset $split $workers $kvz_threads");
+    die "Failed to run file creator.\n" if $exit_code != 0;
+    exit;
+}
 
 die "check resolution format, for example: --res 3840x2160\n" if $resolution !~ /([\d]+)x([\d]+)/;
 
@@ -40,6 +98,14 @@ die "check resolution format, for example: --res 3840x2160\n" if $resolution !~
 my $width = $1;
 my $height = $2;
 
+if ($synthetic) {
+    system "make synthetic_stream";
+
+    my $exit_code = system ("./synthetic_stream $synthetic $format $width $height $fps $frames $period $bitrate $ratio $slices");
+    die "Failed to run synthetic stream generator.\n" if $exit_code != 0;
+    exit;
+}
+
 # build creation program
 system "make test_file_creation"; 
 
@@ -0,0 +1,135 @@
+#include "ffmpeg_util.hh"
+
+extern "C" {
+#include <libavutil/base64.h>
+}
+
+#include <algorithm>
+#include <cstring>
+
+// Same payload type as in uvgRTP and Live555
+#define PAYLOAD_TYPE 96
+
+#define SDP_BUFFER_SIZE 4096
+
+// Same as in uvgrtp/uvgrtp_util.hh
+#define KEY_SIZE   16
+#define SALT_SIZE  14
+
+#define SRTP_SUITE "AES_CM_128_HMAC_SHA1_80"
+
+struct sdp_input {
+    std::string sdp;
+    size_t offset = 0;
+};
+
+static int read_sdp(void *opaque, uint8_t *buf, int buf_size)
+{
+    sdp_input *input = (sdp_input *)opaque;
+
+    if (input->offset == input->sdp.size())
+        return AVERROR_EOF;
+
+    size_t len = std::min(input->sdp.size() - input->offset, (size_t)buf_size);
+    memcpy(buf, input->sdp.data() + input->offset, len);
+    input->offset += len;
+
+    return (int)len;
+}
+
+static void free_sdp_avio(AVIOContext *pb)
+{
+    if (!pb || pb->read_packet != read_sdp)
+        return;
+
+    delete (sdp_input *)pb->opaque;
+    av_freep(&pb->buffer);
+    avio_context_free(&pb);
+}
+
+std::string get_srtp_params()
+{
+    uint8_t params[KEY_SIZE + SALT_SIZE] = { 0 };
+    char buf[AV_BASE64_SIZE(KEY_SIZE + SALT_SIZE)];
+
+    for (int i = 0; i < KEY_SIZE; ++i)
+        params[i] = (i < SALT_SIZE) ? i + 13 : i + 7;
+
+    av_base64_encode(buf, sizeof(buf), params, sizeof(params));
+    return buf;
+}
+
+int open_rtp_output(AVFormatContext *ctx, std::string address, int port, bool srtp)
+{
+    AVDictionary *opts = NULL;
+    char url[128];
+
+    snprintf(url, sizeof(url), "%s://%s:%d", srtp ? "srtp" : "rtp", address.c_str(), port);
+
+    if (srtp) {
+        av_dict_set(&opts, "srtp_out_suite", SRTP_SUITE, 0);
+        av_dict_set(&opts, "srtp_out_params", get_srtp_params().c_str(), 0);
+    }
+
+    int ret = avio_open2(&ctx->pb, url, AVIO_FLAG_WRITE, NULL, &opts);
+    av_dict_free(&opts);
+
+    return ret;
+}
+
+std::string create_sdp(std::string address, int port, bool vvc, bool srtp)
+{
+    char buf[512];
+    std::string crypto;
+
+    if (srtp)
+        crypto = "a=crypto:1 " SRTP_SUITE " inline:" + get_srtp_params() + "\r\n";
+
+    snprintf(buf, sizeof(buf),
+        "v=0\r\n"
+        "o=user 0 0 IN IP4 %s\r\n"
+        "s=No Name\r\n"
+        "c=IN IP4 %s\r\n"
+        "t=0 0\r\n"
+        "m=video %d RTP/AVP %d\r\n"
+        "a=rtpmap:%d %s/90000\r\n"
+        "a=recvonly\r\n"
+        "%s",
+        address.c_str(), address.c_str(), port, PAYLOAD_TYPE, PAYLOAD_TYPE, vvc ? "H266" : "H265", crypto.c_str());
+
+    return buf;
+}
+
+int open_sdp_input(AVFormatContext **ctx, std::string sdp, AVDictionary **options)
+{
+    if (!*ctx && !(*ctx = avformat_alloc_context()))
+        return AVERROR(ENOMEM);
+
+    if (!(*ctx)->pb) {
+        sdp_input *input = new sdp_input;
+        input->sdp = sdp;
+
+        uint8_t *buffer = (uint8_t *)av_malloc(SDP_BUFFER_SIZE);
+        (*ctx)->pb = avio_alloc_context(buffer, SDP_BUFFER_SIZE, 0, input, read_sdp, nullptr, nullptr);
+    }
+
+    /* on failure the format context is freed, but not a custom AVIOContext */
+    AVIOContext *pb = (*ctx)->pb;
+    int ret = avformat_open_input(ctx, "sdp", av_find_input_format("sdp"), options);
+
+    if (ret < 0)
+        free_sdp_avio(pb);
+
+    return ret;
+}
+
+void close_sdp_input(AVFormatContext **ctx)
+{
+    if (!*ctx)
+        return;
+
+    AVIOContext *pb = (*ctx)->pb;
+
+    avformat_close_input(ctx);
+    free_sdp_avio(pb);
+}
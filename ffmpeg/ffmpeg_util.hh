@@ -0,0 +1,33 @@
+#pragma once
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavformat/avio.h>
+}
+
+#include <string>
+
+/* The FFmpeg receivers open their RTP streams with the SDP demuxer. Instead of reading a hand-written
+ * .sdp file, the SDP of each stream is created from the command line and read from memory, so any
+ * address, port and number of streams can be used */
+
+/* SDP of one HEVC (or VVC) stream received at address:port. FFmpeg uses the connection address
+ * only as the destination of RTCP, the port is bound on all addresses. With srtp, the SDP carries
+ * the benchmark key in an a=crypto line and the RTP demuxer decrypts the packets */
+std::string create_sdp(std::string address, int port, bool vvc, bool srtp);
+
+/* SRTP master key and salt in the base64 form of srtp_out_params and a=crypto. The values are the ones
+ * intialize_uvgrtp() gives to uvgRTP: the key is filled with i + 7 and its first 14 bytes are then
+ * overwritten with i + 13, and the salt is left zero */
+std::string get_srtp_params();
+
+/* Open the output of an RTP muxer to address:port. With srtp, srtp:// is used instead of rtp://
+ * with the AES_CM_128_HMAC_SHA1_80 suite and the benchmark key */
+int open_rtp_output(AVFormatContext *ctx, std::string address, int port, bool srtp);
+
+/* Open the SDP demuxer with the SDP given in memory. The SDP is read through a memory AVIOContext,
+ * unless the format context already has a custom one (see mmsg_io.hh) */
+int open_sdp_input(AVFormatContext **ctx, std::string sdp, AVDictionary **options);
+
+// Close the input and the memory AVIOContext created by open_sdp_input()
+void close_sdp_input(AVFormatContext **ctx);
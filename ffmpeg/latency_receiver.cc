@@ -1,4 +1,5 @@
 #include "../util/util.hh"
+#include "ffmpeg_util.hh"
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -32,7 +33,8 @@ struct ffmpeg_ctx {
     AVFormatContext *receiver;
 };
 
-static ffmpeg_ctx *init_ffmpeg(std::string remote_address, int remote_port)
+static ffmpeg_ctx *init_ffmpeg(std::string local_address, int local_port, std::string remote_address, int remote_port,
+    bool vvc, bool srtp)
 {
     avcodec_register_all();
     av_register_all();
@@ -73,7 +75,7 @@ static ffmpeg_ctx *init_ffmpeg(std::string remote_address, int remote_port)
     snprintf(addr, 64, "rtp://%s: %d", remote_address.c_str(), remote_port);
     ret = avformat_alloc_output_context2(&ctx->sender, fmt, fmt->name, addr);
 
-    avio_open(&ctx->sender->pb, ctx->sender->filename, AVIO_FLAG_WRITE);
+    open_rtp_output(ctx->sender, remote_address, remote_port, srtp);
 
     struct AVStream* stream = avformat_new_stream(ctx->sender, codec);
     stream->codecpar->width = WIDTH;
@@ -159,12 +161,8 @@ static ffmpeg_ctx *init_ffmpeg(std::string remote_address, int remote_port)
 
     ctx->receiver->flags = AVFMT_FLAG_NONBLOCK;
 
-    if (!strcmp(remote_address.c_str(), "127.0.0.1"))
-        snprintf(buf, sizeof(buf), "ffmpeg/sdp/localhost/lat_hevc.sdp");
-    else
-        snprintf(buf, sizeof(buf), "ffmpeg/sdp/lan/lat_hevc.sdp");
-
-    if (avformat_open_input(&ctx->receiver, buf, NULL, &d_r) != 0) {
+    /* the echoed stream is received on the local port */
+    if (open_sdp_input(&ctx->receiver, create_sdp(local_address, local_port, vvc, srtp), &d_r) != 0) {
         fprintf(stderr, "nothing found!\n");
         return NULL;
     }
@@ -183,12 +181,13 @@ static ffmpeg_ctx *init_ffmpeg(std::string remote_address, int remote_port)
     return ctx;
 }
 
-static int receiver(std::string remote_address, int remote_port)
+static int receiver(std::string local_address, int local_port, std::string remote_address, int remote_port, bool vvc,
+    bool srtp)
 {
     AVPacket pkt;
     ffmpeg_ctx *ctx;
 
-    if (!(ctx = init_ffmpeg(remote_address.c_str(), remote_port)))
+    if (!(ctx = init_ffmpeg(local_address, local_port, remote_address, remote_port, vvc, srtp)))
         return EXIT_FAILURE;
 
     av_init_packet(&pkt);
@@ -216,5 +215,5 @@ int main(int argc, char **argv)
     bool vvc_enabled = get_vvc_state(argv[5]);
     bool srtp_enabled = get_srtp_state(argv[6]);
 
-    return receiver(remote_address, remote_port);
+    return receiver(local_address, local_port, remote_address, remote_port, vvc_enabled, srtp_enabled);
 }
@@ -1,4 +1,5 @@
 #include "../util/util.hh"
+#include "ffmpeg_util.hh"
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -14,11 +15,10 @@ extern "C" {
 }
 
 #include <atomic>
-#include <deque>
 #include <chrono>
 #include <string>
 #include <thread>
-#include <unordered_map>
+#include <vector>
 
 using namespace std::chrono;
 
@@ -28,21 +28,43 @@ extern void* get_mem(std::string filename, size_t& len);
 #define HEIGHT 2160
 #define FPS      30
 
+// Stop reading echoed packets when everything has been sent and nothing has come back for this long
+#define RECEIVE_TIMEOUT_MS 500
+
 std::chrono::high_resolution_clock::time_point fs, fe;
 std::atomic<bool> ready(false);
-uint64_t ff_key = 0;
+std::atomic<bool> sending_done(false);
+
+/* Latency samples, one per frame, allocated before sending. Frame n is sent with pts n / FPS, which the
+ * RTP muxer turns into the RTP timestamp. The echo keeps the spacing of the timestamps and the RTP demuxer
+ * gives them relative to the first packet, so the frame of an echoed packet is its pts in frames.
+ * A frame has arrived when its last packet has, i.e. when packets of a later frame start to come */
+struct frame_info {
+    high_resolution_clock::time_point sent;
+    high_resolution_clock::time_point received;
+    bool intra = false;
+};
 
-static std::unordered_map<uint64_t, high_resolution_clock::time_point> timestamps;
-static std::deque<high_resolution_clock::time_point> timestamps2;
+static std::vector<frame_info> frame_table;
+static high_resolution_clock::time_point last_packet;
 
 high_resolution_clock::time_point start2;
 
+static int receive_interrupt(void *opaque)
+{
+    (void)opaque;
+
+    return sending_done && std::chrono::duration_cast<std::chrono::milliseconds>(
+        high_resolution_clock::now() - last_packet).count() > RECEIVE_TIMEOUT_MS;
+}
+
 struct ffmpeg_ctx {
     AVFormatContext *sender;
     AVFormatContext *receiver;
 };
 
-static ffmpeg_ctx *init_ffmpeg(std::string remote_address, int remote_port)
+static ffmpeg_ctx *init_ffmpeg(std::string local_address, int local_port, std::string remote_address, int remote_port,
+    bool vvc, bool srtp)
 {
     avcodec_register_all();
     av_register_all();
@@ -84,7 +106,7 @@ static ffmpeg_ctx *init_ffmpeg(std::string remote_address, int remote_port)
     snprintf(addr, 64, "rtp://%s: %d", remote_address.c_str(), remote_port);
     ret = avformat_alloc_output_context2(&ctx->sender, fmt, fmt->name, addr);
 
-    avio_open(&ctx->sender->pb, ctx->sender->filename, AVIO_FLAG_WRITE);
+    open_rtp_output(ctx->sender, remote_address, remote_port, srtp);
 
     struct AVStream* stream = avformat_new_stream(ctx->sender, codec);
     stream->codecpar->width = WIDTH;
@@ -173,13 +195,10 @@ static ffmpeg_ctx *init_ffmpeg(std::string remote_address, int remote_port)
 #endif
 
     ctx->receiver->flags = AVFMT_FLAG_NONBLOCK;
+    ctx->receiver->interrupt_callback.callback = receive_interrupt;
 
-    if (!strcmp(remote_address.c_str(), "127.0.0.1"))
-        snprintf(buf, sizeof(buf), "ffmpeg/sdp/localhost/lat_hevc.sdp");
-    else
-        snprintf(buf, sizeof(buf), "ffmpeg/sdp/lan/lat_hevc.sdp");
-
-    if (avformat_open_input(&ctx->receiver, buf, NULL, &d_r) != 0) {
+    /* the echoed stream is received on the local port */
+    if (open_sdp_input(&ctx->receiver, create_sdp(local_address, local_port, vvc, srtp), &d_r) != 0) {
         fprintf(stderr, "nothing found!\n");
         return NULL;
     }
@@ -194,9 +213,6 @@ static ffmpeg_ctx *init_ffmpeg(std::string remote_address, int remote_port)
 
 static void receiver(ffmpeg_ctx *ctx)
 {
-    uint64_t key  = 0;
-    uint64_t diff = 0;
-
     uint64_t frame_total = 0;
     uint64_t intra_total = 0;
     uint64_t inter_total = 0;
@@ -208,39 +224,52 @@ static void receiver(ffmpeg_ctx *ctx)
     AVPacket packet;
     av_init_packet(&packet);
 
-    std::chrono::high_resolution_clock::time_point start;
-    start = std::chrono::high_resolution_clock::now();
+    last_packet = std::chrono::high_resolution_clock::now();
 
     /* start reading packets from stream */
     av_read_play(ctx->receiver);
 
     while (av_read_frame(ctx->receiver, &packet) >= 0) {
-        key = packet.size - 1;
+        last_packet = std::chrono::high_resolution_clock::now();
 
-        if (!frames)
-            key = ff_key;
+        AVRational time_base = ctx->receiver->streams[packet.stream_index]->time_base;
+        int64_t index = av_rescale_q_rnd(packet.pts, time_base, AVRational{ 1, FPS }, AV_ROUND_NEAR_INF);
 
-        auto diff = std::chrono::duration_cast<std::chrono::microseconds>(
-            std::chrono::high_resolution_clock::now() - timestamps2.front()
-        ).count();
-        timestamps2.pop_front();
+        if (packet.pts != AV_NOPTS_VALUE && index >= 0 && index < (int64_t)frame_table.size()) {
+            frame_info& frame = frame_table[index];
 
-        if (((packet.data[3] >> 1) & 0x3f) == 19)
-            intra_total += (diff / 1000), intras++;
-        else if (((packet.data[3] >> 1) & 0x3f) == 1)
-            inter_total += (diff / 1000), inters++;
+            frame.received = last_packet;
 
-        if (++frames < 596)
-            frame_total += (diff / 1000);
-        else
-            break;
+            /* the depacketizer prepends a start code to each NAL unit */
+            int i = 0;
+            while (i < packet.size - 1 && !packet.data[i])
+                ++i;
 
-        timestamps.erase(key);
+            if (i + 1 < packet.size) {
+                uint8_t type = (packet.data[i + 1] >> 1) & 0x3f;
+                frame.intra |= (type >= 16 && type <= 21);
+            }
+        }
 
         av_free_packet(&packet);
         av_init_packet(&packet);
     }
 
+    for (auto& frame : frame_table) {
+        if (frame.received == high_resolution_clock::time_point())
+            continue;
+
+        auto diff = std::chrono::duration_cast<std::chrono::microseconds>(frame.received - frame.sent).count();
+
+        if (frame.intra)
+            intra_total += (diff / 1000), intras++;
+        else
+            inter_total += (diff / 1000), inters++;
+
+        frame_total += (diff / 1000);
+        frames++;
+    }
+
     fprintf(stderr, "%zu: intra %lf, inter %lf, avg %lf\n",
         frames,
         intra_total / (float)intras,
@@ -251,7 +280,8 @@ static void receiver(ffmpeg_ctx *ctx)
     ready = true;
 }
 
-static int sender(std::string input_file, std::string remote_address, int remote_port)
+static int sender(std::string input_file, std::string local_address, int local_port, std::string remote_address,
+    int remote_port, bool vvc, bool srtp)
 {
     size_t len = 0;
     void *mem  = get_mem(input_file, len);
@@ -259,12 +289,16 @@ static int sender(std::string input_file, std::string remote_address, int remote
     std::vector<uint64_t> chunk_sizes;
     get_chunk_sizes(get_chunk_filename(input_file), chunk_sizes);
 
-    ffmpeg_ctx *ctx = init_ffmpeg(remote_address, remote_port);
+    frame_table.resize(chunk_sizes.size());
+
+    ffmpeg_ctx *ctx = init_ffmpeg(local_address, local_port, remote_address, remote_port, vvc, srtp);
+
+    if (!ctx)
+        return EXIT_FAILURE;
 
     (void)new std::thread(receiver, ctx);
 
     uint64_t current_frame    = 0;
-    uint64_t key        = 0;
     uint64_t period     = (uint64_t)((1000 / (float)FPS) * 1000);
 
     uint64_t offset = 0;
@@ -274,25 +308,15 @@ static int sender(std::string input_file, std::string remote_address, int remote
 
     for (auto& chunk_size : chunk_sizes)
     {
-        /* Start code lookup/merging of small packets causes the incoming frame size
-         * to differ quite significantly from "chunk_size" */
-        if (!offset)
-        {
-            ff_key = chunk_size;
-        }
-
-        if (timestamps.find(chunk_size) != timestamps.end()) {
-            fprintf(stderr, "cannot use %zu for key!\n", chunk_size);
-            continue;
-        }
-
-        timestamps[chunk_size] = std::chrono::high_resolution_clock::now();
-        timestamps2.push_back(std::chrono::high_resolution_clock::now());
+        frame_table[current_frame].sent = std::chrono::high_resolution_clock::now();
 
         av_init_packet(&pkt);
         pkt.data = (uint8_t*)mem + offset;
         pkt.size = chunk_size;
 
+        /* the RTP timestamp, which tells the receiver which frame this was */
+        pkt.pts = pkt.dts = av_rescale_q(current_frame, AVRational{ 1, FPS }, ctx->sender->streams[0]->time_base);
+
         av_interleaved_write_frame(ctx->sender, &pkt);
         av_packet_unref(&pkt);
 
@@ -307,6 +331,8 @@ static int sender(std::string input_file, std::string remote_address, int remote
             std::this_thread::sleep_for(std::chrono::microseconds(current_frame * period - runtime));
     }
 
+    sending_done = true;
+
     while (!ready.load())
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(50));
@@ -334,5 +360,5 @@ int main(int argc, char **argv)
     bool vvc_enabled = get_vvc_state(argv[7]);
     bool srtp_enabled = get_srtp_state(argv[8]);
 
-    return sender(input_file, remote_address, remote_port);
+    return sender(input_file, local_address, local_port, remote_address, remote_port, vvc_enabled, srtp_enabled);
 }
@@ -0,0 +1,256 @@
+#include "mmsg_io.hh"
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+// How often a receiver waiting for packets checks the interrupt callback
+#define POLL_TIMEOUT_MS 1
+
+// Same as the buffer_size given to libavformat's UDP protocol by the receiver
+#define RECV_BUFFER_SIZE (40 * 1000 * 1000)
+
+static void init_batch(mmsg_io *io, int slot_size)
+{
+    io->slots.resize((size_t)MMSG_BATCH_SIZE * slot_size);
+    io->iovecs.resize(MMSG_BATCH_SIZE);
+    io->msgs.resize(MMSG_BATCH_SIZE);
+
+    for (int i = 0; i < MMSG_BATCH_SIZE; ++i) {
+        io->iovecs[i].iov_base = &io->slots[(size_t)i * slot_size];
+        io->iovecs[i].iov_len  = slot_size;
+
+        memset(&io->msgs[i], 0, sizeof(io->msgs[i]));
+        io->msgs[i].msg_hdr.msg_iov    = &io->iovecs[i];
+        io->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+static bool parse_address(std::string address, int port, struct sockaddr_in& addr)
+{
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "Invalid address: " << address << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/* The RTP muxer flushes its AVIOContext after every packet,
+ * so each call gives one whole RTP packet */
+static int write_packet(void *opaque, uint8_t *buf, int buf_size)
+{
+    mmsg_io *io = (mmsg_io *)opaque;
+
+    if (buf_size > MMSG_PACKET_SIZE) {
+        std::cerr << "Packet of " << buf_size << " bytes does not fit the batch" << std::endl;
+        return AVERROR(EINVAL);
+    }
+
+    memcpy(io->iovecs[io->queued].iov_base, buf, buf_size);
+    io->iovecs[io->queued].iov_len = buf_size;
+
+    if (++io->queued == MMSG_BATCH_SIZE && !mmsg_io_flush(io))
+        return AVERROR(EIO);
+
+    return buf_size;
+}
+
+static int drop_packet(void *opaque, uint8_t *buf, int buf_size)
+{
+    (void)opaque, (void)buf;
+
+    return buf_size;
+}
+
+// Gives the SDP first, then one received datagram per call
+static int read_packet(void *opaque, uint8_t *buf, int buf_size)
+{
+    mmsg_io *io = (mmsg_io *)opaque;
+
+    if (io->sdp_offset < io->sdp.size()) {
+        size_t len = std::min(io->sdp.size() - io->sdp_offset, (size_t)buf_size);
+        memcpy(buf, io->sdp.data() + io->sdp_offset, len);
+        io->sdp_offset += len;
+        return (int)len;
+    }
+
+    // the SDP demuxer reads until the end of file
+    if (!io->sdp.empty()) {
+        io->sdp.clear();
+        return AVERROR_EOF;
+    }
+
+    while (io->next == io->received) {
+        struct pollfd pfd = { io->fd, POLLIN, 0 };
+
+        int ret = poll(&pfd, 1, POLL_TIMEOUT_MS);
+
+        if (ret < 0 && errno != EINTR)
+            return AVERROR(errno);
+
+        if (ret <= 0) {
+            if (io->interrupt.callback && io->interrupt.callback(io->interrupt.opaque))
+                return AVERROR_EOF;
+            continue;
+        }
+
+        for (int i = 0; i < MMSG_BATCH_SIZE; ++i)
+            io->iovecs[i].iov_len = MMSG_SLOT_SIZE;
+
+        ret = recvmmsg(io->fd, io->msgs.data(), MMSG_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+
+        if (ret < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                continue;
+
+            std::cerr << "recvmmsg() failed: " << strerror(errno) << std::endl;
+            return AVERROR(errno);
+        }
+
+        io->received = ret;
+        io->next     = 0;
+        io->packets += ret;
+        ++io->syscalls;
+    }
+
+    const struct mmsghdr& msg = io->msgs[io->next];
+    int len = std::min((int)msg.msg_len, buf_size);
+
+    memcpy(buf, io->iovecs[io->next].iov_base, len);
+    ++io->next;
+
+    return len;
+}
+
+mmsg_io *mmsg_io_open_sender(std::string remote_address, int remote_port)
+{
+    mmsg_io *io = new mmsg_io;
+
+    if (!parse_address(remote_address, remote_port, io->addr)) {
+        delete io;
+        return nullptr;
+    }
+
+    if ((io->fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        std::cerr << "Failed to create socket: " << strerror(errno) << std::endl;
+        delete io;
+        return nullptr;
+    }
+
+    init_batch(io, MMSG_PACKET_SIZE);
+
+    // the socket is not connected, so that a missing receiver does not fail the sends
+    for (auto& msg : io->msgs) {
+        msg.msg_hdr.msg_name    = &io->addr;
+        msg.msg_hdr.msg_namelen = sizeof(io->addr);
+    }
+
+    uint8_t *buffer = (uint8_t *)av_malloc(MMSG_PACKET_SIZE);
+    io->avio = avio_alloc_context(buffer, MMSG_PACKET_SIZE, 1, io, nullptr, write_packet, nullptr);
+
+    // the RTP muxer takes its packet size from this
+    io->avio->max_packet_size = MMSG_PACKET_SIZE;
+
+    return io;
+}
+
+mmsg_io *mmsg_io_open_receiver(std::string local_address, int local_port, std::string sdp,
+    AVIOInterruptCB interrupt)
+{
+    mmsg_io *io = new mmsg_io;
+    struct sockaddr_in addr = {};
+
+    io->sdp       = sdp;
+    io->interrupt = interrupt;
+
+    if (!parse_address(local_address, local_port, addr)) {
+        delete io;
+        return nullptr;
+    }
+
+    if ((io->fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        std::cerr << "Failed to create socket: " << strerror(errno) << std::endl;
+        delete io;
+        return nullptr;
+    }
+
+    int size = RECV_BUFFER_SIZE;
+    (void)setsockopt(io->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    if (bind(io->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        std::cerr << "Failed to bind to " << local_address << ":" << local_port << ": "
+            << strerror(errno) << std::endl;
+        close(io->fd);
+        delete io;
+        return nullptr;
+    }
+
+    init_batch(io, MMSG_SLOT_SIZE);
+
+    /* With both callbacks, avio_read_partial() calls read_packet() directly with the demuxer's
+     * buffer, and the receiver reports have a place to go instead of the read buffer */
+    uint8_t *buffer = (uint8_t *)av_malloc(MMSG_SLOT_SIZE);
+    io->avio = avio_alloc_context(buffer, MMSG_SLOT_SIZE, 1, io, read_packet, drop_packet, nullptr);
+    io->avio->max_packet_size = MMSG_SLOT_SIZE;
+
+    return io;
+}
+
+void mmsg_io_start(mmsg_io *io)
+{
+    io->avio->eof_reached = 0;
+}
+
+bool mmsg_io_flush(mmsg_io *io)
+{
+    int sent = 0;
+
+    while (sent < io->queued) {
+        int ret = sendmmsg(io->fd, &io->msgs[sent], io->queued - sent, 0);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+
+            std::cerr << "sendmmsg() failed: " << strerror(errno) << std::endl;
+            io->queued = 0;
+            return false;
+        }
+
+        sent += ret;
+        ++io->syscalls;
+    }
+
+    io->packets += sent;
+    io->queued   = 0;
+
+    return true;
+}
+
+void mmsg_io_close(mmsg_io *io)
+{
+    if (!io)
+        return;
+
+    if (io->queued)
+        (void)mmsg_io_flush(io);
+
+    if (io->avio) {
+        av_freep(&io->avio->buffer);
+        avio_context_free(&io->avio);
+    }
+
+    if (io->fd >= 0)
+        close(io->fd);
+
+    delete io;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavformat/avio.h>
+}
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+
+/* Custom AVIOContext for the RTP muxer and the SDP demuxer that replaces libavformat's UDP protocol.
+ * The sender side queues the packets given by the muxer and sends them with one sendmmsg() per batch,
+ * the receiver side reads a batch of datagrams with one recvmmsg() and gives them to the demuxer one
+ * at a time. Comparing this to the rtp:// URL tells how much of FFmpeg's cost is in its socket layer */
+
+// Largest RTP packet written by the muxer, same as the pkt_size default of libavformat's UDP protocol
+constexpr int MMSG_PACKET_SIZE = 1472;
+
+// Packets sent or received with one system call
+constexpr int MMSG_BATCH_SIZE = 64;
+
+// Receive buffer slot, large enough for the RTP packets of any of the senders
+constexpr int MMSG_SLOT_SIZE = 2048;
+
+struct mmsg_io {
+    int fd = -1;
+    struct sockaddr_in addr = {};   // sender: destination of the packets
+    AVIOContext *avio = nullptr;
+
+    std::vector<uint8_t> slots;
+    std::vector<struct iovec> iovecs;
+    std::vector<struct mmsghdr> msgs;
+
+    int queued = 0;     // sender: packets waiting for sendmmsg()
+    int received = 0;   // receiver: packets from the last recvmmsg()
+    int next = 0;       // receiver: next packet given to the demuxer
+
+    /* receiver: the SDP is read through the same context before the RTP packets,
+     * and the read is stopped with the interrupt callback of the format context */
+    std::string sdp;
+    size_t sdp_offset = 0;
+    AVIOInterruptCB interrupt = { nullptr, nullptr };
+
+    size_t syscalls = 0;
+    size_t packets = 0;
+};
+
+/* Create a context that sends the packets written into it to remote_address:remote_port.
+ * Set it as the pb of an rtp output format context with AVFMT_FLAG_CUSTOM_IO */
+mmsg_io *mmsg_io_open_sender(std::string remote_address, int remote_port);
+
+/* Create a context that gives the demuxer the SDP first and then the datagrams received on
+ * local_address:local_port. Open the input with the sdp format and sdp_flags custom_io, and call
+ * mmsg_io_start() once the input is open. The RTCP receiver reports written by the demuxer are dropped */
+mmsg_io *mmsg_io_open_receiver(std::string local_address, int local_port, std::string sdp,
+    AVIOInterruptCB interrupt);
+
+// Clear the end of file left by the SDP so that the demuxer reads the RTP packets
+void mmsg_io_start(mmsg_io *io);
+
+// Send the queued packets. Called once per frame so that batching does not delay the next frame
+bool mmsg_io_flush(mmsg_io *io);
+
+void mmsg_io_close(mmsg_io *io);
@@ -1,4 +1,6 @@
 #include "../util/util.hh"
+#include "ffmpeg_util.hh"
+#include "mmsg_io.hh"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -45,7 +47,7 @@ static int cb(void *ctx)
 static const AVIOInterruptCB int_cb = { cb, NULL };
 
 void thread_func(int thread_num, int nthreads, std::string local_address, int local_port,
-    std::string remote_address, int remote_port, bool vvc, bool srtp)
+    std::string remote_address, int remote_port, bool vvc, bool srtp, bool mmsg)
 {
     AVFormatContext *format_ctx = avformat_alloc_context();
     AVCodecContext *codec_ctx = NULL;
@@ -111,17 +113,32 @@ void thread_func(int thread_num, int nthreads, std::string local_address, int lo
     av_dict_set(&d, "rw_timeout", buf, 32);
 #endif
 
-    if (!strcmp(local_address.c_str(), "127.0.0.1"))
-        snprintf(buf, sizeof(buf), "ffmpeg/sdp/localhost/hevc_%d.sdp", nthreads);
-    else
-        snprintf(buf, sizeof(buf), "ffmpeg/sdp/lan/hevc_%d.sdp", nthreads);
+    /* each stream has its own SDP and demuxer, stream n is received on local port + 2n
+     * the same way as in the uvgRTP and Live555 receivers */
+    std::string sdp = create_sdp(local_address, local_port + thread_num * 2, vvc, srtp);
+    mmsg_io *io = nullptr;
 
-    if (avformat_open_input(&format_ctx, buf, NULL, &d)) {
+    if (mmsg) {
+        // the SDP is given to the demuxer through the same context as the RTP packets
+        if (!(io = mmsg_io_open_receiver(local_address, local_port + thread_num * 2, sdp, int_cb))) {
+            nready++;
+            return;
+        }
+
+        format_ctx->pb = io->avio;
+        av_dict_set(&d, "sdp_flags", "custom_io", 0);
+    }
+
+    if (open_sdp_input(&format_ctx, sdp, &d) < 0) {
         fprintf(stderr, "failed to open input file\n");
+        mmsg_io_close(io);
         nready++;
         return;
     }
 
+    if (io)
+        mmsg_io_start(io);
+
     if (avformat_find_stream_info(format_ctx, NULL) < 0) {
         fprintf(stderr, "failed to find stream info!\n");
         nready++;
@@ -165,14 +182,22 @@ void thread_func(int thread_num, int nthreads, std::string local_address, int lo
     }
 
     av_read_pause(format_ctx);
+    close_sdp_input(&format_ctx);
+
+    if (io) {
+        std::cout << "Thread " << thread_num << ": " << io->packets << " packets in " << io->syscalls
+            << " recvmmsg() calls" << std::endl;
+        mmsg_io_close(io);
+    }
+
     nready++;
 }
 
 int main(int argc, char **argv)
 {
-    if (argc != 9) {
+    if (argc != 9 && argc != 10) {
         fprintf(stderr, "usage: ./%s <result file> <local address> <local port> <remote address> <remote port> \
-            <number of threads> <format> <srtp>\n", __FILE__);
+            <number of threads> <format> <srtp> [mmsg]\n", __FILE__);
         return EXIT_FAILURE;
     }
 
@@ -186,13 +211,21 @@ int main(int argc, char **argv)
     bool vvc_enabled = get_vvc_state(argv[7]);
     bool srtp_enabled = get_srtp_state(argv[8]);
 
+    // mmsg: the demuxer reads from a custom AVIOContext that receives with recvmmsg()
+    bool mmsg_enabled = (argc == 10) && std::string(argv[9]) == "mmsg";
+
+    if (argc == 10 && !mmsg_enabled) {
+        std::cerr << "Unknown receiver mode: " << argv[9] << std::endl;
+        return EXIT_FAILURE;
+    }
+
     thread_info  = (struct thread_info *)calloc(nthreads, sizeof(*thread_info));
 
     std::vector<std::thread*> threads = {};
 
     for (int i = 0; i < nthreads; ++i) {
         threads.push_back(new std::thread(thread_func, i, nthreads, local_address, local_port,
-            remote_address, remote_port, vvc_enabled, srtp_enabled));
+            remote_address, remote_port, vvc_enabled, srtp_enabled, mmsg_enabled));
     }
 
     // wait all the thread executions to end and delete them
@@ -1,4 +1,6 @@
 #include "../util/util.hh"
+#include "ffmpeg_util.hh"
+#include "mmsg_io.hh"
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -12,25 +14,85 @@ extern "C" {
 #include <libavutil/samplefmt.h>
 #include <stdbool.h>
 }
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <thread>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <string>
 #include <iostream>
+#include <vector>
 
 #define WIDTH  3840
 #define HEIGHT 2160
 
 std::atomic<int> nready(0);
 
+/* Streams that have finished their setup. Sending starts once all of them have, so that the
+ * memory used by the setup can be measured */
+std::atomic<int> nsetup(0);
+std::atomic<bool> start_sending(false);
+std::vector<uint64_t> setup_us;
+
+// Resident set size of the process in kB
+static size_t get_rss_kb()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+            return strtoull(line.c_str() + 6, nullptr, 10);
+    }
+
+    return 0;
+}
+
+/* The parameter sets of the first frame with start codes, which is the extradata of an Annex B stream.
+ * The lean sender gives these to the muxer instead of opening an encoder to get them */
+static std::vector<uint8_t> get_parameter_sets(uint8_t* mem, size_t len, bool vvc)
+{
+    std::vector<std::pair<size_t, uint8_t*>> nals;
+    std::vector<uint8_t> extradata;
+
+    scan_nal_units(mem, len, nals);
+
+    for (auto& nal : nals) {
+        if (nal.first < 2)
+            continue;
+
+        // VPS, SPS and PPS
+        uint8_t type = vvc ? (nal.second[1] >> 3) : ((nal.second[0] >> 1) & 0x3f);
+        bool parameter_set = vvc ? (type >= 14 && type <= 16) : (type >= 32 && type <= 34);
+
+        if (parameter_set) {
+            extradata.insert(extradata.end(), { 0, 0, 0, 1 });
+            extradata.insert(extradata.end(), nal.second, nal.second + nal.first);
+        }
+    }
+
+    return extradata;
+}
+
+static void setup_done(int thread_num, std::chrono::high_resolution_clock::time_point setup_start)
+{
+    setup_us[thread_num] = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - setup_start).count();
+
+    nsetup++;
+}
+
 void thread_func(void* mem, std::string local_address, uint16_t local_port,
     std::string remote_address, uint16_t remote_port, int thread_num, double fps, bool vvc, bool srtp,
-    const std::string result_file, std::vector<uint64_t> chunk_sizes)
+    const std::string result_file, std::vector<uint64_t> chunk_sizes, std::vector<uint64_t> schedule, bool mmsg,
+    bool lean, std::vector<uint8_t> extradata)
 {
-    
+    auto setup_start = std::chrono::high_resolution_clock::now();
+
     enum AVCodecID codec_id = AV_CODEC_ID_H265;
-    AVCodec *codec;
+    AVCodec *codec = NULL;
     AVCodecContext *c = NULL;
 
     int i;
@@ -39,30 +101,34 @@ void thread_func(void* mem, std::string local_address, uint16_t local_port,
     int y;
     int got_output;
 
-    AVFrame *frame;
+    AVFrame *frame = NULL;
     AVPacket pkt;
 
-    codec = avcodec_find_encoder(codec_id);
-    c = avcodec_alloc_context3(codec);
-
     av_log_set_level(AV_LOG_PANIC);
 
-    c->width = HEIGHT;
-    c->height = WIDTH;
-    c->time_base.num = 1;
-    c->time_base.den = fps;
-    c->pix_fmt = AV_PIX_FMT_YUV420P;
-    c->codec_type = AVMEDIA_TYPE_VIDEO;
-    c->flags = AV_CODEC_FLAG_GLOBAL_HEADER;
-
-    avcodec_open2(c, codec, NULL);
-
-    frame = av_frame_alloc();
-    frame->format = c->pix_fmt;
-    frame->width = c->width;
-    frame->height = c->height;
-    ret = av_image_alloc(frame->data, frame->linesize, c->width, c->height,
-        c->pix_fmt, 32);
+    /* The frames are already encoded, so the lean sender neither opens the encoder nor allocates
+     * a picture for it. The stream is described by codecpar and the parameter sets alone */
+    if (!lean) {
+        codec = avcodec_find_encoder(codec_id);
+        c = avcodec_alloc_context3(codec);
+
+        c->width = HEIGHT;
+        c->height = WIDTH;
+        c->time_base.num = 1;
+        c->time_base.den = fps;
+        c->pix_fmt = AV_PIX_FMT_YUV420P;
+        c->codec_type = AVMEDIA_TYPE_VIDEO;
+        c->flags = AV_CODEC_FLAG_GLOBAL_HEADER;
+
+        avcodec_open2(c, codec, NULL);
+
+        frame = av_frame_alloc();
+        frame->format = c->pix_fmt;
+        frame->width = c->width;
+        frame->height = c->height;
+        ret = av_image_alloc(frame->data, frame->linesize, c->width, c->height,
+            c->pix_fmt, 32);
+    }
 
     AVFormatContext* avfctx;
     AVOutputFormat* fmt = av_guess_format("rtp", NULL, NULL);
@@ -71,7 +137,24 @@ void thread_func(void* mem, std::string local_address, uint16_t local_port,
     snprintf(addr, 64, "rtp://%s: %d", remote_address.c_str(), remote_port + thread_num*2);
     ret = avformat_alloc_output_context2(&avfctx, fmt, fmt->name, addr);
 
-    avio_open(&avfctx->pb, avfctx->filename, AVIO_FLAG_WRITE);
+    mmsg_io *io = nullptr;
+    AVDictionary *opts = NULL;
+
+    if (mmsg) {
+        if (!(io = mmsg_io_open_sender(remote_address, remote_port + thread_num*2))) {
+            setup_done(thread_num, setup_start);
+            nready++;
+            return;
+        }
+
+        avfctx->pb = io->avio;
+        avfctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+        /* there is no separate RTCP socket, so the sender reports would end up in the RTP port */
+        av_dict_set(&opts, "rtpflags", "skip_rtcp", 0);
+    } else {
+        open_rtp_output(avfctx, remote_address, remote_port + thread_num*2, srtp);
+    }
 
     struct AVStream* stream = avformat_new_stream(avfctx, codec);
     /* stream->codecpar->bit_rate = 400000; */
@@ -82,11 +165,22 @@ void thread_func(void* mem, std::string local_address, uint16_t local_port,
     stream->time_base.num = 1;
     stream->time_base.den = fps;
 
-    (void)avformat_write_header(avfctx, NULL);
+    if (lean && !extradata.empty()) {
+        stream->codecpar->extradata = (uint8_t *)av_mallocz(extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+        stream->codecpar->extradata_size = extradata.size();
+        memcpy(stream->codecpar->extradata, extradata.data(), extradata.size());
+    }
+
+    (void)avformat_write_header(avfctx, &opts);
+    av_dict_free(&opts);
+
+    setup_done(thread_num, setup_start);
+
+    while (!start_sending)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
 
     uint64_t chunk_size = 0;
 	uint64_t current_frame = 0;
-	uint64_t period  = (uint64_t)((1000 / (float)fps) * 1000);
     size_t bytes_sent = 0;
 
 	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
@@ -100,6 +194,9 @@ void thread_func(void* mem, std::string local_address, uint16_t local_port,
         av_interleaved_write_frame(avfctx, &pkt);
         av_packet_unref(&pkt);
 
+        if (io)
+            (void)mmsg_io_flush(io);
+
         ++current_frame;
         bytes_sent += chunk_size;
 
@@ -107,8 +204,8 @@ void thread_func(void* mem, std::string local_address, uint16_t local_port,
             std::chrono::high_resolution_clock::now() - start
             ).count();
 
-        if (runtime < current_frame * period)
-            std::this_thread::sleep_for(std::chrono::microseconds(current_frame * period - runtime));
+        if (current_frame < schedule.size() && runtime < schedule[current_frame])
+            std::this_thread::sleep_for(std::chrono::microseconds(schedule[current_frame] - runtime));
     }
 
     auto end = std::chrono::high_resolution_clock::now();
@@ -116,19 +213,30 @@ void thread_func(void* mem, std::string local_address, uint16_t local_port,
 
     write_send_results_to_file(result_file, bytes_sent, diff);
 
+    if (io) {
+        std::cout << "Thread " << thread_num << ": " << io->packets << " packets in " << io->syscalls
+            << " sendmmsg() calls" << std::endl;
+        mmsg_io_close(io);
+    }
+
     nready++;
 
-    avcodec_close(c);
-    av_free(c);
-    av_freep(&frame->data[0]);
-    av_frame_free(&frame);
+    if (c) {
+        avcodec_close(c);
+        av_free(c);
+    }
+
+    if (frame) {
+        av_freep(&frame->data[0]);
+        av_frame_free(&frame);
+    }
 }
 
 int main(int argc, char **argv)
 {
-    if (argc != 11) {
+    if (argc != 11 && argc != 12) {
         fprintf(stderr, "usage: ./%s <input file> <result file> <local address> <local port> <remote address> <remote port> \
-            <number of threads> <fps> <format> <srtp> \n", __FILE__);
+            <number of threads> <fps>[@<trace file|index>[@<speed>]] <format> <srtp> [lean][+mmsg]\n", __FILE__);
         return EXIT_FAILURE;
     }
 
@@ -145,6 +253,25 @@ int main(int argc, char **argv)
     bool vvc_enabled = get_vvc_state(argv[9]);
     bool srtp_enabled = get_srtp_state(argv[10]);
 
+    /* lean: the output stream is built from codecpar and the parameter sets of the input file,
+     *   without the encoder context and the 4K picture that were never used for anything
+     * mmsg: the RTP muxer writes into a custom AVIOContext that sends the packets of each frame
+     *   with sendmmsg() instead of the rtp:// URL protocol, which does one sendto() per packet */
+    std::string mode  = (argc == 12) ? argv[11] : "";
+    bool lean_enabled = mode.find("lean") != std::string::npos;
+    bool mmsg_enabled = mode.find("mmsg") != std::string::npos;
+
+    if (!mode.empty() && !lean_enabled && !mmsg_enabled) {
+        std::cerr << "Unknown sender mode: " << mode << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the packets are encrypted by the srtp:// protocol, which the mmsg context replaces
+    if (srtp_enabled && mmsg_enabled) {
+        std::cerr << "SRTP is not supported with mmsg" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     std::cout << "Starting FFMpeg sender tests. " << local_address << ":" << local_port
         << "->" << remote_address << ":" << remote_port << std::endl;
 
@@ -165,13 +292,56 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
+    std::vector<uint64_t> schedule;
+    if (!get_send_schedule(argv[8], input_file, chunk_sizes.size(), schedule)) {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> extradata;
+    if (lean_enabled) {
+        extradata = get_parameter_sets((uint8_t *)mem, chunk_sizes[0], vvc_enabled);
+    }
+
     std::vector<std::thread*> threads;
+    setup_us.resize(nthreads);
+
+    size_t rss_before = get_rss_kb();
+    auto setup_start  = std::chrono::high_resolution_clock::now();
 
     for (int i = 0; i < nthreads; ++i) {
         threads.push_back(new std::thread(thread_func, mem, local_address, local_port, remote_address,
-            remote_port, i, fps, vvc_enabled, srtp_enabled, result_file, chunk_sizes));
+            remote_port, i, fps, vvc_enabled, srtp_enabled, result_file, chunk_sizes, schedule, mmsg_enabled,
+            lean_enabled, extradata));
     }
 
+    while (nsetup.load() != nthreads)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    uint64_t setup_total_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - setup_start).count();
+    size_t rss_after = get_rss_kb();
+
+    start_sending = true;
+
+    uint64_t setup_max_us = 0;
+    uint64_t setup_sum_us = 0;
+    for (auto us : setup_us) {
+        setup_max_us = std::max(setup_max_us, us);
+        setup_sum_us += us;
+    }
+
+    double rss_per_stream = (rss_after > rss_before) ? (rss_after - rss_before) / 1024.0 / nthreads : 0;
+
+    // <full|lean>;<streams>;<avg stream setup ms>;<max stream setup ms>;<total setup ms>;<RSS per stream MB>
+    std::ofstream setup_file(result_file + "_setup", std::ios::out | std::ios::app | std::ios::ate);
+    setup_file << (lean_enabled ? "lean" : "full") << ";" << nthreads << ";" << setup_sum_us / 1000.0 / nthreads
+        << ";" << setup_max_us / 1000.0 << ";" << setup_total_us / 1000.0 << ";" << rss_per_stream << std::endl;
+    setup_file.close();
+
+    std::cout << "Set up " << nthreads << " streams (" << (lean_enabled ? "lean" : "full") << ") in "
+        << setup_total_us / 1000.0 << " ms, " << setup_sum_us / 1000.0 / nthreads << " ms and " << rss_per_stream
+        << " MB per stream" << std::endl;
+
     for (unsigned int i = 0; i < threads.size(); ++i) {
         if (threads[i]->joinable())
         {
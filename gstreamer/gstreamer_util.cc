@@ -0,0 +1,186 @@
+#include "gstreamer_util.hh"
+
+#include <arpa/inet.h>
+
+#include <cstring>
+#include <iostream>
+
+// Same payload type as in uvgRTP and Live555
+#define PAYLOAD_TYPE 96
+
+// Largest RTP packet, same as the pkt_size default of the FFmpeg testers
+#define PACKET_SIZE 1472
+
+// Same socket buffer size as the other testers
+#define SOCKET_BUFFER_SIZE (40 * 1000 * 1000)
+
+#define RTP_HEADER_SIZE 12
+#define RTP_MARKER_OFFSET 1
+#define RTP_TS_OFFSET 4
+
+static GstElement *create_pipeline(const std::string& description)
+{
+    GError *error = nullptr;
+    GstElement *pipeline = gst_parse_launch(description.c_str(), &error);
+
+    if (error) {
+        std::cerr << "Failed to create pipeline \"" << description << "\": " << error->message << std::endl;
+        g_error_free(error);
+
+        if (pipeline)
+            gst_object_unref(pipeline);
+        return nullptr;
+    }
+
+    return pipeline;
+}
+
+static GstPadProbeReturn record_rtp_header(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    (void)pad;
+
+    rtp_packet_info *packet = (rtp_packet_info *)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    uint8_t header[RTP_HEADER_SIZE];
+
+    if (gst_buffer_extract(buffer, 0, header, sizeof(header)) == sizeof(header)) {
+        uint32_t ts = 0;
+        memcpy(&ts, header + RTP_TS_OFFSET, sizeof(ts));
+
+        packet->prev_ts     = packet->ts;
+        packet->prev_marker = packet->marker;
+        packet->ts          = ntohl(ts);
+        packet->marker      = header[RTP_MARKER_OFFSET] & 0x80;
+        packet->packets++;
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+GstElement *create_sender_pipeline(std::string remote_address, int remote_port, GstAppSrc **appsrc)
+{
+    /* the frames are paced by the tester, so neither end waits for the pipeline clock */
+    std::string description =
+        "appsrc name=src is-live=true format=time "
+            "caps=video/x-h265,stream-format=byte-stream,alignment=au "
+        "! rtph265pay pt=" + std::to_string(PAYLOAD_TYPE) + " mtu=" + std::to_string(PACKET_SIZE) +
+            " timestamp-offset=0 "
+        "! udpsink host=" + remote_address + " port=" + std::to_string(remote_port) +
+            " buffer-size=" + std::to_string(SOCKET_BUFFER_SIZE) + " sync=false async=false";
+
+    GstElement *pipeline = create_pipeline(description);
+
+    if (!pipeline)
+        return nullptr;
+
+    GstElement *src = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+    *appsrc = GST_APP_SRC(src);
+
+    /* the pipeline keeps its own reference */
+    gst_object_unref(src);
+
+    return pipeline;
+}
+
+GstElement *create_receiver_pipeline(std::string local_address, int local_port, GstAppSink **appsink,
+    rtp_packet_info *packet)
+{
+    std::string description =
+        "udpsrc address=" + local_address + " port=" + std::to_string(local_port) +
+            " buffer-size=" + std::to_string(SOCKET_BUFFER_SIZE) +
+            " caps=\"application/x-rtp,media=video,clock-rate=" + std::to_string(RTP_CLOCK) +
+            ",encoding-name=H265,payload=" + std::to_string(PAYLOAD_TYPE) + "\" "
+        "! rtph265depay name=depay "
+        "! appsink name=sink caps=video/x-h265,stream-format=byte-stream,alignment=au sync=false";
+
+    GstElement *pipeline = create_pipeline(description);
+
+    if (!pipeline)
+        return nullptr;
+
+    GstElement *sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+    *appsink = GST_APP_SINK(sink);
+    gst_object_unref(sink);
+
+    if (packet) {
+        GstElement *depay = gst_bin_get_by_name(GST_BIN(pipeline), "depay");
+        GstPad *pad = gst_element_get_static_pad(depay, "sink");
+
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, record_rtp_header, packet, nullptr);
+
+        gst_object_unref(pad);
+        gst_object_unref(depay);
+    }
+
+    return pipeline;
+}
+
+bool get_access_unit_timestamp(rtp_packet_info *packet, uint32_t *ts)
+{
+    bool first_output = packet->output_packet != packet->packets;
+    packet->output_packet = packet->packets;
+
+    /* the first packet of the next access unit flushed an access unit that did not end with the marker bit.
+     * If that packet also has the marker bit, the access unit given out after it is the new one */
+    if (first_output && !packet->prev_marker && packet->prev_ts != packet->ts)
+        return false;
+
+    *ts = packet->ts;
+    return packet->marker;
+}
+
+GstBuffer *wrap_chunk(uint8_t *data, size_t len, uint64_t pts_us)
+{
+    GstBuffer *buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, data, len, 0, len,
+        nullptr, nullptr);
+
+    GST_BUFFER_PTS(buffer) = pts_us * GST_USECOND;
+    GST_BUFFER_DTS(buffer) = GST_BUFFER_PTS(buffer);
+
+    return buffer;
+}
+
+bool start_pipeline(GstElement *pipeline)
+{
+    if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        std::cerr << "Failed to start the pipeline" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool wait_for_eos(GstElement *pipeline)
+{
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+        (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+
+    bool ok = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+
+    if (msg && !ok) {
+        GError *error = nullptr;
+        gst_message_parse_error(msg, &error, nullptr);
+
+        std::cerr << "Pipeline failed: " << (error ? error->message : "unknown error") << std::endl;
+
+        if (error)
+            g_error_free(error);
+    }
+
+    if (msg)
+        gst_message_unref(msg);
+
+    gst_object_unref(bus);
+
+    return ok;
+}
+
+void stop_pipeline(GstElement *pipeline)
+{
+    if (!pipeline)
+        return;
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+}
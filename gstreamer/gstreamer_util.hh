@@ -0,0 +1,53 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+#include <cstdint>
+#include <string>
+
+/* The GStreamer testers push the chunks of the test file into an appsrc ! rtph265pay ! udpsink pipeline
+ * and take the access units out of an udpsrc ! rtph265depay ! appsink pipeline, so that only the RTP
+ * elements of GStreamer are between the benchmark and the network, like with the other libraries */
+
+constexpr uint32_t RTP_CLOCK = 90000;
+
+/* RTP header fields of the packets going into the depayloader, recorded by the probe of
+ * create_receiver_pipeline(). Only used in the streaming thread of the receiving pipeline */
+struct rtp_packet_info {
+    uint64_t packets = 0;       // Packets seen so far
+    uint32_t ts = 0;            // Timestamp and marker bit of the latest packet
+    bool marker = false;
+    uint32_t prev_ts = 0;       // Timestamp and marker bit of the packet before it
+    bool prev_marker = true;
+    uint64_t output_packet = 0; // Latest packet during which an access unit was given out
+};
+
+/* Create a pipeline that sends the H.265 access units pushed into *appsrc to remote_address:remote_port.
+ * The RTP timestamp of a buffer is its pts, without a random offset. Returns nullptr on failure */
+GstElement *create_sender_pipeline(std::string remote_address, int remote_port, GstAppSrc **appsrc);
+
+/* Create a pipeline that gives the H.265 access units received on local_address:local_port to *appsink
+ * in byte-stream format. If packet is given, it is updated from the RTP header of each packet before the
+ * packet is depacketized. The new-sample callback of the appsink runs in the same thread, so it can find
+ * the timestamp of the access unit with get_access_unit_timestamp() */
+GstElement *create_receiver_pipeline(std::string local_address, int local_port, GstAppSink **appsink,
+    rtp_packet_info *packet);
+
+/* Find the RTP timestamp of an access unit in the new-sample callback. An access unit normally ends with
+ * the marker bit, so the latest packet is its last one. If the last packet was lost, the depayloader gives
+ * the access unit out only when a packet of the next one arrives, and its timestamp is not known.
+ * Returns false for such access units */
+bool get_access_unit_timestamp(rtp_packet_info *packet, uint32_t *ts);
+
+/* Wrap a chunk of the test file into a buffer without copying it. pts_us is the send time of the
+ * chunk from the schedule, so the RTP timestamps follow the pacing */
+GstBuffer *wrap_chunk(uint8_t *data, size_t len, uint64_t pts_us);
+
+bool start_pipeline(GstElement *pipeline);
+
+// Wait until everything pushed before gst_app_src_end_of_stream() has been sent
+bool wait_for_eos(GstElement *pipeline);
+
+void stop_pipeline(GstElement *pipeline);
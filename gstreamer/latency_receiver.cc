@@ -0,0 +1,133 @@
+#include "gstreamer_util.hh"
+#include "../util/util.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Same as the Live555 echo receiver, the test ends when nothing has been received for this long
+#define INACTIVITY_TIMEOUT_MS 2000
+
+// How long to wait for the first frame before the test counts as failed
+#define START_TIMEOUT_MS 10000
+
+/* RTP header of the packet being depacketized, set by the probe of create_receiver_pipeline() */
+static rtp_packet_info rtp_packet;
+
+static std::atomic<size_t> frames(0);
+static size_t unmatched = 0;
+
+/* Each received access unit is pushed back right away. Both ends use rtph265pay without a timestamp offset,
+ * so the pts is set from the RTP timestamp as it is and the latency sender can tell which frame came back.
+ * The pts is rounded up so that rtph265pay gives back the same timestamp. An access unit whose timestamp
+ * is not known is not echoed, since the sender would match it to the wrong frame */
+static GstFlowReturn echo_sample(GstAppSink *appsink, gpointer user_data)
+{
+    GstAppSrc *appsrc = (GstAppSrc *)user_data;
+    GstSample *sample = gst_app_sink_pull_sample(appsink);
+
+    if (!sample)
+        return GST_FLOW_EOS;
+
+    uint32_t ts = 0;
+
+    if (!get_access_unit_timestamp(&rtp_packet, &ts)) {
+        ++unmatched;
+        ++frames;
+        gst_sample_unref(sample);
+        return GST_FLOW_OK;
+    }
+
+    /* a new reference to the same memory, only the metadata is copied */
+    GstBuffer *buffer = gst_buffer_make_writable(gst_buffer_ref(gst_sample_get_buffer(sample)));
+
+    GST_BUFFER_PTS(buffer) = gst_util_uint64_scale_ceil(ts, GST_SECOND, RTP_CLOCK);
+    GST_BUFFER_DTS(buffer) = GST_BUFFER_PTS(buffer);
+
+    GstFlowReturn ret = gst_app_src_push_buffer(appsrc, buffer);
+    ++frames;
+
+    gst_sample_unref(sample);
+    return ret;
+}
+
+static int receiver(std::string local_address, int local_port, std::string remote_address, int remote_port)
+{
+    GstAppSrc *appsrc = nullptr;
+    GstAppSink *appsink = nullptr;
+
+    GstElement *send_pipeline = create_sender_pipeline(remote_address, remote_port, &appsrc);
+    GstElement *recv_pipeline = create_receiver_pipeline(local_address, local_port, &appsink, &rtp_packet);
+
+    if (!send_pipeline || !recv_pipeline) {
+        stop_pipeline(send_pipeline);
+        stop_pipeline(recv_pipeline);
+        return EXIT_FAILURE;
+    }
+
+    GstAppSinkCallbacks callbacks = {};
+    callbacks.new_sample = echo_sample;
+    gst_app_sink_set_callbacks(appsink, &callbacks, appsrc, nullptr);
+
+    if (!start_pipeline(send_pipeline) || !start_pipeline(recv_pipeline)) {
+        stop_pipeline(send_pipeline);
+        stop_pipeline(recv_pipeline);
+        return EXIT_FAILURE;
+    }
+
+    size_t prev_frames = 0;
+    int idle_ms = 0;
+
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        if (frames != prev_frames) {
+            prev_frames = frames;
+            idle_ms = 0;
+            continue;
+        }
+
+        idle_ms += 10;
+
+        if (prev_frames ? idle_ms >= INACTIVITY_TIMEOUT_MS : idle_ms >= START_TIMEOUT_MS)
+            break;
+    }
+
+    /* the receiving side goes first, so nothing is pushed into a stopped appsrc */
+    stop_pipeline(recv_pipeline);
+    stop_pipeline(send_pipeline);
+
+    fprintf(stderr, "%zu frames echoed, %zu without a known RTP timestamp left out\n", prev_frames - unmatched,
+        unmatched);
+
+    return prev_frames ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 7) {
+        fprintf(stderr, "usage: ./%s <local address> <local port> <remote address> <remote port> \
+            <format> <srtp>\n", __FILE__);
+        return EXIT_FAILURE;
+    }
+
+    std::string local_address = argv[1];
+    int local_port = atoi(argv[2]);
+    std::string remote_address = argv[3];
+    int remote_port = atoi(argv[4]);
+    bool vvc_enabled = get_vvc_state(argv[5]);
+    bool srtp_enabled = get_srtp_state(argv[6]);
+
+    if (vvc_enabled || srtp_enabled)
+    {
+        std::cerr << "Unsupported option for GStreamer tester" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    gst_init(&argc, &argv);
+
+    return receiver(local_address, local_port, remote_address, remote_port);
+}
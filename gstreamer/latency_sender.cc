@@ -0,0 +1,230 @@
+#include "gstreamer_util.hh"
+#include "../util/util.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::chrono;
+
+// Stop waiting for echoed frames when everything has been sent and nothing has come back for this long
+#define RECEIVE_TIMEOUT_MS 500
+
+/* Latency samples, one per frame, allocated before sending. Frame n is sent with the pts of its send time,
+ * which rtph265pay turns into the RTP timestamp. The echo receiver keeps the spacing of the timestamps
+ * relative to the first frame, so the frame of an echoed access unit is found from its RTP timestamp.
+ * rtph265depay gives out an access unit when its last packet has arrived */
+struct frame_info {
+    high_resolution_clock::time_point sent;
+    high_resolution_clock::time_point received;
+    bool intra = false;
+};
+
+static std::vector<frame_info> frame_table;
+static std::unordered_map<uint32_t, size_t> ts_frames;   // RTP timestamp -> frame
+
+/* RTP header of the packet being depacketized, set by the probe of create_receiver_pipeline() */
+static rtp_packet_info rtp_packet;
+static std::atomic<size_t> echoed(0);
+static size_t unmatched = 0;
+
+static GstFlowReturn new_sample(GstAppSink *appsink, gpointer user_data)
+{
+    (void)user_data;
+
+    GstSample *sample = gst_app_sink_pull_sample(appsink);
+
+    if (!sample)
+        return GST_FLOW_EOS;
+
+    uint32_t ts = 0;
+    auto it = ts_frames.end();
+
+    /* an access unit whose last packet was lost has no known timestamp and is not timed */
+    if (!get_access_unit_timestamp(&rtp_packet, &ts))
+        ++unmatched;
+    else if ((it = ts_frames.find(ts)) == ts_frames.end())
+        fprintf(stderr, "RTP timestamp %u does not belong to any frame!\n", ts);
+    else if (frame_table[it->second].received == high_resolution_clock::time_point())
+        frame_table[it->second].received = high_resolution_clock::now();
+
+    ++echoed;
+
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+
+/* Frames with an IRAP slice (types 16-21) are intra frames */
+static void build_frame_table(uint8_t *mem, const std::vector<uint64_t>& chunk_sizes,
+    const std::vector<uint64_t>& schedule)
+{
+    uint64_t offset = 0;
+
+    frame_table.resize(chunk_sizes.size());
+
+    for (size_t i = 0; i < chunk_sizes.size(); ++i) {
+        std::vector<std::pair<size_t, uint8_t *>> nals;
+        scan_nal_units(mem + offset, chunk_sizes[i], nals);
+
+        for (auto& nal : nals) {
+            uint8_t type = (nal.second[0] >> 1) & 0x3f;
+            frame_table[i].intra |= (type >= 16 && type <= 21);
+        }
+
+        /* the same conversion as in rtph265pay. Frames sent at the same time share the
+         * timestamp, and the first of them is the one that is matched */
+        uint32_t ts = (uint32_t)gst_util_uint64_scale_int((schedule[i] - schedule[0]) * GST_USECOND,
+            RTP_CLOCK, GST_SECOND);
+        ts_frames.emplace(ts, i);
+
+        offset += chunk_sizes[i];
+    }
+}
+
+static int sender(std::string input_file, std::string local_address, int local_port, std::string remote_address,
+    int remote_port, const char *pacing)
+{
+    size_t len = 0;
+    void *mem  = get_mem(input_file, len);
+
+    std::vector<uint64_t> chunk_sizes;
+    get_chunk_sizes(get_chunk_filename(input_file), chunk_sizes);
+
+    if (mem == nullptr || chunk_sizes.empty()) {
+        std::cerr << "Failed to get file: " << input_file << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint64_t> schedule;
+    if (!get_send_schedule(pacing, input_file, chunk_sizes.size(), schedule)) {
+        return EXIT_FAILURE;
+    }
+
+    build_frame_table((uint8_t *)mem, chunk_sizes, schedule);
+
+    GstAppSrc *appsrc = nullptr;
+    GstAppSink *appsink = nullptr;
+
+    /* the echoed stream is received on the local port */
+    GstElement *send_pipeline = create_sender_pipeline(remote_address, remote_port, &appsrc);
+    GstElement *recv_pipeline = create_receiver_pipeline(local_address, local_port, &appsink, &rtp_packet);
+
+    if (!send_pipeline || !recv_pipeline) {
+        stop_pipeline(send_pipeline);
+        stop_pipeline(recv_pipeline);
+        return EXIT_FAILURE;
+    }
+
+    GstAppSinkCallbacks callbacks = {};
+    callbacks.new_sample = new_sample;
+    gst_app_sink_set_callbacks(appsink, &callbacks, nullptr, nullptr);
+
+    if (!start_pipeline(recv_pipeline) || !start_pipeline(send_pipeline)) {
+        stop_pipeline(send_pipeline);
+        stop_pipeline(recv_pipeline);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t current_frame = 0;
+    uint64_t offset = 0;
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    for (auto& chunk_size : chunk_sizes)
+    {
+        GstBuffer *buffer = wrap_chunk((uint8_t *)mem + offset, chunk_size,
+            schedule[current_frame] - schedule[0]);
+
+        frame_table[current_frame].sent = high_resolution_clock::now();
+
+        if (gst_app_src_push_buffer(appsrc, buffer) != GST_FLOW_OK) {
+            std::cerr << "Latency test push failed!" << std::endl;
+            break;
+        }
+
+        current_frame++;
+        offset += chunk_size;
+
+        auto runtime = (uint64_t)duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+
+        if (current_frame < schedule.size() && runtime < schedule[current_frame])
+            std::this_thread::sleep_for(microseconds(schedule[current_frame] - runtime));
+    }
+
+    size_t prev_echoed = SIZE_MAX;
+
+    while (prev_echoed != echoed) {
+        prev_echoed = echoed;
+        std::this_thread::sleep_for(milliseconds(RECEIVE_TIMEOUT_MS));
+    }
+
+    stop_pipeline(send_pipeline);
+    stop_pipeline(recv_pipeline);
+
+    if (unmatched)
+        std::cerr << unmatched << " echoed access units without a known RTP timestamp were left out" << std::endl;
+
+    size_t frames = 0, intras = 0, inters = 0;
+    double frame_total = 0, intra_total = 0, inter_total = 0;
+
+    for (auto& frame : frame_table) {
+        if (frame.received == high_resolution_clock::time_point())
+            continue;
+
+        double diff = duration_cast<microseconds>(frame.received - frame.sent).count() / 1000.0;
+
+        if (frame.intra)
+            intra_total += diff, intras++;
+        else
+            inter_total += diff, inters++;
+
+        frame_total += diff;
+        frames++;
+    }
+
+    fprintf(stderr, "%zu: intra %lf, inter %lf, avg %lf\n",
+        frames,
+        intra_total / intras,
+        inter_total / inters,
+        frame_total / frames
+    );
+
+    write_latency_results_to_file("latency_results", frames, intra_total / intras, inter_total / inters,
+        frame_total / frames);
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 9) {
+        fprintf(stderr, "usage: ./%s <input file> <local address> <local port> <remote address> <remote port> \
+            <fps>[@<trace file|index>[@<speed>]] <format> <srtp>\n", __FILE__);
+        return EXIT_FAILURE;
+    }
+
+    std::string input_file = argv[1];
+
+    std::string local_address = argv[2];
+    int local_port = atoi(argv[3]);
+    std::string remote_address = argv[4];
+    int remote_port = atoi(argv[5]);
+
+    bool vvc_enabled = get_vvc_state(argv[7]);
+    bool srtp_enabled = get_srtp_state(argv[8]);
+
+    if (vvc_enabled || srtp_enabled)
+    {
+        std::cerr << "Unsupported option for GStreamer tester" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    gst_init(&argc, &argv);
+
+    return sender(input_file, local_address, local_port, remote_address, remote_port, argv[6]);
+}
@@ -0,0 +1,149 @@
+#include "gstreamer_util.hh"
+#include "../util/util.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Same as uvgRTP and Live555, a stream that has not received anything for this long is stopped
+#define INACTIVITY_TIMEOUT_MS 2000
+
+// How long a stream waits for its first frame before the test counts as failed
+#define START_TIMEOUT_MS 10000
+
+std::atomic<int> timeouts(0);
+
+/* Updated by the new-sample callback in the streaming thread of the pipeline */
+struct stream_info {
+    std::atomic<size_t> frames{0};
+    size_t bytes = 0;
+    std::chrono::high_resolution_clock::time_point start, last;
+};
+
+static GstFlowReturn new_sample(GstAppSink *appsink, gpointer user_data)
+{
+    stream_info *info = (stream_info *)user_data;
+    GstSample *sample = gst_app_sink_pull_sample(appsink);
+
+    if (!sample)
+        return GST_FLOW_EOS;
+
+    info->last = std::chrono::high_resolution_clock::now();
+
+    if (info->frames == 0)
+        info->start = info->last;
+
+    info->bytes += gst_buffer_get_size(gst_sample_get_buffer(sample));
+    ++info->frames;
+
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+
+/* Each stream runs in its own thread with its own pipeline.
+ * Stream n listens on local port + 2 * n, the same way as the uvgRTP receiver */
+static void receiver_thread(int thread_num, std::string result_file, std::string local_address, int local_port)
+{
+    stream_info info;
+    GstAppSink *appsink = nullptr;
+    GstElement *pipeline = create_receiver_pipeline(local_address, local_port + thread_num * 2, &appsink, nullptr);
+
+    if (!pipeline) {
+        ++timeouts;
+        return;
+    }
+
+    GstAppSinkCallbacks callbacks = {};
+    callbacks.new_sample = new_sample;
+    gst_app_sink_set_callbacks(appsink, &callbacks, &info, nullptr);
+
+    if (!start_pipeline(pipeline)) {
+        ++timeouts;
+        stop_pipeline(pipeline);
+        return;
+    }
+
+    /* the stream ends when no frames have come for a while, the frames are counted by the callback */
+    size_t prev_frames = 0;
+    int idle_ms = 0;
+
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        size_t frames = info.frames;
+
+        if (frames != prev_frames) {
+            prev_frames = frames;
+            idle_ms = 0;
+            continue;
+        }
+
+        idle_ms += 10;
+
+        if (frames ? idle_ms >= INACTIVITY_TIMEOUT_MS : idle_ms >= START_TIMEOUT_MS)
+            break;
+    }
+
+    stop_pipeline(pipeline);
+
+    if (!prev_frames) {
+        std::cerr << "No frames received on port " << local_port + thread_num * 2 << std::endl;
+        ++timeouts;
+        return;
+    }
+
+    write_receive_results_to_file(result_file, info.bytes, info.frames,
+        std::chrono::duration_cast<std::chrono::milliseconds>(info.last - info.start).count());
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 9) {
+        fprintf(stderr, "usage: ./%s <result file> <local address> <local port> <remote address> <remote port> \
+            <number of threads> <format> <srtp>\n", __FILE__);
+        return EXIT_FAILURE;
+    }
+
+    std::string result_filename = argv[1];
+    std::string local_address = argv[2];
+    int local_port = atoi(argv[3]);
+    std::string remote_address = argv[4];
+    int remote_port = atoi(argv[5]);
+
+    int nthreads = atoi(argv[6]);
+    bool vvc_enabled = get_vvc_state(argv[7]);
+    bool srtp_enabled = get_srtp_state(argv[8]);
+
+    if (vvc_enabled || srtp_enabled)
+    {
+        std::cerr << "Unsupported option for GStreamer tester" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (nthreads <= 0) {
+        std::cerr << "Invalid number of threads: " << nthreads << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Starting GStreamer receiver tests with " << nthreads << " streams. " << local_address << ":"
+        << local_port << "<-" << remote_address << ":" << remote_port << std::endl;
+
+    gst_init(&argc, &argv);
+
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < nthreads; ++i) {
+        threads.emplace_back(receiver_thread, i, result_filename, local_address, local_port);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // a stream that received nothing fails the run, like in the Live555 receiver
+    return timeouts ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+#include "gstreamer_util.hh"
+#include "../util/util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Each stream runs in its own thread with its own pipeline.
+ * Stream n sends to remote port + 2 * n, the same way as the uvgRTP sender */
+static void sender_thread(int thread_num, void *mem, std::string result_file, std::string remote_address,
+    int remote_port, std::vector<uint64_t> chunk_sizes, std::vector<uint64_t> schedule)
+{
+    GstAppSrc *appsrc = nullptr;
+    GstElement *pipeline = create_sender_pipeline(remote_address, remote_port + thread_num * 2, &appsrc);
+
+    if (!pipeline || !start_pipeline(pipeline)) {
+        std::cerr << "Send test setup failed! Please fix benchmark suite." << std::endl;
+        stop_pipeline(pipeline);
+        return;
+    }
+
+    size_t bytes_sent = 0;
+    uint64_t current_frame = 0;
+
+    // start the sending test
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    for (auto& chunk_size : chunk_sizes)
+    {
+        GstBuffer *buffer = wrap_chunk((uint8_t *)mem + bytes_sent, chunk_size, schedule[current_frame]);
+
+        if (gst_app_src_push_buffer(appsrc, buffer) != GST_FLOW_OK) {
+            std::cerr << "Send test push failed! Please fix benchmark suite." << std::endl;
+            stop_pipeline(pipeline);
+            return;
+        }
+
+        bytes_sent += chunk_size;
+        current_frame += 1;
+
+        auto runtime = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - start
+            ).count();
+
+        // this enforces the fps restriction (or the trace) by waiting until it is time to send next frame
+        if (current_frame < schedule.size() && runtime < schedule[current_frame])
+            std::this_thread::sleep_for(std::chrono::microseconds(schedule[current_frame] - runtime));
+    }
+
+    /* appsrc only queues the buffers, the frames have been sent when the end of stream reaches udpsink */
+    gst_app_src_end_of_stream(appsrc);
+    bool sent = wait_for_eos(pipeline);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    uint64_t diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+    if (sent)
+        write_send_results_to_file(result_file, bytes_sent, diff);
+
+    stop_pipeline(pipeline);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 11) {
+        fprintf(stderr, "usage: ./%s <input file> <result file> <local address> <local port> <remote address> <remote port> \
+            <number of threads> <fps>[@<trace file|index>[@<speed>]] <format> <srtp>\n", __FILE__);
+        return EXIT_FAILURE;
+    }
+
+    std::string input_file = argv[1];
+    std::string result_file = argv[2];
+
+    std::string local_address = argv[3];
+    int local_port = atoi(argv[4]);
+    std::string remote_address = argv[5];
+    int remote_port = atoi(argv[6]);
+
+    int nthreads = atoi(argv[7]);
+    bool vvc_enabled = get_vvc_state(argv[9]);
+    bool srtp_enabled = get_srtp_state(argv[10]);
+
+    if (vvc_enabled || srtp_enabled)
+    {
+        std::cerr << "Unsupported option for GStreamer tester" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (nthreads <= 0) {
+        std::cerr << "Invalid number of threads: " << nthreads << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Starting GStreamer sender tests. " << local_address << ":" << local_port
+        << "->" << remote_address << ":" << remote_port << std::endl;
+
+    gst_init(&argc, &argv);
+
+    size_t len = 0;
+    void *mem  = get_mem(input_file, len);
+
+    std::vector<uint64_t> chunk_sizes;
+    get_chunk_sizes(get_chunk_filename(input_file), chunk_sizes);
+
+    if (mem == nullptr || chunk_sizes.empty())
+    {
+        std::cerr << "Failed to get file: " << input_file << std::endl;
+        std::cerr << "or chunk location file: " << get_chunk_filename(input_file) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint64_t> schedule;
+    if (!get_send_schedule(argv[8], input_file, chunk_sizes.size(), schedule)) {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < nthreads; ++i) {
+        threads.emplace_back(sender_thread, i, mem, result_file, remote_address, remote_port, chunk_sizes, schedule);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return EXIT_SUCCESS;
+}
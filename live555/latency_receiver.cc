@@ -5,7 +5,6 @@
 #include <RTPInterface.hh>
 #include <chrono>
 #include <climits>
-#include <mutex>
 #include <thread>
 
 #include "latsink.hh"
@@ -23,7 +22,13 @@ static size_t bytes        = 0;
 static uint8_t *nal_ptr = nullptr;
 static size_t nal_size  = 0;
 
-static std::mutex lat_mtx;
+/* presentation time of the received NAL unit. It is given to the echoed NAL unit, so the echo keeps
+ * the spacing of the RTP timestamps and the latency sender can tell which frame came back */
+static struct timeval nal_time;
+
+/* set when the sink has a received NAL unit for the echo source. Both run in the event loop
+ * so a plain flag is enough */
+static bool nal_ready = false;
 static std::chrono::high_resolution_clock::time_point start;
 static std::chrono::high_resolution_clock::time_point last;
 
@@ -108,8 +113,9 @@ void RTPLatencySink::afterGettingFrame(
 
     nal_ptr  = fReceiveBuffer;
     nal_size = frameSize;
+    nal_time = presentationTime;
 
-    lat_mtx.unlock();
+    nal_ready = true;
     framedSource->deliver_frame();
 
     if (++frames == 602) {
@@ -188,8 +194,9 @@ void H265FramedSource::deliverFrame()
     if (!isCurrentlyAwaitingData())
         return;
 
-    if (!lat_mtx.try_lock())
+    if (!nal_ready)
         return;
+    nal_ready = false;
 
     uint8_t *newFrameDataStart = nal_ptr;
     unsigned newFrameSize      = nal_size;
@@ -204,6 +211,7 @@ void H265FramedSource::deliverFrame()
     }
 
     fDurationInMicroseconds = 0;
+    fPresentationTime       = nal_time;
     memmove(fTo, newFrameDataStart, fFrameSize);
 
     FramedSource::afterGetting(this);
@@ -224,7 +232,6 @@ static int receiver(std::string local_address, int local_port,
     env       = BasicUsageEnvironment::createNew(*scheduler);
 
     OutPacketBuffer::maxSize = 40 * 1000 * 1000;
-    lat_mtx.lock();
 
     /* receiver */
     addr.s_addr = our_inet_addr(local_address.c_str());
@@ -8,10 +8,8 @@
 
 #include <chrono>
 #include <climits>
-#include <mutex>
-#include <queue>
 #include <thread>
-#include <unordered_map>
+#include <vector>
 #include <string>
 
 #include "latsource.hh"
@@ -21,7 +19,8 @@ using namespace std::chrono;
 
 #define BUFFER_SIZE 40 * 1000 * 1000
 
-#define KEY(frame, size) ((((frame) % 64) << 26) + (size))
+#define FPS          30
+#define RTP_CLOCK    90000
 
 EventTriggerId H265LatencyFramedSource::eventTriggerId = 0;
 unsigned H265LatencyFramedSource::referenceCount       = 0;
@@ -38,85 +37,49 @@ static size_t intra_total = 0;
 static size_t inter_total = 0;
 static size_t frame_total = 0;
 
-static std::mutex lat_mtx;
-static std::queue<std::pair<size_t, uint8_t *>> nals;
 static high_resolution_clock::time_point s_tmr, start;
 
-typedef std::pair<high_resolution_clock::time_point, size_t> finfo;
-static std::unordered_map<uint64_t, finfo> timestamps;
-
-static const uint8_t *ff_avc_find_startcode_internal(const uint8_t *p, const uint8_t *end)
+/* NAL units of the test file, found once before sending so that the scanner is not on the critical path */
+static std::vector<std::pair<size_t, uint8_t *>> nals;
+static size_t nal_ptr = 0;
+
+/* Latency samples, one per frame, allocated before sending. Frame n is sent with the presentation time
+ * n / FPS and the echo receiver keeps the spacing of the RTP timestamps, so the frame of a received NAL unit
+ * is found from its RTP timestamp relative to the first frame. A frame is complete when all of its
+ * NAL units have come back */
+struct frame_info {
+    high_resolution_clock::time_point sent;
+    uint32_t nals     = 0;  // NAL units in the frame
+    uint32_t received = 0;  // NAL units echoed back so far
+    bool intra        = false;
+};
+
+static std::vector<frame_info> frame_table;
+static std::vector<uint32_t> nal_frames;    // frame of each NAL unit
+static bool rtp_ts_set = false;
+static uint32_t first_rtp_ts = 0;
+
+/* Frames are the NAL units up to and including the next one larger than 1500 bytes, i.e. parameter sets
+ * go with the slice after them. This is the same rule that is used to hold the frame rate */
+static void build_frame_table(void)
 {
-    const uint8_t *a = p + 4 - ((intptr_t)p & 3);
+    uint32_t frame = 0;
 
-    for (end -= 3; p < a && p < end; p++) {
-        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
-            return p;
-    }
+    frame_table.resize(1);
+    nal_frames.reserve(nals.size());
 
-    for (end -= 3; p < end; p += 4) {
-        uint32_t x = *(const uint32_t*)p;
-//      if ((x - 0x01000100) & (~x) & 0x80008000) // little endian
-//      if ((x - 0x00010001) & (~x) & 0x00800080) // big endian
-        if ((x - 0x01010101) & (~x) & 0x80808080) { // generic
-            if (p[1] == 0) {
-                if (p[0] == 0 && p[2] == 1)
-                    return p;
-                if (p[2] == 0 && p[3] == 1)
-                    return p+1;
-            }
-            if (p[3] == 0) {
-                if (p[2] == 0 && p[4] == 1)
-                    return p+2;
-                if (p[4] == 0 && p[5] == 1)
-                    return p+3;
-            }
-        }
-    }
+    for (auto& nal : nals) {
+        uint8_t type = (nal.second[0] >> 1) & 0x3f;
 
-    for (end += 3; p < end; p++) {
-        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
-            return p;
-    }
-
-    return end + 3;
-}
-
-const uint8_t *ff_avc_find_startcode(const uint8_t *p, const uint8_t *end)
-{
-    const uint8_t *out= ff_avc_find_startcode_internal(p, end);
-    if (p < out && out < end && !out[-1]) out--;
-    return out;
-}
+        nal_frames.push_back(frame);
+        frame_table[frame].nals++;
+        frame_table[frame].intra |= (type >= 16 && type <= 21);
 
-static std::pair<size_t, uint8_t *> find_next_nal(std::string input_file)
-{
-    static size_t len         = 0;
-    static uint8_t *p         = NULL;
-    static uint8_t *end       = NULL;
-    static uint8_t *nal_start = NULL;
-    static uint8_t *nal_end   = NULL;
-
-    if (!p) {
-        p   = (uint8_t *)get_mem(input_file, len);
-        end = p + len;
-        len = 0;
-
-        nal_start = (uint8_t *)ff_avc_find_startcode(p, end);
+        if (nal.first > 1500 && nal_frames.size() < nals.size()) {
+            frame_table.emplace_back();
+            ++frame;
+        }
     }
-
-    while (nal_start < end && !*(nal_start++))
-        ;
-
-    if (nal_start == end)
-        return std::make_pair(0, nullptr);
-
-    nal_end    = (uint8_t *)ff_avc_find_startcode(nal_start, end);
-    auto ret   = std::make_pair((size_t)(nal_end - nal_start), (uint8_t *)nal_start);
-    len       += 4 + nal_end - nal_start;
-    nal_start  = nal_end;
-
-    return ret;
 }
 
 H265LatencyFramedSource *H265LatencyFramedSource::createNew(UsageEnvironment& env, std::string input_file)
@@ -128,7 +91,17 @@ H265LatencyFramedSource::H265LatencyFramedSource(UsageEnvironment& env, std::str
     FramedSource(env),
     input_file_(input_file)
 {
-    period = (uint64_t)((1000 / (float)30) * 1000);
+    period = (uint64_t)((1000 / (float)FPS) * 1000);
+
+    if (nals.empty()) {
+        size_t len = 0;
+        uint8_t *mem = (uint8_t *)get_mem(input_file_, len);
+
+        if (mem)
+            get_nal_table(mem, len, input_file_, nals);
+
+        build_frame_table();
+    }
 
     if (!eventTriggerId)
         eventTriggerId = envir().taskScheduler().createEventTrigger(deliverFrame0);
@@ -162,34 +135,30 @@ void H265LatencyFramedSource::deliverFrame()
     if (!isCurrentlyAwaitingData())
         return;
 
-    auto nal = find_next_nal(input_file_);
-
-    if (!nal.first || !nal.second)
+    if (nal_ptr == nals.size())
         return;
 
+    current  = nal_frames[nal_ptr];
+    auto nal = nals[nal_ptr++];
+
     uint64_t runtime = std::chrono::duration_cast<std::chrono::microseconds>(
         std::chrono::high_resolution_clock::now() - s_tmr
     ).count();
 
+    /* try to hold fps for intra/inter frames only */
     if (runtime < current * period)
         std::this_thread::sleep_for(std::chrono::microseconds(current * period - runtime));
 
-    /* try to hold fps for intra/inter frames only */
-    if (nal.first > 1500)
-        ++current;
-
-    /* Start timer for the frame
-     * RTP sink will calculate the time difference once the frame is received */
-    /* printf("send frame %u, size %u\n", current, nal.first); */
+    /* Start timer for the frame when its first NAL unit is sent.
+     * RTP sink will calculate the time difference once the whole frame is received */
+    frame_info& frame = frame_table[current];
 
-    uint64_t key = nal.first;
+    if (frame.sent == high_resolution_clock::time_point())
+        frame.sent = std::chrono::high_resolution_clock::now();
 
-    if (timestamps.find(key) != timestamps.end()) {
-        fprintf(stderr, "cannot use size as timestamp for this frame!\n");
-        exit(EXIT_FAILURE);
-    }
-    timestamps[key].first  = std::chrono::high_resolution_clock::now();
-    timestamps[key].second = nal.first;
+    /* the RTP timestamp of the NAL unit is derived from this */
+    fPresentationTime.tv_sec  = current / FPS;
+    fPresentationTime.tv_usec = (current % FPS) * 1000000 / FPS;
 
     uint8_t *newFrameDataStart = nal.second;
     unsigned newFrameSize      = nal.first;
@@ -274,43 +243,46 @@ void RTPSink_::afterGettingFrame(
     (void)frameSize,        (void)numTruncatedBytes;
     (void)presentationTime, (void)durationInMicroseconds;
 
+    auto now = std::chrono::high_resolution_clock::now();
+
     /* start loop that monitors activity and if there has been
      * no activity for 2s (same as uvgRTP) the receiver is stopped) */
-    if (!frames)
+    if (!rtp_ts_set)
         (void)new std::thread(thread_func);
 
-    uint64_t diff;
-    uint8_t nal_type;
+    /* the first NAL unit that comes back belongs to the first frame */
+    uint32_t rtp_ts = ((RTPSource *)fSource)->curPacketRTPTimestamp();
 
-    uint64_t key = frameSize;
-    /* printf("recv frame %zu, size %u\n", frames + 1, frameSize); */
-
-    if (timestamps.find(key) == timestamps.end()) {
-        printf("frame %zu,%zu not found from set!\n", frames + 1, key);
-        exit(EXIT_FAILURE);
+    if (!rtp_ts_set) {
+        first_rtp_ts = rtp_ts;
+        rtp_ts_set   = true;
     }
 
-    if (timestamps[key].second != frameSize) {
-        printf("frame size mismatch (%zu vs %zu)\n", timestamps[key].second, frameSize);
-        exit(EXIT_FAILURE);
-    }
+    int64_t elapsed = (int32_t)(rtp_ts - first_rtp_ts);
+    int64_t index   = (elapsed * FPS + RTP_CLOCK / 2) / RTP_CLOCK;
 
-    diff = std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::high_resolution_clock::now() - timestamps[key].first
-    ).count();
-    timestamps.erase(key);
+    if (index < 0 || index >= (int64_t)frame_table.size()) {
+        fprintf(stderr, "RTP timestamp %u does not belong to any frame!\n", rtp_ts);
+        continuePlaying();
+        return;
+    }
 
-    nal_type = (fReceiveBuffer[0] >> 1) & 0x3f;
+    frame_info& frame = frame_table[index];
 
-    if (nal_type == 19 || nal_type == 1) {
-        if (nal_type == 19)
-            nintras++, intra_total += (diff / 1000);
-        else
-            ninters++, inter_total += (diff / 1000);
-        frame_total += (diff / 1000);
+    if (++frame.received != frame.nals) {
+        continuePlaying();
+        return;
     }
 
-    if (++frames == 601) {
+    uint64_t diff = std::chrono::duration_cast<std::chrono::microseconds>(now - frame.sent).count();
+
+    if (frame.intra)
+        nintras++, intra_total += (diff / 1000);
+    else
+        ninters++, inter_total += (diff / 1000);
+    frame_total += (diff / 1000);
+
+    if (++frames == frame_table.size()) {
         fprintf(stderr, "%zu: intra %lf, inter %lf, avg %lf\n",
             frames,
             intra_total / (float)nintras,
@@ -343,8 +315,6 @@ Boolean RTPSink_::continuePlaying()
 static int sender(std::string input_file, std::string local_address, int local_port,
     std::string remote_address, int remote_port)
 {
-    (void)addr;
-
     H265VideoStreamDiscreteFramer *framer;
     H265LatencyFramedSource *framedSource;
     TaskScheduler *scheduler;
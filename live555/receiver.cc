@@ -2,8 +2,46 @@
 #include <BasicUsageEnvironment.hh>
 #include <GroupsockHelper.hh>
 #include "sink.hh"
+#include "../util/util.hh"
 
+#include <atomic>
 #include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+std::atomic<int> timeouts(0);
+
+/* Each stream runs in its own thread with its own scheduler, environment, RTP source and sink.
+ * Stream n listens on local port + 2 * n, the same way as the uvgRTP receiver */
+static void receiver_thread(int thread_num, std::string result_file, std::string local_address, int local_port)
+{
+    TaskScheduler *scheduler = BasicTaskScheduler::createNew();
+    UsageEnvironment *env    = BasicUsageEnvironment::createNew(*scheduler);
+    char stop = 0;
+
+    Port rtpPort(local_port + thread_num * 2);
+    struct in_addr dst_addr;
+    dst_addr.s_addr = our_inet_addr(local_address.c_str());
+    Groupsock *rtpGroupsock = new Groupsock(*env, dst_addr, rtpPort, 255);
+
+    RTPSource *source = H265VideoRTPSource::createNew(*env, rtpGroupsock, 96);
+    RTPSink_ *sink    = new RTPSink_(*env, result_file, &stop);
+
+    sink->startPlaying(*source, nullptr, nullptr);
+    env->taskScheduler().doEventLoop(&stop);
+
+    if (sink->timedOut())
+        ++timeouts;
+
+    sink->uninit();
+    Medium::close(sink);
+    Medium::close(source);
+    delete rtpGroupsock;
+
+    env->reclaim();
+    delete scheduler;
+}
 
 int main(int argc, char **argv)
 {
@@ -13,7 +51,7 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    result_filename = argv[1];
+    std::string result_filename = argv[1];
     std::string local_address = argv[2];
     int local_port = atoi(argv[3]);
     std::string remote_address = argv[4];
@@ -29,23 +67,27 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    bool srtp = false; // TODO
+    if (nthreads <= 0) {
+        std::cerr << "Invalid number of threads: " << nthreads << std::endl;
+        return EXIT_FAILURE;
+    }
 
-    TaskScheduler *scheduler = BasicTaskScheduler::createNew();
-    UsageEnvironment *env    = BasicUsageEnvironment::createNew(*scheduler);
-
-    Port rtpPort(local_port);
-    struct in_addr dst_addr;
-    dst_addr.s_addr = our_inet_addr(local_address.c_str());
-    Groupsock rtpGroupsock(*env, dst_addr, rtpPort, 255);
+    std::cout << "Starting Live555 receiver tests with " << nthreads << " streams. " << local_address << ":" << local_port
+        << "<-" << remote_address << ":" << remote_port << std::endl;
 
+    // shared by all streams, set before any of them starts
     OutPacketBuffer::maxSize = 40 * 1000 * 1000;
 
-    RTPSource *source = H265VideoRTPSource::createNew(*env, &rtpGroupsock, 96);
-    RTPSink_ *sink    = new RTPSink_(*env);
+    std::vector<std::thread> threads;
 
-    sink->startPlaying(*source, nullptr, nullptr);
-    env->taskScheduler().doEventLoop();
+    for (int i = 0; i < nthreads; ++i) {
+        threads.emplace_back(receiver_thread, i, result_filename, local_address, local_port);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
 
-    return EXIT_SUCCESS;
+    // a stream that stopped receiving before the end fails the run, as before
+    return timeouts ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,506 @@
+#include <liveMedia/liveMedia.hh>
+#include <BasicUsageEnvironment.hh>
+#include "../util/live555_util.hh"
+#include "../util/util.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/* Session startup latency of a Live555 RTSP server. The server runs in this process and serves the
+ * test file from memory, then 1..N clients connect at the same time and each of them measures how long
+ * DESCRIBE, SETUP and PLAY take and when the first frame arrives. The clients tear their session
+ * down after the first frame, so a round measures the startup only, not the streaming */
+
+#define STREAM_NAME "stream"
+
+// Told to the server in createNewStreamSource(), only used for the socket buffer sizes
+#define ESTIMATED_BITRATE_KBPS 50000
+
+// A client that has not received its first frame by then counts as failed
+#define CLIENT_TIMEOUT_US (10 * 1000 * 1000)
+
+// Each session allocates an output buffer of this size, so it is smaller than in the goodput sender
+#define SERVER_BUFFER_SIZE (8 * 1000 * 1000)
+
+#define SINK_BUFFER_SIZE (4 * 1000 * 1000)
+
+typedef std::chrono::high_resolution_clock::time_point time_point;
+
+typedef std::vector<std::pair<size_t, uint8_t *>> nal_table;
+typedef std::vector<std::pair<size_t, size_t>> chunk_table;
+
+struct client_result {
+    bool ok = false;
+    double describe_ms = 0;
+    double setup_ms = 0;
+    double play_ms = 0;
+    double first_frame_ms = 0;
+};
+
+std::atomic<int> nready(0);
+std::atomic<bool> start_clients(false);
+
+static double ms_between(time_point start, time_point end)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+}
+
+/* Every session gets a FramedSourceCustom of its own. The NAL units of the file are found once in main(),
+ * and every source reads the same tables. The parameter sets are given to the RTP sink, so that DESCRIBE
+ * does not have to play the stream to find them for the SDP */
+class BenchmarkSubsession : public OnDemandServerMediaSubsession
+{
+public:
+    BenchmarkSubsession(UsageEnvironment& env, const nal_table& nals, const chunk_table& chunks,
+        const std::pair<size_t, uint8_t *> *vps, const std::pair<size_t, uint8_t *> *sps,
+        const std::pair<size_t, uint8_t *> *pps)
+        :OnDemandServerMediaSubsession(env, False),
+        nals_(nals), chunks_(chunks), vps_(vps), sps_(sps), pps_(pps)
+    {
+    }
+
+protected:
+    virtual FramedSource *createNewStreamSource(unsigned clientSessionId, unsigned& estBitrate)
+    {
+        (void)clientSessionId;
+        estBitrate = ESTIMATED_BITRATE_KBPS;
+
+        FramedSourceCustom *source = new FramedSourceCustom(&envir(), true);
+        source->startFramedSource(nals_, chunks_, nullptr);
+
+        return H265VideoStreamDiscreteFramer::createNew(envir(), source);
+    }
+
+    virtual RTPSink *createNewRTPSink(Groupsock *rtpGroupsock, unsigned char rtpPayloadTypeIfDynamic,
+        FramedSource *inputSource)
+    {
+        (void)inputSource;
+
+        return H265VideoRTPSink::createNew(envir(), rtpGroupsock, rtpPayloadTypeIfDynamic,
+            vps_->second, vps_->first, sps_->second, sps_->first, pps_->second, pps_->first);
+    }
+
+private:
+    const nal_table& nals_;
+    const chunk_table& chunks_;
+    const std::pair<size_t, uint8_t *> *vps_, *sps_, *pps_;
+};
+
+/* Reads NAL units until one ends a frame. The discrete framer of the server marks
+ * the last packet of every VCL NAL unit, so this is the first picture or slice */
+class FirstFrameSink : public MediaSink
+{
+public:
+    FirstFrameSink(UsageEnvironment& env, RTPSource *rtpSource, TaskFunc *onFirstFrame, void *clientData)
+        :MediaSink(env), rtpSource_(rtpSource), onFirstFrame_(onFirstFrame), clientData_(clientData),
+        buffer_(SINK_BUFFER_SIZE)
+    {
+    }
+
+private:
+    static void afterGettingFrame(void *clientData, unsigned frameSize, unsigned numTruncatedBytes,
+        struct timeval presentationTime, unsigned durationInMicroseconds)
+    {
+        (void)frameSize, (void)numTruncatedBytes, (void)presentationTime, (void)durationInMicroseconds;
+
+        FirstFrameSink *sink = (FirstFrameSink *)clientData;
+
+        if (sink->rtpSource_->curPacketMarkerBit()) {
+            sink->onFirstFrame_(sink->clientData_);
+            return;
+        }
+
+        sink->continuePlaying();
+    }
+
+    virtual Boolean continuePlaying()
+    {
+        if (!fSource)
+            return False;
+
+        fSource->getNextFrame(buffer_.data(), buffer_.size(), afterGettingFrame, this, onSourceClosure, this);
+        return True;
+    }
+
+    RTPSource *rtpSource_;
+    TaskFunc *onFirstFrame_;
+    void *clientData_;
+    std::vector<uint8_t> buffer_;
+};
+
+/* One client session, driven by the response handlers of RTSPClient.
+ * The watch variable is set once the session has been torn down or has failed */
+class BenchmarkClient : public RTSPClient
+{
+public:
+    static BenchmarkClient *createNew(UsageEnvironment& env, std::string url, client_result *result, char *stop)
+    {
+        return new BenchmarkClient(env, url, result, stop);
+    }
+
+    void start()
+    {
+        start_ = std::chrono::high_resolution_clock::now();
+        timeoutTask_ = envir().taskScheduler().scheduleDelayedTask(CLIENT_TIMEOUT_US, timeout, this);
+
+        sendDescribeCommand(continueAfterDESCRIBE);
+    }
+
+    // Close the sink and the session, the client itself is closed by the caller
+    void uninit()
+    {
+        envir().taskScheduler().unscheduleDelayedTask(timeoutTask_);
+
+        if (sink_) {
+            sink_->stopPlaying();
+            Medium::close(sink_);
+            sink_ = nullptr;
+        }
+
+        if (session_) {
+            Medium::close(session_);
+            session_ = nullptr;
+        }
+    }
+
+protected:
+    BenchmarkClient(UsageEnvironment& env, std::string url, client_result *result, char *stop)
+        :RTSPClient(env, url.c_str(), 0, "rtp-benchmarks", 0, -1),
+        result_(result), stop_(stop), session_(nullptr), subsession_(nullptr), sink_(nullptr),
+        timeoutTask_(nullptr)
+    {
+    }
+
+private:
+    void fail(const char *step, int resultCode, char *resultString)
+    {
+        std::cerr << step << " failed with " << resultCode << ": "
+            << (resultString ? resultString : envir().getResultMsg()) << std::endl;
+        *stop_ = 1;
+    }
+
+    static void continueAfterDESCRIBE(RTSPClient *rtspClient, int resultCode, char *resultString)
+    {
+        BenchmarkClient *client = (BenchmarkClient *)rtspClient;
+        client->describe_ = std::chrono::high_resolution_clock::now();
+
+        if (resultCode != 0) {
+            client->fail("DESCRIBE", resultCode, resultString);
+        } else {
+            client->setup(resultString);
+        }
+
+        delete[] resultString;
+    }
+
+    void setup(char *sdp)
+    {
+        session_ = MediaSession::createNew(envir(), sdp);
+
+        if (session_) {
+            MediaSubsessionIterator iter(*session_);
+            subsession_ = iter.next();
+        }
+
+        if (!subsession_ || !subsession_->initiate()) {
+            fail("Creating the session", -1, nullptr);
+            return;
+        }
+
+        sendSetupCommand(*subsession_, continueAfterSETUP);
+    }
+
+    static void continueAfterSETUP(RTSPClient *rtspClient, int resultCode, char *resultString)
+    {
+        BenchmarkClient *client = (BenchmarkClient *)rtspClient;
+        client->setup_ = std::chrono::high_resolution_clock::now();
+
+        if (resultCode != 0) {
+            client->fail("SETUP", resultCode, resultString);
+        } else {
+            /* the sink is started before PLAY so that no packet sent right after the response is missed */
+            client->sink_ = new FirstFrameSink(client->envir(), client->subsession_->rtpSource(),
+                firstFrame, client);
+            client->sink_->startPlaying(*client->subsession_->readSource(), nullptr, nullptr);
+
+            client->sendPlayCommand(*client->session_, continueAfterPLAY);
+        }
+
+        delete[] resultString;
+    }
+
+    static void continueAfterPLAY(RTSPClient *rtspClient, int resultCode, char *resultString)
+    {
+        BenchmarkClient *client = (BenchmarkClient *)rtspClient;
+        client->play_ = std::chrono::high_resolution_clock::now();
+
+        if (resultCode != 0)
+            client->fail("PLAY", resultCode, resultString);
+
+        delete[] resultString;
+    }
+
+    static void firstFrame(void *clientData)
+    {
+        BenchmarkClient *client = (BenchmarkClient *)clientData;
+        auto now = std::chrono::high_resolution_clock::now();
+
+        client->result_->describe_ms    = ms_between(client->start_, client->describe_);
+        client->result_->setup_ms       = ms_between(client->describe_, client->setup_);
+        client->result_->play_ms        = ms_between(client->setup_, client->play_);
+        client->result_->first_frame_ms = ms_between(client->start_, now);
+        client->result_->ok             = true;
+
+        /* the first frame may arrive before the PLAY response, then PLAY lasts until the frame */
+        if (client->play_ < client->setup_)
+            client->result_->play_ms = ms_between(client->setup_, now);
+
+        client->sendTeardownCommand(*client->session_, continueAfterTEARDOWN);
+    }
+
+    static void continueAfterTEARDOWN(RTSPClient *rtspClient, int resultCode, char *resultString)
+    {
+        BenchmarkClient *client = (BenchmarkClient *)rtspClient;
+        (void)resultCode;
+
+        /* the deadline stays armed until here, so a lost TEARDOWN response cannot hang the round */
+        client->envir().taskScheduler().unscheduleDelayedTask(client->timeoutTask_);
+
+        *client->stop_ = 1;
+        delete[] resultString;
+    }
+
+    static void timeout(void *clientData)
+    {
+        BenchmarkClient *client = (BenchmarkClient *)clientData;
+
+        client->timeoutTask_ = nullptr;
+
+        /* after the first frame only the TEARDOWN response is missing, the measurements are still valid */
+        if (client->result_->ok)
+            std::cerr << "No TEARDOWN response within " << CLIENT_TIMEOUT_US / 1000 / 1000 << " s of DESCRIBE" << std::endl;
+        else
+            std::cerr << "No frame received in " << CLIENT_TIMEOUT_US / 1000 / 1000 << " s" << std::endl;
+
+        *client->stop_ = 1;
+    }
+
+    client_result *result_;
+    char *stop_;
+
+    MediaSession *session_;
+    MediaSubsession *subsession_;
+    FirstFrameSink *sink_;
+    TaskToken timeoutTask_;
+
+    time_point start_, describe_, setup_, play_;
+};
+
+/* Each client runs in its own thread with its own scheduler and environment. All clients of a round
+ * are created before any of them sends DESCRIBE, so that they hit the server at the same time */
+static void client_thread(std::string url, client_result *result)
+{
+    TaskScheduler *scheduler = BasicTaskScheduler::createNew();
+    UsageEnvironment *env    = BasicUsageEnvironment::createNew(*scheduler);
+    char stop = 0;
+
+    BenchmarkClient *client = BenchmarkClient::createNew(*env, url, result, &stop);
+
+    nready++;
+    while (!start_clients)
+        std::this_thread::yield();
+
+    client->start();
+    env->taskScheduler().doEventLoop(&stop);
+
+    client->uninit();
+    Medium::close(client);
+
+    env->reclaim();
+    delete scheduler;
+}
+
+// Runs in the server's event loop, so the watch variable is only touched by that thread
+static void stop_server(void *clientData)
+{
+    *(char *)clientData = 1;
+}
+
+/* Find the NAL units of every chunk, the same way FramedSourceCustom does for its own memory layout */
+static void get_chunk_table(uint8_t *mem, std::vector<uint64_t>& chunk_sizes, nal_table& nals, chunk_table& chunks)
+{
+    uint64_t offset = 0;
+
+    for (auto chunk_size : chunk_sizes) {
+        size_t first = nals.size();
+        scan_nal_units(mem + offset, chunk_size, nals);
+
+        /* an empty chunk would have nothing to send */
+        if (nals.size() > first)
+            chunks.push_back(std::make_pair(first, nals.size() - first));
+
+        offset += chunk_size;
+    }
+}
+
+static const std::pair<size_t, uint8_t *> *find_nal(const nal_table& nals, uint8_t type)
+{
+    for (auto& nal : nals) {
+        if (nal.first > 0 && ((nal.second[0] >> 1) & 0x3f) == type)
+            return &nal;
+    }
+
+    return nullptr;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 6 && argc != 7) {
+        fprintf(stderr, "usage: ./%s <input file> <result file> <server address> <server port> \
+            <max clients> [rounds]\n", __FILE__);
+        return EXIT_FAILURE;
+    }
+
+    std::string input_file  = argv[1];
+    std::string result_file = argv[2];
+
+    std::string server_address = argv[3];
+    int server_port = atoi(argv[4]);
+
+    int max_clients = atoi(argv[5]);
+    int rounds      = argc == 7 ? atoi(argv[6]) : 1;
+
+    if (max_clients <= 0 || rounds <= 0) {
+        std::cerr << "Invalid number of clients or rounds: " << max_clients << " " << rounds << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t len = 0;
+    void *mem  = get_mem(input_file, len);
+
+    if (mem == nullptr) {
+        std::cerr << "Failed to read the input file " << input_file << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint64_t> chunk_sizes;
+    get_chunk_sizes(get_chunk_filename(input_file), chunk_sizes);
+
+    nal_table nals;
+    chunk_table chunks;
+    get_chunk_table((uint8_t *)mem, chunk_sizes, nals, chunks);
+
+    const std::pair<size_t, uint8_t *> *vps = find_nal(nals, 32);
+    const std::pair<size_t, uint8_t *> *sps = find_nal(nals, 33);
+    const std::pair<size_t, uint8_t *> *pps = find_nal(nals, 34);
+
+    if (chunks.empty() || !vps || !sps || !pps) {
+        std::cerr << "No HEVC stream with VPS, SPS and PPS in " << input_file << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // shared by all sessions, set before any of them is created
+    OutPacketBuffer::maxSize = SERVER_BUFFER_SIZE;
+
+    TaskScheduler *scheduler = BasicTaskScheduler::createNew();
+    UsageEnvironment *env    = BasicUsageEnvironment::createNew(*scheduler);
+    char stop = 0;
+
+    RTSPServer *server = RTSPServer::createNew(*env, server_port);
+
+    if (server == nullptr) {
+        std::cerr << "Failed to create the RTSP server: " << env->getResultMsg() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    ServerMediaSession *sms = ServerMediaSession::createNew(*env, STREAM_NAME, STREAM_NAME, input_file.c_str());
+    sms->addSubsession(new BenchmarkSubsession(*env, nals, chunks, vps, sps, pps));
+    server->addServerMediaSession(sms);
+
+    EventTriggerId stopEvent = scheduler->createEventTrigger(stop_server);
+    std::thread server_thread([env, &stop]() { env->taskScheduler().doEventLoop(&stop); });
+
+    std::string url = "rtsp://" + server_address + ":" + std::to_string(server_port) + "/" STREAM_NAME;
+
+    std::cout << "Starting Live555 RTSP startup tests with 1-" << max_clients << " clients, "
+        << rounds << " rounds. " << url << std::endl;
+
+    std::ofstream results(result_file, std::ios::out | std::ios::app | std::ios::ate);
+    int failed = 0;
+
+    for (int nclients = 1; nclients <= max_clients; ++nclients) {
+        for (int round = 0; round < rounds; ++round) {
+            std::vector<client_result> client_results(nclients);
+            std::vector<std::thread> threads;
+
+            nready = 0;
+            start_clients = false;
+
+            for (int i = 0; i < nclients; ++i) {
+                threads.emplace_back(client_thread, url, &client_results[i]);
+            }
+
+            while (nready.load() != nclients)
+                std::this_thread::yield();
+
+            start_clients = true;
+
+            for (auto& thread : threads) {
+                thread.join();
+            }
+
+            client_result sum, max;
+            int ok = 0;
+
+            // <clients>;<client>;<describe ms>;<setup ms>;<play ms>;<first frame ms>
+            for (int i = 0; i < nclients; ++i) {
+                client_result& r = client_results[i];
+
+                if (!r.ok) {
+                    ++failed;
+                    continue;
+                }
+
+                results << nclients << ";" << i << ";" << r.describe_ms << ";" << r.setup_ms << ";"
+                    << r.play_ms << ";" << r.first_frame_ms << std::endl;
+
+                sum.describe_ms    += r.describe_ms;
+                sum.setup_ms       += r.setup_ms;
+                sum.play_ms        += r.play_ms;
+                sum.first_frame_ms += r.first_frame_ms;
+                max.first_frame_ms  = std::max(max.first_frame_ms, r.first_frame_ms);
+                ++ok;
+            }
+
+            if (ok) {
+                std::cout << nclients << " clients: DESCRIBE " << sum.describe_ms / ok << " ms, SETUP "
+                    << sum.setup_ms / ok << " ms, PLAY " << sum.play_ms / ok << " ms, first frame "
+                    << sum.first_frame_ms / ok << " ms (max " << max.first_frame_ms << " ms)";
+            } else {
+                std::cout << nclients << " clients: no session started";
+            }
+
+            std::cout << ", " << nclients - ok << " failed" << std::endl;
+        }
+    }
+
+    results.close();
+
+    scheduler->triggerEvent(stopEvent, &stop);
+    server_thread.join();
+
+    scheduler->deleteEventTrigger(stopEvent);
+    Medium::close(server);
+
+    env->reclaim();
+    delete scheduler;
+
+    // a client that did not get its first frame fails the run, like a timed out receiver
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
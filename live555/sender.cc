@@ -2,16 +2,53 @@
 #include <BasicUsageEnvironment.hh>
 #include <GroupsockHelper.hh>
 #include "source.hh"
+#include "../util/util.hh"
 #include "H265VideoStreamDiscreteFramer.hh"
 
 #include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <thread>
+#include <vector>
+
+/* Each stream runs in its own thread with its own scheduler, environment, source and RTP sink.
+ * Stream n sends to remote port + 2 * n, the same way as the uvgRTP sender */
+static void sender_thread(int thread_num, std::string input_file, std::string result_file,
+    std::string remote_address, int remote_port, int fps, std::vector<uint64_t> schedule,
+    const std::vector<uint64_t>& chunk_sizes)
+{
+    TaskScheduler *scheduler = BasicTaskScheduler::createNew();
+    UsageEnvironment *env = BasicUsageEnvironment::createNew(*scheduler);
+    char stop = 0;
+
+    H265FramedSource* framedSource = H265FramedSource::createNew(*env, fps, input_file, result_file, schedule, &stop,
+        chunk_sizes);
+    H265VideoStreamDiscreteFramer* framer = H265VideoStreamDiscreteFramer::createNew(*env, framedSource);
+
+    Port rtpPort(remote_port + thread_num * 2);
+    struct in_addr dst_addr;
+    dst_addr.s_addr = our_inet_addr(remote_address.c_str());
+
+    Groupsock* rtpGroupsock = new Groupsock(*env, dst_addr, rtpPort, 255);
+
+    RTPSink* videoSink = H265VideoRTPSink::createNew(*env, rtpGroupsock, 96);
+    videoSink->startPlaying(*framer, NULL, videoSink);
+    env->taskScheduler().doEventLoop(&stop);
+
+    videoSink->stopPlaying();
+    Medium::close(videoSink);
+    Medium::close(framer); // closes the source too
+    delete rtpGroupsock;
+
+    env->reclaim();
+    delete scheduler;
+}
 
 int main(int argc, char **argv)
 {
     if (argc != 11) {
         fprintf(stderr, "usage: ./%s <input file> <result file> <local address> <local port> <remote address> <remote port> \
-            <number of threads> <fps> <format> <srtp> \n", __FILE__);
+            <number of threads> <fps>[@<trace file|index>[@<speed>]] <format> <srtp> \n", __FILE__);
         return EXIT_FAILURE;
     }
 
@@ -34,22 +71,36 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
     
-    TaskScheduler *scheduler = BasicTaskScheduler::createNew();
-    UsageEnvironment *env = BasicUsageEnvironment::createNew(*scheduler);
-    H265FramedSource* framedSource = H265FramedSource::createNew(*env, fps, input_file, result_file);
-    H265VideoStreamDiscreteFramer* framer = H265VideoStreamDiscreteFramer::createNew(*env, framedSource);
+    // the chunk index tells which frame, and so which send time, each NAL unit belongs to
+    std::vector<uint64_t> chunk_sizes;
+    get_chunk_sizes(get_chunk_filename(input_file), chunk_sizes);
 
-    Port rtpPort(remote_port);
-    struct in_addr dst_addr;
-    dst_addr.s_addr = our_inet_addr(remote_address.c_str());
+    std::vector<uint64_t> schedule;
+    if (!get_send_schedule(argv[8], input_file, chunk_sizes.size(), schedule)) {
+        return EXIT_FAILURE;
+    }
 
-    Groupsock rtpGroupsock(*env, dst_addr, rtpPort, 255);
+    if (nthreads <= 0) {
+        std::cerr << "Invalid number of threads: " << nthreads << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Starting Live555 sender tests with " << nthreads << " streams. " << local_address << ":" << local_port
+        << "->" << remote_address << ":" << remote_port << std::endl;
 
+    // shared by all streams, set before any of them starts
     OutPacketBuffer::maxSize = 40 * 1000 * 1000;
 
-    RTPSink* videoSink = H265VideoRTPSink::createNew(*env, &rtpGroupsock, 96);
-    videoSink->startPlaying(*framer, NULL, videoSink);
-    env->taskScheduler().doEventLoop();
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < nthreads; ++i) {
+        threads.emplace_back(sender_thread, i, input_file, result_file, remote_address, remote_port, fps, schedule,
+            std::cref(chunk_sizes));
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
 
     return EXIT_SUCCESS;
 }
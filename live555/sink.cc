@@ -1,43 +1,29 @@
 #include <RTPInterface.hh>
 #include "sink.hh"
+#include "../util/util.hh"
 
 #include <chrono>
-#include <climits>
-#include <thread>
+#include <cstdlib>
 
 #define BUFFER_SIZE 1600000
 
-size_t frames = 0;
-size_t bytes  = 0;
-std::chrono::high_resolution_clock::time_point start;
-std::chrono::high_resolution_clock::time_point last;
+// Same as uvgRTP, a stream that has not received anything for this long is stopped
+#define INACTIVITY_TIMEOUT_US 2000000
 
-static void thread_func(void)
+RTPSink_::RTPSink_(UsageEnvironment& env):
+    RTPSink_(env, "", nullptr)
 {
-    unsigned prev_frames = UINT_MAX;
-
-    // looks like the only purpose of this function is to print the results to the log
-
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(2000));
-
-        if (prev_frames == frames)
-            break;
-
-        prev_frames = frames;
-    }
-
-    fprintf(stderr, "%zu %zu %lu\n", bytes, frames,
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::high_resolution_clock::now() - start
-        ).count()
-    );
-
-    exit(EXIT_FAILURE);
 }
 
-RTPSink_::RTPSink_(UsageEnvironment& env):
-    MediaSink(env)
+RTPSink_::RTPSink_(UsageEnvironment& env, std::string result_file, char *stop):
+    MediaSink(env),
+    resultFile_(result_file),
+    stop_(stop),
+    timedOut_(false),
+    frames_(0),
+    prevFrames_(0),
+    bytes_(0),
+    activityTask_(nullptr)
 {
     fReceiveBuffer = new uint8_t[BUFFER_SIZE];
 }
@@ -52,6 +38,41 @@ void RTPSink_::uninit()
     delete fReceiveBuffer;
 }
 
+void RTPSink_::finish()
+{
+    uint64_t diff = std::chrono::duration_cast<std::chrono::milliseconds>(last_ - start_).count();
+
+    envir().taskScheduler().unscheduleDelayedTask(activityTask_);
+
+    if (resultFile_.empty())
+        fprintf(stderr, "%zu %zu %lu\n", bytes_, frames_, diff);
+    else
+        write_receive_results_to_file(resultFile_, bytes_, frames_, diff);
+
+    if (!stop_)
+        exit(timedOut_ ? EXIT_FAILURE : EXIT_SUCCESS);
+    *stop_ = 1;
+}
+
+void RTPSink_::checkActivity(void *clientData)
+{
+    ((RTPSink_ *)clientData)->checkActivity();
+}
+
+void RTPSink_::checkActivity()
+{
+    activityTask_ = nullptr;
+
+    if (prevFrames_ == frames_) {
+        timedOut_ = true;
+        finish();
+        return;
+    }
+
+    prevFrames_ = frames_;
+    activityTask_ = envir().taskScheduler().scheduleDelayedTask(INACTIVITY_TIMEOUT_US, checkActivity, this);
+}
+
 void RTPSink_::afterGettingFrame(
     void *clientData,
     unsigned frameSize,
@@ -75,21 +96,23 @@ void RTPSink_::afterGettingFrame(
     unsigned durationInMicroseconds
 )
 {
-    (void)frameSize,        (void)numTruncatedBytes;
+    (void)numTruncatedBytes;
     (void)presentationTime, (void)durationInMicroseconds;
 
-    /* start loop that monitors activity and if there has been
-     * no activity for 2s (same as uvgRTP) the receiver is stopped) */
-    if (!frames)
-        (void)new std::thread(thread_func);
-
-    if (++frames == 601) {
-        fprintf(stderr, "%zu %zu %lu\n", bytes, frames,
-            std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::high_resolution_clock::now() - start
-            ).count()
-        );
-        exit(EXIT_SUCCESS);
+    last_ = std::chrono::high_resolution_clock::now();
+
+    /* start the task that monitors activity in this stream's own event loop. If there has been
+     * no activity for 2s (same as uvgRTP) the stream is stopped */
+    if (!frames_) {
+        start_ = last_;
+        activityTask_ = envir().taskScheduler().scheduleDelayedTask(INACTIVITY_TIMEOUT_US, checkActivity, this);
+    }
+
+    bytes_ += frameSize;
+
+    if (++frames_ == 601) {
+        finish();
+        return;
     }
 
     continuePlaying();
@@ -1,11 +1,18 @@
 #include <H265VideoRTPSink.hh>
 
+#include <chrono>
+#include <string>
+
 class RTPSink_ : public MediaSink
 {
     public:
         RTPSink_(UsageEnvironment& env);
+        RTPSink_(UsageEnvironment& env, std::string result_file, char *stop);
         virtual ~RTPSink_();
 
+        // True if the stream was stopped because frames stopped arriving
+        bool timedOut() const { return timedOut_; }
+
         void uninit();
 
         static void afterGettingFrame(
@@ -28,5 +35,20 @@ class RTPSink_ : public MediaSink
 
     private:
         virtual Boolean continuePlaying();
+        static void checkActivity(void *clientData);
+        void checkActivity();
+        void finish();
+
         uint8_t *fReceiveBuffer;
+
+        /* Per stream state, so that each stream can run in its own event loop and thread.
+         * Without a watch variable the process exits when the stream ends */
+        std::string resultFile_;
+        char *stop_;
+        bool timedOut_;
+        size_t frames_;
+        size_t prevFrames_;
+        size_t bytes_;
+        std::chrono::high_resolution_clock::time_point start_, last_;
+        TaskToken activityTask_;
 };
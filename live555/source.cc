@@ -4,8 +4,7 @@
 #include <FramedSource.hh>
 #include "source.hh"
 #include <chrono>
-#include <mutex>
-#include <queue>
+#include <cstring>
 #include <thread>
 #include <string>
 
@@ -13,123 +12,59 @@ EventTriggerId H265FramedSource::eventTriggerId = 0;
 unsigned H265FramedSource::referenceCount       = 0;
 
 
-uint8_t *buf;
-size_t offset    = 0;
-size_t bytes     = 0;
-uint64_t current = 0;
-uint64_t period  = 0;
-bool initialized = false;
-
-std::mutex delivery_mtx;
-std::queue<std::pair<size_t, uint8_t *>> nals;
-std::chrono::high_resolution_clock::time_point s_tmr, e_tmr;
-
-static const uint8_t *ff_avc_find_startcode_internal(const uint8_t *p, const uint8_t *end)
-{
-    const uint8_t *a = p + 4 - ((intptr_t)p & 3);
-
-    for (end -= 3; p < a && p < end; p++) {
-        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
-            return p;
-    }
-
-    for (end -= 3; p < end; p += 4) {
-        uint32_t x = *(const uint32_t*)p;
-//      if ((x - 0x01000100) & (~x) & 0x80008000) // little endian
-//      if ((x - 0x00010001) & (~x) & 0x00800080) // big endian
-        if ((x - 0x01010101) & (~x) & 0x80808080) { // generic
-            if (p[1] == 0) {
-                if (p[0] == 0 && p[2] == 1)
-                    return p;
-                if (p[2] == 0 && p[3] == 1)
-                    return p+1;
-            }
-            if (p[3] == 0) {
-                if (p[2] == 0 && p[4] == 1)
-                    return p+2;
-                if (p[4] == 0 && p[5] == 1)
-                    return p+3;
-            }
-        }
-    }
-
-    for (end += 3; p < end; p++) {
-        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
-            return p;
-    }
-
-    return end + 3;
-}
-
-const uint8_t *ff_avc_find_startcode(const uint8_t *p, const uint8_t *end)
-{
-    const uint8_t *out= ff_avc_find_startcode_internal(p, end);
-    if (p < out && out < end && !out[-1]) out--;
-    return out;
-}
-
-static std::pair<size_t, uint8_t *> find_next_nal(const std::string& input_file)
-{
-    static size_t len         = 0;
-    static uint8_t *p         = NULL;
-    static uint8_t *end       = NULL;
-    static uint8_t *nal_start = NULL;
-    static uint8_t *nal_end   = NULL;
-
-    if (!p) {
-        p   = (uint8_t *)get_mem(input_file, len);
-        end = p + len;
-        len = 0;
-
-        nal_start = (uint8_t *)ff_avc_find_startcode(p, end);
-    }
-
-    while (nal_start < end && !*(nal_start++))
-        ;
-
-    if (nal_start == end)
-        return std::make_pair(0, nullptr);
-
-    nal_end    = (uint8_t *)ff_avc_find_startcode(nal_start, end);
-    auto ret   = std::make_pair((size_t)(nal_end - nal_start), (uint8_t *)nal_start);
-    len       += nal_end - nal_start;
-    nal_start  = nal_end;
-
-    return ret;
-}
-
 H265FramedSource *H265FramedSource::createNew(UsageEnvironment& env, unsigned fps, 
-    std::string input_file, std::string result_file)
+    std::string input_file, std::string result_file, std::vector<uint64_t> schedule, char *stop,
+    const std::vector<uint64_t>& chunk_sizes)
 {
-    return new H265FramedSource(env, fps, input_file, result_file);
+    return new H265FramedSource(env, fps, input_file, result_file, schedule, stop, chunk_sizes);
 }
 
 H265FramedSource::H265FramedSource(UsageEnvironment& env, unsigned fps, 
-    std::string input_file, std::string result_file):
+    std::string input_file, std::string result_file, std::vector<uint64_t> schedule, char *stop,
+    const std::vector<uint64_t>& chunk_sizes):
     FramedSource(env),
     fps_(fps),
     input_file_(input_file),
-    result_file_(result_file)
+    result_file_(result_file),
+    schedule_(schedule),
+    stop_(stop)
 {
-    period = (uint64_t)((1000 / (float)fps) * 1000);
-
-    if (!eventTriggerId)
-        eventTriggerId = envir().taskScheduler().createEventTrigger(deliverFrame0);
+    period_ = (uint64_t)((1000 / (float)fps) * 1000);
+
+    /* Every stream has its own mapping and NAL table, the file is shared through the page cache.
+     * The NAL units are found before sending starts, so deliverFrame() only copies them.
+     * deliverFrame() is called directly from doGetNextFrame(), so no event trigger is needed
+     * and the sources of different streams do not share any state */
+    size_t len = 0;
+    uint8_t *mem = (uint8_t *)get_mem(input_file_, len);
+
+    if (mem)
+        get_nal_table(mem, len, input_file_, nals_);
+
+    /* The chunks of the index are the frames (access units) of the schedule and lie back to back in the file,
+     * so the frame of each NAL unit follows from its offset */
+    if (mem && !chunk_sizes.empty()) {
+        uint64_t chunk = 0;
+        uint64_t chunk_end = chunk_sizes[0];
+
+        nal_frames_.reserve(nals_.size());
+        for (auto& nal : nals_) {
+            while (chunk + 1 < chunk_sizes.size() && (uint64_t)(nal.second - mem) >= chunk_end)
+                chunk_end += chunk_sizes[++chunk];
+            nal_frames_.push_back(chunk);
+        }
+    }
 }
 
 H265FramedSource::~H265FramedSource()
 {
-    if (!--referenceCount) {
-        envir().taskScheduler().deleteEventTrigger(eventTriggerId);
-        eventTriggerId = 0;
-    }
 }
 
 void H265FramedSource::doGetNextFrame()
 {
-    if (!initialized) {
-        s_tmr       = std::chrono::high_resolution_clock::now();
-        initialized = true;
+    if (!initialized_) {
+        s_tmr_       = std::chrono::high_resolution_clock::now();
+        initialized_ = true;
     }
 
     deliverFrame();
@@ -145,31 +80,39 @@ void H265FramedSource::deliverFrame()
     if (!isCurrentlyAwaitingData())
         return;
 
-    delivery_mtx.lock();
+    if (nal_ptr_ == nals_.size()) {
+        uint64_t diff = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(e_tmr_ - s_tmr_).count();
+        write_send_results_to_file(result_file_, bytes_, diff);
 
-    auto nal = find_next_nal(input_file_);
-
-    if (!nal.first || !nal.second) {
-        uint64_t diff = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(e_tmr - s_tmr).count();
-        write_send_results_to_file(result_file_, bytes, diff);
-        exit(EXIT_SUCCESS);
+        /* with several streams only this stream's event loop is stopped */
+        if (!stop_)
+            exit(EXIT_SUCCESS);
+        *stop_ = 1;
+        return;
     }
 
+    /* the send time of a NAL unit is the one of its frame */
+    if (!nal_frames_.empty())
+        current_ = nal_frames_[nal_ptr_];
+
     uint64_t runtime = std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::high_resolution_clock::now() - s_tmr
+        std::chrono::high_resolution_clock::now() - s_tmr_
     ).count();
 
-    if (runtime < current * period)
-        std::this_thread::sleep_for(std::chrono::microseconds(current * period - runtime));
+    uint64_t due = (current_ < schedule_.size()) ? schedule_[current_] : current_ * period_;
+    if (runtime < due)
+        std::this_thread::sleep_for(std::chrono::microseconds(due - runtime));
+
+    auto& nal = nals_[nal_ptr_++];
 
-    /* try to hold fps for intra/inter frames only */
-    if (nal.first > 1500)
-        ++current;
+    /* without a chunk index, try to hold fps for intra/inter frames only */
+    if (nal_frames_.empty() && nal.first > 1500)
+        ++current_;
 
     uint8_t *newFrameDataStart = nal.second;
     unsigned newFrameSize      = nal.first;
 
-    bytes += newFrameSize;
+    bytes_ += newFrameSize;
 
     if (newFrameSize > fMaxSize) {
         fFrameSize = fMaxSize;
@@ -181,7 +124,6 @@ void H265FramedSource::deliverFrame()
     fDurationInMicroseconds = 0;
     memmove(fTo, newFrameDataStart, fFrameSize);
 
-    delivery_mtx.unlock();
     FramedSource::afterGetting(this);
-    e_tmr = std::chrono::high_resolution_clock::now();
+    e_tmr_ = std::chrono::high_resolution_clock::now();
 }
@@ -2,12 +2,15 @@
 
 #include <FramedSource.hh>
 
+#include <chrono>
 #include <string>
+#include <vector>
 
 class H265FramedSource: public FramedSource {
 public:
   static H265FramedSource *createNew(UsageEnvironment& env, unsigned fps, 
-      std::string input_file, std::string result_file);
+      std::string input_file, std::string result_file, std::vector<uint64_t> schedule = {}, char *stop = nullptr,
+      const std::vector<uint64_t>& chunk_sizes = {});
 
 public:
   static EventTriggerId eventTriggerId;
@@ -17,7 +20,8 @@ public:
   void deliver_frame();
 
 protected:
-  H265FramedSource(UsageEnvironment& env, unsigned fps, std::string input_file, std::string result_file);
+  H265FramedSource(UsageEnvironment& env, unsigned fps, std::string input_file, std::string result_file,
+      std::vector<uint64_t> schedule, char *stop, const std::vector<uint64_t>& chunk_sizes);
   // called only by createNew(), or by subclass constructors
   virtual ~H265FramedSource();
 
@@ -36,4 +40,20 @@ private:
 
   std::string input_file_;
   std::string result_file_;
+
+  // Send time of each frame from get_send_schedule(), frames past its end are sent at fps_
+  std::vector<uint64_t> schedule_;
+
+  // Watch variable of this stream's event loop, set once the file has been sent. Without it the process exits
+  char *stop_;
+
+  // Per stream state, so that each stream can run in its own event loop and thread
+  std::vector<std::pair<size_t, uint8_t *>> nals_;
+  std::vector<uint64_t> nal_frames_; // Frame (chunk) of each NAL unit, the index of its send time in schedule_
+  size_t nal_ptr_     = 0;
+  uint64_t period_    = 0;
+  uint64_t current_   = 0;
+  size_t bytes_       = 0;
+  bool initialized_   = false;
+  std::chrono::high_resolution_clock::time_point s_tmr_, e_tmr_;
 };
\ No newline at end of file
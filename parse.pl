@@ -5,9 +5,10 @@ use strict;
 use Getopt::Long;
 use Cwd qw(realpath);
 
-my $TOTAL_FRAMES_UVGRTP  = 602;
-my $TOTAL_FRAMES_LIVE555 = 601;
-my $TOTAL_FRAMES_FFMPEG  = 598;
+my $TOTAL_FRAMES_UVGRTP    = 602;
+my $TOTAL_FRAMES_LIVE555   = 601;
+my $TOTAL_FRAMES_FFMPEG    = 598;
+my $TOTAL_FRAMES_GSTREAMER = 602; # one appsink buffer per access unit
 
 # open the file, validate it and return file handle to caller
 sub open_file {
@@ -34,8 +35,9 @@ sub convert_bytes_to_unit {
 }
 
 sub get_frame_count {
-    return ($_[0] eq "uvgrtp") ? $TOTAL_FRAMES_UVGRTP :
-           ($_[0] eq "ffmpeg") ? $TOTAL_FRAMES_FFMPEG : $TOTAL_FRAMES_LIVE555;
+    return ($_[0] eq "uvgrtp")    ? $TOTAL_FRAMES_UVGRTP :
+           ($_[0] eq "ffmpeg")    ? $TOTAL_FRAMES_FFMPEG :
+           ($_[0] eq "gstreamer") ? $TOTAL_FRAMES_GSTREAMER : $TOTAL_FRAMES_LIVE555;
 }
 
 sub parse_send {
@@ -115,7 +117,7 @@ sub parse_recv {
         my ($a_f, $a_b, $a_t) = (0) x 3;
 
         # make sure this is a line produced by the benchmarking script before proceeding
-        if ($lib eq "ffmpeg") {
+        if ($lib eq "ffmpeg" or $lib eq "gstreamer") {
             my @nums = $line =~ /(\d+)/g;
             next if $#nums != 2 or grep /jitter/, $line;
         }
@@ -411,9 +413,48 @@ sub parse_latency {
     print "Completed: $frames%, intra $intra ms, inter $inter ms, avg $avg ms\n";
 }
 
+# Average the rows of latency_results_nals or a sender _cpu file per mode and number of NAL units per frame
+sub parse_nals {
+    my ($path) = @_;
+    my (%sums, %counts, %latency);
+
+    open my $fh, '<', $path or die "failed to open file $path\n";
+
+    while (my $line = <$fh>) {
+        chomp $line;
+        my @fields = split ";", $line;
+        next if @fields < 5;
+
+        # latency_results_nals: <mode>;<NALs>;<VCL NALs>;<sent>;<complete>;<avg ms>;<max ms>
+        # _cpu:                 <mode>;<frames>;<NALs>;<CPU us per frame>;<total CPU ms>
+        my $latency = @fields == 7;
+        my $key = sprintf("%s;%.2f", $fields[0], $latency ? $fields[1] : $fields[2]);
+        my @values = $latency ? (100 * $fields[4] / ($fields[3] or 1), $fields[5], $fields[6]) : ($fields[3], $fields[4]);
+
+        $sums{$key} = [ (0) x @values ] if !exists $sums{$key};
+        $sums{$key}[$_] += $values[$_] for (0 .. $#values);
+        $counts{$key}++;
+        $latency{$key} = $latency;
+    }
+    close $fh;
+
+    foreach my $key (sort { (split ";", $a)[1] <=> (split ";", $b)[1] or $a cmp $b } keys %sums) {
+        my ($mode, $nals) = split ";", $key;
+        my @avg = map { $_ / $counts{$key} } @{$sums{$key}};
+
+        if ($latency{$key}) {
+            printf("%s, %.2f NAL units per frame: %.1f%% of frames complete, avg %.3f ms, max %.3f ms (%d rounds)\n",
+                $mode, $nals, $avg[0], $avg[1], $avg[2], $counts{$key});
+        } else {
+            printf("%s, %.2f NAL units per frame: %.3f us CPU per frame, %.3f ms CPU total (%d rounds)\n",
+                $mode, $nals, $avg[0], $avg[1], $counts{$key});
+        }
+    }
+}
+
 sub print_help {
     print "usage (one file, send/recv):\n  ./parse.pl \n"
-    . "\t--lib <uvgrtp|ffmpeg|live555>\n"
+    . "\t--lib <uvgrtp|ffmpeg|live555|gstreamer>\n"
     . "\t--role <send|recv>\n"
     . "\t--unit <mb|mbit|gbit> (defaults to mb)\n"
     . "\t--path <path to log file>\n"
@@ -426,9 +467,13 @@ sub print_help {
     . "\t--path <path to log file>\n"
     . "\t--parse latency\n\n";
 
+    print "usage (NAL units per frame):\n  ./parse.pl \n"
+    . "\t--path <path to latency_results_nals or a sender _cpu file>\n"
+    . "\t--parse nals\n\n";
+
     print "usage (directory):\n  ./parse.pl \n"
     . "\t--parse <best|all|csv>\n"
-    . "\t--lib <uvgrtp|ffmpeg|live555>\n"
+    . "\t--lib <uvgrtp|ffmpeg|live555|gstreamer>\n"
     . "\t--iter <# of iterations> (not needed if correct file format)\n"
     . "\t--unit <mb|mbit|gbit> (defaults to mb)\n"
     . "\t--filesize <size of the test file in bytes> (use ls -l to get this, mandatory)\n"
@@ -452,19 +497,19 @@ GetOptions(
     "help"            => \(my $help = 0)
 ) or die "failed to parse command line!\n";
 
-$lib     = $1 if (!$lib     and $path =~ m/.*(uvgrtp|ffmpeg|live555).*/i);
+$lib     = $1 if (!$lib     and $path =~ m/.*(uvgrtp|ffmpeg|live555|gstreamer).*/i);
 $role    = $1 if (!$role    and $path =~ m/.*(recv|send).*/i);
 $threads = $1 if (!$threads and $path =~ m/.*_(\d+)threads.*/i);
 $iter    = $1 if (!$iter    and $path =~ m/.*_(\d+)rounds.*/i);
 
-print_help() if $help or (!$lib and $parse ne "latency");
+print_help() if $help or (!$lib and $parse ne "latency" and $parse ne "nals");
 print_help() if !$iter and !$parse;
 print_help() if !$parse and (!$role or !$threads);
 print_help() if !grep /$unit/, ("mb", "MB", "mbit", "Mbit", "Gbit", "gbit");
 
-die "library not implemented\n" if !grep (/$lib/, ("uvgrtp", "ffmpeg", "live555"));
+die "library not implemented\n" if !grep (/$lib/, ("uvgrtp", "ffmpeg", "live555", "gstreamer"));
 
-die "please specify test file size from ls -l command with --filesize" if !$filesize and $parse ne "latency";
+die "please specify test file size from ls -l command with --filesize" if !$filesize and $parse ne "latency" and $parse ne "nals";
 
 if ($parse eq "best" or $parse eq "all") {
     parse($lib, $iter, $path, $pkt_loss, $frame_loss, $parse, $unit, $filesize);
@@ -472,6 +517,8 @@ if ($parse eq "best" or $parse eq "all") {
     parse_csv($lib, $iter, $path, $unit, $filesize);
 } elsif ($parse eq "latency") {
     parse_latency($lib, $path, $nframes, $unit);
+} elsif ($parse eq "nals") {
+    parse_nals($path);
 } elsif ($role eq "send") {
     print_send($lib, $iter, $threads, $path, $unit, $filesize);
 } elsif ($role eq "recv") {
@@ -0,0 +1,85 @@
+#include "util.hh"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Creates the version 2 chunk index (.m<ext> file) for an existing HEVC or VVC Annex-B file, for example one
+ * that was not encoded with test_file_creation. Each access unit becomes one chunk.
+ * The file is mapped without MAP_POPULATE and read once front to back, so files larger than memory work too */
+
+int main(int argc, char **argv)
+{
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "usage: ./%s <input file> <format> [fps]\n", __FILE__);
+        return EXIT_FAILURE;
+    }
+
+    std::string input_file = argv[1];
+    bool vvc_enabled       = get_vvc_state(argv[2]);
+    uint32_t fps           = (argc == 4) ? atoi(argv[3]) : 0;
+
+    int fd = open(input_file.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "Failed to open input file: " << input_file << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        std::cerr << "Failed to read the size of the input file: " << input_file << std::endl;
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    size_t len = st.st_size;
+    void* mem = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mem == MAP_FAILED) {
+        std::cerr << "Failed to map input file: " << input_file << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the file is scanned once from start to end, so read ahead aggressively and drop pages behind the scan
+    madvise(mem, len, MADV_SEQUENTIAL);
+
+    std::vector<chunk_index_frame> frames;
+    std::vector<chunk_index_nal> nals;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    index_access_units((const uint8_t*)mem, len, vvc_enabled, frames, nals);
+    auto diff = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+
+    munmap(mem, len);
+
+    if (frames.empty()) {
+        std::cerr << "No NAL units found in " << input_file << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string index_file = get_chunk_filename(input_file);
+    if (!write_chunk_index(index_file, frames, nals, vvc_enabled, fps, 1)) {
+        return EXIT_FAILURE;
+    }
+
+    uint64_t intra = 0;
+    for (auto& frame : frames) {
+        intra += frame.intra;
+    }
+
+    std::cout << input_file << ": " << frames.size() << " access units (" << intra << " intra), " << nals.size()
+        << " NAL units, indexed in " << diff / 1000 << " ms (" << (diff ? (double)len / diff : 0) << " MB/s)" << std::endl;
+    std::cout << "Wrote " << index_file << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -1,28 +1,60 @@
+#include <algorithm>
 #include <chrono>
-#include <mutex>
 #include <thread>
 
+#include <sys/time.h>
+
 #include "live555_util.hh"
+#include "util.hh"
 
 #define MAX_WRITE_SIZE 1444
 
-extern int get_next_frame_start(uint8_t *data, uint32_t offset, uint32_t data_len, uint8_t& start_len);
-
-FramedSourceCustom::FramedSourceCustom(UsageEnvironment *env)
-    :FramedSource(*env)
+FramedSourceCustom::FramedSourceCustom(UsageEnvironment *env, bool wholeNals)
+    :FramedSource(*env),
+    wholeNals_(wholeNals),
+    chunks_(CHUNK_QUEUE_SIZE),
+    producerDone_(false),
+    stopProducer_(false),
+    waiting_(false)
 {
     len_ = 0;
     off_ = 0;
     chunk_ptr_ = 0;
+    c_nal_ = nullptr;
+    nal_ptr_ = 0;
+    nal_end_ = 0;
+    inChunk_ = false;
+    nals_ = &ownNals_;
+    chunkNals_ = &ownChunkNals_;
+    total_size_ = 0;
     afterEvent_ = envir().taskScheduler().createEventTrigger((TaskFunc*)FramedSource::afterGetting);
+    dataEvent_  = envir().taskScheduler().createEventTrigger(sendFrame0);
 }
 
 FramedSourceCustom::~FramedSourceCustom()
 {
+    stopProducer_ = true;
+
+    if (producer_.joinable())
+        producer_.join();
+
+    envir().taskScheduler().deleteEventTrigger(dataEvent_);
+    envir().taskScheduler().deleteEventTrigger(afterEvent_);
+}
+
+void FramedSourceCustom::sendFrame0(void *clientData)
+{
+    FramedSourceCustom *source = (FramedSourceCustom *)clientData;
+
+    if (source->isCurrentlyAwaitingData())
+        source->sendFrame();
 }
 
 void FramedSourceCustom::doGetNextFrame()
 {
+    if (!producer_.joinable())
+        startProducer();
+
     if (isCurrentlyAwaitingData())
         sendFrame();
 }
@@ -32,60 +64,42 @@ void FramedSourceCustom::doStopGettingFrames()
     noMoreTasks_ = true;
 }
 
-void FramedSourceCustom::splitIntoNals()
-{
-    uint8_t start_len;
-    int32_t prev_offset = 0;
-    int offset = get_next_frame_start((uint8_t *)c_chunk_, 0, c_chunk_len_, start_len);
-    prev_offset = offset;
-
-    while (offset != -1) {
-        offset = get_next_frame_start((uint8_t *)c_chunk_, offset, c_chunk_len_, start_len);
-
-        if (offset > 4 && offset != -1) {
-            nals_.push(std::make_pair(offset - prev_offset - start_len, &c_chunk_[prev_offset]));
-            prev_offset = offset;
-        }
-    }
-
-    if (prev_offset == -1)
-        prev_offset = 0;
-
-    nals_.push(std::make_pair(c_chunk_len_ - prev_offset, &c_chunk_[prev_offset]));
-}
-
 void FramedSourceCustom::sendFrame()
 {
-    /* initialization is not ready but scheduler
-     * is already asking for frames, send empty frame */
-    if (len_ == 0 && off_ == 0) {
-        fFrameSize = 0;
-        envir().taskScheduler().triggerEvent(afterEvent_, this);
-        return;
-    }
+    if (!inChunk_) {
+        std::pair<size_t, size_t> cinfo;
+
+        /* read the flag first, the producer sets it only after its last chunk is in the ring */
+        bool done = producerDone_;
+
+        if (!chunks_.try_pop(cinfo)) {
+            /* announce that we are waiting and check again, so that a chunk pushed
+             * in between is not missed. Otherwise the producer triggers dataEvent_ */
+            waiting_ = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!chunks_.try_pop(cinfo)) {
+                if (done) {
+                    waiting_ = false;
+                    printStats();
+                }
+                return;
+            }
+            waiting_ = false;
+        }
 
-    if (c_chunk_ == nullptr) {
         fpt_start_ = std::chrono::high_resolution_clock::now();
-
-        if (chunks_.empty()) {
-            printStats();
-        }
+        gettimeofday(&chunkTime_, nullptr);
 
         /* TODO: framer */
 
-        auto cinfo   = chunks_.front();
-        chunks_.pop();
-
-        c_chunk_     = cinfo.second;
-        c_chunk_len_ = cinfo.first;
-        c_chunk_off_ = 0;
-
-        splitIntoNals();
+        nal_ptr_  = cinfo.first;
+        nal_end_  = cinfo.first + cinfo.second;
+        inChunk_  = true;
     }
 
     if (c_nal_ == nullptr) {
-        auto ninfo = nals_.front();
-        nals_.pop();
+        auto& ninfo = (*nals_)[nal_ptr_++];
 
         c_nal_     = ninfo.second;
         c_nal_len_ = ninfo.first;
@@ -96,7 +110,12 @@ void FramedSourceCustom::sendFrame()
     size_t send_len = 0;
     size_t send_off = 0;
 
-    if (c_nal_len_ < MAX_WRITE_SIZE) {
+    if (wholeNals_) {
+        send_len = std::min(c_nal_len_, (size_t)fMaxSize);
+        send_ptr = c_nal_;
+        send_off = 0;
+        fNumTruncatedBytes = c_nal_len_ - send_len;
+    } else if (c_nal_len_ < MAX_WRITE_SIZE) {
         send_len = c_nal_len_;
         send_ptr = c_nal_;
         send_off = 0;
@@ -114,13 +133,15 @@ void FramedSourceCustom::sendFrame()
 
     memcpy(fTo, (uint8_t *)send_ptr + send_off, send_len);
     fFrameSize = send_len;
+    fPresentationTime = chunkTime_;
     afterGetting(this);
 
-    /* check if we need to change chunk or nal unit */
-    bool nal_written_fully = (c_nal_len_ <= c_nal_off_ + send_len);
+    /* check if we need to change chunk or nal unit, a truncated NAL unit is not continued */
+    bool nal_written_fully = wholeNals_ || (c_nal_len_ <= c_nal_off_ + send_len);
 
-    if (nal_written_fully && nals_.empty()) {
-        c_chunk_ = nullptr;
+    if (nal_written_fully && nal_ptr_ == nal_end_) {
+        inChunk_ = false;
+        c_nal_   = nullptr;
 
         n_calls_++;
         fpt_end_ = std::chrono::high_resolution_clock::now();
@@ -136,9 +157,16 @@ void FramedSourceCustom::sendFrame()
 
 void FramedSourceCustom::printStats()
 {
-    *stop_ = 1;
+    if (stop_)
+        *stop_ = 1;
     end_   = std::chrono::high_resolution_clock::now();
 
+    /* with shared tables, the size is only summed up here to keep it out of the session setup */
+    if (!total_size_) {
+        for (auto& nal : *nals_)
+            total_size_ += nal.first;
+    }
+
     uint64_t diff = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(end_ - start_).count();
 
     fprintf(stderr, "%lu bytes, %lu kB, %lu MB took %lu ms %lu s\n",
@@ -147,7 +175,8 @@ void FramedSourceCustom::printStats()
     );
 
     fprintf(stderr, "n calls %u\n", n_calls_);
-    fprintf(stderr, "avg processing time of frame: %lu\n", diff_total_ / n_calls_);
+    if (n_calls_)
+        fprintf(stderr, "avg processing time of frame: %lu\n", diff_total_ / n_calls_);
 }
 
 void FramedSourceCustom::startFramedSource(void *mem, size_t len, char *stop_rtp)
@@ -159,11 +188,9 @@ void FramedSourceCustom::startFramedSource(void *mem, size_t len, char *stop_rtp
     diff_total_ = 0;
     stop_       = stop_rtp;
 
-    c_chunk_     = nullptr;
-    c_chunk_len_ = 0;
-    c_chunk_off_ = 0;
     total_size_  = 0;
 
+    /* find the NAL units of all chunks before sending starts */
     uint64_t chunk_size = 0;
 
     for (size_t i = 0, k = 0; i < len && k < 3000; k++) {
@@ -171,13 +198,66 @@ void FramedSourceCustom::startFramedSource(void *mem, size_t len, char *stop_rtp
 
         i += sizeof(uint64_t);
 
-        chunks_.push(std::make_pair(chunk_size, (uint8_t *)mem_ + i));
+        size_t first = ownNals_.size();
+        scan_nal_units((uint8_t *)mem_ + i, chunk_size, ownNals_);
+
+        /* an empty chunk would have nothing to send */
+        if (ownNals_.size() > first)
+            ownChunkNals_.push_back(std::make_pair(first, ownNals_.size() - first));
 
         i += chunk_size;
         total_size_ += chunk_size;
     }
+}
 
+void FramedSourceCustom::startFramedSource(const std::vector<std::pair<size_t, uint8_t *>>& nals,
+    const std::vector<std::pair<size_t, size_t>>& chunkNals, char *stop_rtp)
+{
+    mem_        = nullptr;
+    len_        = 0;
+    off_        = 0;
+    n_calls_    = 0;
+    diff_total_ = 0;
+    stop_       = stop_rtp;
+
+    nals_       = &nals;
+    chunkNals_  = &chunkNals;
+    total_size_ = 0;
+}
+
+void FramedSourceCustom::startProducer()
+{
     start_ = std::chrono::high_resolution_clock::now();
+
+    producer_ = std::thread(&FramedSourceCustom::produceChunks, this);
+}
+
+void FramedSourceCustom::pushChunk(std::pair<size_t, size_t> chunk)
+{
+    while (!chunks_.try_push(chunk)) {
+        if (stopProducer_)
+            return;
+        std::this_thread::yield();
+    }
+
+    /* wake up the event loop only if it found the ring empty */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (waiting_.exchange(false))
+        envir().taskScheduler().triggerEvent(dataEvent_, this);
+}
+
+void FramedSourceCustom::produceChunks()
+{
+    for (size_t i = 0; i < chunkNals_->size() && !stopProducer_; ++i) {
+        pushChunk((*chunkNals_)[i]);
+    }
+
+    producerDone_ = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (waiting_.exchange(false))
+        envir().taskScheduler().triggerEvent(dataEvent_, this);
 }
 
 void createConnection(
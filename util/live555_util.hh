@@ -8,36 +8,63 @@
 #include <Groupsock.hh>
 #include <GroupsockHelper.hh>
 
+#include "spsc_queue.hh"
+
 #include <cstring>
 #include <string>
 #include <netinet/ip.h>
 #include <arpa/inet.h>
-#include <queue>
+#include <atomic>
 #include <chrono>
-#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of chunks the producer thread may be ahead of the event loop
+#define CHUNK_QUEUE_SIZE 256
+
+/* The chunks of the input file are produced by a separate thread and handed to the Live555 event loop
+ * through a lock-free single-producer/single-consumer ring. The event loop is woken up with an event
+ * trigger only when it has found the ring empty, so a steady stream of chunks costs no locking or
+ * scheduler round trips. The NAL units of all chunks are found once before sending starts, so the event
+ * loop only copies them out. The producer starts when the first frame is asked for, so a source that
+ * is set up but not played does not spin on a full ring */
 
 class FramedSourceCustom : public FramedSource
 {
 public:
-    FramedSourceCustom(UsageEnvironment *env);
+    /* By default NAL units larger than MAX_WRITE_SIZE are given out in pieces. With wholeNals,
+     * each frame is one whole NAL unit, as expected by H265VideoStreamDiscreteFramer */
+    FramedSourceCustom(UsageEnvironment *env, bool wholeNals = false);
     ~FramedSourceCustom();
 
     void startFramedSource(void *mem, size_t len, char *stop_rtp);
+
+    /* Start with NAL units found by the caller, so that many sources can share one scan of the
+     * input file. The tables are not copied, so they and the memory the NAL units point to must
+     * outlive the source. stop_rtp may be null */
+    void startFramedSource(const std::vector<std::pair<size_t, uint8_t *>>& nals,
+        const std::vector<std::pair<size_t, size_t>>& chunkNals, char *stop_rtp);
+
     virtual void doGetNextFrame();
 
 protected:
     virtual void doStopGettingFrames();
 
 private:
+    static void sendFrame0(void *clientData);
     void sendFrame();
     void printStats();
-    void splitIntoNals();
+    void startProducer();
+    void produceChunks();
+    void pushChunk(std::pair<size_t, size_t> chunk);
 
     EventTriggerId afterEvent_;
+    EventTriggerId dataEvent_;
 
     bool separateInput_;
     bool ending_;
     bool removeStartCodes_;
+    bool wholeNals_;
 
     char *stop_;
 
@@ -53,15 +80,30 @@ private:
     uint8_t *c_nal_;
     size_t c_nal_len_;
     size_t c_nal_off_;
-    std::queue<std::pair<size_t, uint8_t *>> nals_;
 
-    uint8_t *c_chunk_;
-    size_t c_chunk_len_;
-    size_t c_chunk_off_;
+    /* NAL units of all chunks as (size, pointer) and the (first NAL, NAL count) of each chunk.
+     * These point to the tables of the caller or to the own tables built in startFramedSource() */
+    const std::vector<std::pair<size_t, uint8_t *>> *nals_;
+    const std::vector<std::pair<size_t, size_t>> *chunkNals_;
+    std::vector<std::pair<size_t, uint8_t *>> ownNals_;
+    std::vector<std::pair<size_t, size_t>> ownChunkNals_;
+
+    /* NAL units of the current chunk that are still to be sent, only touched by the event loop */
+    size_t nal_ptr_;
+    size_t nal_end_;
+    bool inChunk_;
+
+    /* all NAL units of a chunk get the time the chunk was taken from the ring */
+    struct timeval chunkTime_;
 
     int chunk_ptr_;
-    std::queue<std::pair<size_t, uint8_t *>> chunks_;
-    std::mutex mutex_;
+    spsc_queue<std::pair<size_t, size_t>> chunks_;
+    std::thread producer_;
+    std::atomic<bool> producerDone_;
+    std::atomic<bool> stopProducer_;
+
+    /* set by the event loop when it found the ring empty, the producer triggers dataEvent_ only then */
+    std::atomic<bool> waiting_;
 
     TaskToken currentTask_;
     std::chrono::high_resolution_clock::time_point start_, end_, fpt_end_, fpt_start_;
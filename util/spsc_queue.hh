@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/* Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ * The capacity is rounded up to a power of two. The head and tail are on separate cache lines
+ * and each side caches the other side's index, so that the shared indices are read only when
+ * the queue looks full or empty */
+template <typename T>
+class spsc_queue {
+public:
+    explicit spsc_queue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        buffer_.resize(size);
+        mask_ = size - 1;
+    }
+
+    // Producer only. Returns false if the queue is full
+    bool try_push(const T& item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_) {
+                return false;
+            }
+        }
+
+        buffer_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty
+    bool try_pop(T& item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return false;
+            }
+        }
+
+        item = buffer_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called while the other side is active
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> buffer_;
+    size_t mask_ = 0;
+
+    alignas(64) std::atomic<size_t> head_{0};   // Next item to pop, written by the consumer
+    size_t tail_cache_ = 0;                     // Consumer's copy of tail_
+
+    alignas(64) std::atomic<size_t> tail_{0};   // Next free slot, written by the producer
+    size_t head_cache_ = 0;                     // Producer's copy of head_
+};
@@ -0,0 +1,85 @@
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+/* Measures the throughput of the start code scanners over a test file, for example the 4K HEVC file.
+ * The byte-at-a-time loop that get_next_frame_start() used before is included as a baseline */
+
+static const uint8_t *scan_start_code_bytewise(const uint8_t *p, const uint8_t *end)
+{
+    uint8_t zeros = 0;
+
+    for (; p < end; p++) {
+        if (zeros >= 2 && *p == 1)
+            return p - 2;
+
+        if (*p == 0)
+            zeros++;
+        else
+            zeros = 0;
+    }
+    return end;
+}
+
+static size_t count_start_codes(start_code_scanner scanner, const uint8_t *p, const uint8_t *end)
+{
+    size_t count = 0;
+
+    while ((p = scanner(p, end)) != end) {
+        count++;
+        p += 3;
+    }
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "usage: ./%s <input file> [rounds]\n", __FILE__);
+        return EXIT_FAILURE;
+    }
+
+    int rounds = (argc == 3) ? atoi(argv[2]) : 20;
+    size_t len = 0;
+    const uint8_t *mem = (const uint8_t *)get_mem(argv[1], len);
+    if (mem == nullptr) {
+        return EXIT_FAILURE;
+    }
+
+    const std::pair<std::string, start_code_scanner> scanners[] = {
+        { "bytewise", scan_start_code_bytewise },
+        { "scalar",   get_start_code_scanner(SCANNER_SCALAR) },
+        { "sse2",     get_start_code_scanner(SCANNER_SSE2) },
+        { "avx2",     get_start_code_scanner(SCANNER_AVX2) },
+        { "avx512",   get_start_code_scanner(SCANNER_AVX512) }
+    };
+
+    size_t expected = count_start_codes(scan_start_code_bytewise, mem, mem + len);
+    std::cout << argv[1] << ": " << len << " bytes, " << expected << " start codes, " << rounds << " rounds" << std::endl;
+
+    for (auto& s : scanners) {
+        if (!s.second) {
+            std::cout << s.first << ": not supported" << std::endl;
+            continue;
+        }
+
+        size_t count = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < rounds; ++i) {
+            count = count_start_codes(s.second, mem, mem + len);
+        }
+        auto diff = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - start).count();
+
+        if (count != expected) {
+            std::cerr << s.first << ": found " << count << " start codes, expected " << expected << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << s.first << ": " << (double)len * rounds / diff << " MB/s" << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+#include "stream_reader.hh"
+
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+stream_reader::stream_reader(const std::string& filename, const std::vector<uint64_t>& chunk_sizes, size_t consumers,
+    size_t buffer_size, size_t buffers):
+    filename_(filename),
+    chunk_sizes_(chunk_sizes),
+    buffers_(buffers < 2 ? 2 : buffers),
+    consumers_(consumers < 1 ? 1 : consumers)
+{
+    for (auto& b : buffers_) {
+        b.data.resize(buffer_size);
+    }
+}
+
+stream_reader::~stream_reader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+
+    if (reader_.joinable()) {
+        reader_.join();
+    }
+
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool stream_reader::start()
+{
+    fd_ = open(filename_.c_str(), O_RDONLY, 0);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open test file: " << filename_ << std::endl;
+        return false;
+    }
+
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // return once the first buffer has been read, so that the sender can start right away
+    auto start = std::chrono::high_resolution_clock::now();
+    reader_ = std::thread(&stream_reader::read_loop, this);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [&] { return buffers_[0].ready || failed_ || chunk_sizes_.empty(); });
+
+    startup_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    return !failed_;
+}
+
+bool stream_reader::is_released(const buffer& buf) const
+{
+    for (auto& c : consumers_) {
+        if (c.released < buf.first_chunk + buf.chunk_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void stream_reader::read_loop()
+{
+    uint64_t chunk = 0;
+    uint64_t offset = 0;
+    size_t b = 0;
+
+    while (chunk < chunk_sizes_.size()) {
+        buffer& buf = buffers_[b];
+
+        // wait until every sender has moved on from this buffer
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [&] { return !buf.ready || is_released(buf) || stop_; });
+            if (stop_) {
+                return;
+            }
+            buf.ready = false;
+        }
+
+        // take as many whole chunks as fit, but always at least one
+        uint64_t bytes = chunk_sizes_[chunk];
+        uint64_t count = 1;
+        while (chunk + count < chunk_sizes_.size() && bytes + chunk_sizes_[chunk + count] <= buf.data.size()) {
+            bytes += chunk_sizes_[chunk + count];
+            ++count;
+        }
+        if (bytes > buf.data.size()) {
+            buf.data.resize(bytes);
+        }
+
+        uint64_t done = 0;
+        while (done < bytes) {
+            ssize_t ret = pread(fd_, buf.data.data() + done, bytes - done, offset + done);
+            if (ret <= 0) {
+                std::cerr << "Failed to read " << filename_ << " at offset " << offset + done << std::endl;
+                std::lock_guard<std::mutex> lock(mutex_);
+                failed_ = true;
+                cond_.notify_all();
+                return;
+            }
+            done += ret;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buf.first_chunk = chunk;
+            buf.chunk_count = count;
+            buf.ready = true;
+        }
+        cond_.notify_all();
+
+        chunk += count;
+        offset += bytes;
+        b = (b + 1) % buffers_.size();
+    }
+}
+
+const uint8_t* stream_reader::next_chunk(size_t consumer, std::chrono::high_resolution_clock::time_point due)
+{
+    consumer_state& c = consumers_[consumer];
+
+    if (c.next >= chunk_sizes_.size()) {
+        return nullptr;
+    }
+
+    buffer* buf = &buffers_[c.current];
+
+    if (c.started && c.next == buf->first_chunk + buf->chunk_count) {
+        // the current buffer has been sent, let the reader refill it once the other senders are done with it
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            c.released = c.next;
+        }
+        cond_.notify_all();
+
+        c.current = (c.current + 1) % buffers_.size();
+        buf = &buffers_[c.current];
+        c.position = 0;
+    }
+
+    // the buffer may still hold older chunks that another sender has not released yet
+    bool waited = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto has_chunk = [&] { return buf->ready && buf->first_chunk == c.next; };
+
+        if (!has_chunk()) {
+            waited = true;
+            cond_.wait(lock, [&] { return has_chunk() || failed_; });
+        }
+        if (!has_chunk()) {
+            return nullptr;
+        }
+    }
+
+    // late means read after the send time of the chunk, regardless of when the sender asked for it
+    auto now = std::chrono::high_resolution_clock::now();
+    if (waited && now > due) {
+        c.late.push_back({ c.next, (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - due).count() });
+    }
+    c.started = true;
+
+    const uint8_t* chunk = buf->data.data() + c.position;
+    c.position += chunk_sizes_[c.next];
+    ++c.next;
+    return chunk;
+}
+
+void stream_reader::finish(size_t consumer)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        consumers_[consumer].released = UINT64_MAX;
+    }
+    cond_.notify_all();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Size of one read buffer. A buffer always holds whole chunks, so it grows if a chunk is larger
+constexpr size_t STREAM_READER_BUFFER_SIZE = 64 * 1024 * 1024;
+
+/* Reads the chunks of a test file with pread() in a background thread instead of mapping the whole file
+ * with get_mem(), so files larger than memory can be sent and startup does not depend on file size.
+ * While the senders use the chunks of one buffer, the next buffers are being filled. The file is read once
+ * for all consumers (sender threads), and a buffer is refilled when every consumer has moved past it.
+ * A chunk that is read only after its send time is recorded as late */
+class stream_reader {
+public:
+    stream_reader(const std::string& filename, const std::vector<uint64_t>& chunk_sizes, size_t consumers = 1,
+        size_t buffer_size = STREAM_READER_BUFFER_SIZE, size_t buffers = 2);
+    ~stream_reader();
+
+    // Open the file, start reading and wait for the first buffer. Returns false if the file cannot be read
+    bool start();
+
+    /* Returns the next chunk of the consumer in file order, or nullptr at the end of the file or after a read
+     * error. due is the send time of the chunk. The chunk stays valid until the next call of the consumer */
+    const uint8_t* next_chunk(size_t consumer, std::chrono::high_resolution_clock::time_point due);
+
+    // The consumer does not need any more chunks, so it no longer holds back the reader
+    void finish(size_t consumer);
+
+    // Chunks of the consumer that were read after their send time, as <chunk number, us late>
+    const std::vector<std::pair<uint64_t, uint64_t>>& late_chunks(size_t consumer) const
+    {
+        return consumers_[consumer].late;
+    }
+
+    // Time start() waited for the first buffer
+    uint64_t startup_us() const { return startup_us_; }
+
+private:
+    struct buffer {
+        std::vector<uint8_t> data;
+        uint64_t first_chunk = 0;
+        uint64_t chunk_count = 0;
+        bool ready = false;
+    };
+
+    // Owned by one sender thread, except released which the reader reads
+    struct consumer_state {
+        size_t current = 0;     // Buffer in use
+        uint64_t next = 0;      // Next chunk to return
+        uint64_t position = 0;  // Offset of the next chunk in the current buffer
+        bool started = false;
+        uint64_t released = 0;  // Chunks before this are no longer used, guarded by mutex_
+        std::vector<std::pair<uint64_t, uint64_t>> late;
+    };
+
+    void read_loop();
+    bool is_released(const buffer& buf) const;
+
+    std::string filename_;
+    std::vector<uint64_t> chunk_sizes_;
+    std::vector<buffer> buffers_;
+    std::vector<consumer_state> consumers_;
+    int fd_ = -1;
+
+    std::thread reader_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_ = false;
+    bool failed_ = false;
+
+    uint64_t startup_us_ = 0;
+};
@@ -0,0 +1,172 @@
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/* Generates an HEVC or VVC shaped Annex-B test file and its chunk index without an encoder.
+ * The NAL unit headers, parameter sets, picture types and slice structure follow the real bitstream,
+ * but the payloads are random bytes with emulation prevention. The RTP libraries do not decode the
+ * stream, so the file can be used in place of an encoded one in all goodput and latency benchmarks */
+
+// Default bitrate, in bits per pixel, if none is given
+constexpr double DEFAULT_BITS_PER_PIXEL = 0.05;
+
+// Frame sizes vary randomly by this much around the average of their picture type
+constexpr double FRAME_SIZE_DEVIATION = 0.1;
+
+// NAL unit types written by the generator
+constexpr uint8_t HEVC_TRAIL_R    = 1;
+constexpr uint8_t HEVC_IDR_W_RADL = 19;
+constexpr uint8_t HEVC_VPS        = 32;
+constexpr uint8_t HEVC_SPS        = 33;
+constexpr uint8_t HEVC_PPS        = 34;
+
+constexpr uint8_t VVC_TRAIL       = 0;
+constexpr uint8_t VVC_IDR_W_RADL  = 7;
+constexpr uint8_t VVC_SPS         = 15;
+constexpr uint8_t VVC_PPS         = 16;
+constexpr uint8_t VVC_PH          = 19;
+
+/* Append a NAL unit with a four byte start code. The first payload byte is given, the rest is random.
+ * Emulation prevention bytes are inserted the same way as an encoder would, so the only start codes
+ * in the file are the ones written here */
+void write_nal(std::vector<uint8_t>& out, bool vvc, uint8_t type, uint8_t first_byte, size_t payload_size,
+    std::mt19937& rng)
+{
+    out.insert(out.end(), { 0, 0, 0, 1 });
+
+    if (vvc) {
+        out.push_back(0);                                // forbidden_zero_bit, nuh_reserved_zero_bit, nuh_layer_id
+        out.push_back((uint8_t)((type << 3) | 1));       // nal_unit_type, nuh_temporal_id_plus1
+    }
+    else {
+        out.push_back((uint8_t)(type << 1));             // forbidden_zero_bit, nal_unit_type, nuh_layer_id
+        out.push_back(1);                                // nuh_layer_id, nuh_temporal_id_plus1
+    }
+
+    std::uniform_int_distribution<int> byte(0, 255);
+    int zeros = 0;
+
+    for (size_t i = 0; i < payload_size; ++i) {
+        uint8_t b = (i == 0) ? first_byte : (uint8_t)byte(rng);
+
+        // rbsp_trailing_bits, the payload never ends with a zero byte
+        if (i == payload_size - 1) {
+            b |= 0x80;
+        }
+
+        if (zeros >= 2 && b <= 3) {
+            out.push_back(3);
+            zeros = 0;
+        }
+        out.push_back(b);
+        zeros = (b == 0) ? zeros + 1 : 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 9 || argc > 11) {
+        fprintf(stderr, "usage: ./%s <output file> <format> <width> <height> <fps> <frames> <intra period> \
+            <bitrate kbps, 0 = default> [I/P size ratio] [slices per frame]\n", __FILE__);
+        return EXIT_FAILURE;
+    }
+
+    std::string output_file = argv[1];
+    bool vvc_enabled        = get_vvc_state(argv[2]);
+    int width               = atoi(argv[3]);
+    int height              = atoi(argv[4]);
+    int fps                 = atoi(argv[5]);
+    int frame_count         = atoi(argv[6]);
+    int intra_period        = atoi(argv[7]);
+    double bitrate          = atof(argv[8]) * 1000;
+    double ip_ratio         = (argc >= 10) ? atof(argv[9]) : 5;
+    int slices              = (argc >= 11) ? atoi(argv[10]) : 1;
+
+    if (width <= 0 || height <= 0 || fps <= 0 || frame_count <= 0 || intra_period < 0 || bitrate < 0 ||
+        ip_ratio < 1 || slices <= 0)
+    {
+        std::cerr << "Invalid command line arguments" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (bitrate == 0) {
+        bitrate = DEFAULT_BITS_PER_PIXEL * width * height * fps;
+    }
+
+    /* Split the bytes of one intra period between one intra frame and the inter frames, so that
+     * the intra frame is ip_ratio times larger than an inter frame. Without an intra period only
+     * the first frame is intra */
+    int period = (intra_period > 0) ? intra_period : frame_count;
+    double average_size = bitrate / 8 / fps;
+    double inter_size   = average_size * period / (ip_ratio + period - 1);
+    double intra_size   = inter_size * ip_ratio;
+
+    std::cout << "Generating " << frame_count << " " << (vvc_enabled ? "VVC" : "HEVC") << " frames. Res: "
+        << width << "x" << height << " fps: " << fps << " bitrate: " << bitrate / 1000000 << " Mbps, intra "
+        << (uint64_t)intra_size << " bytes, inter " << (uint64_t)inter_size << " bytes, " << slices
+        << " slices per frame" << std::endl;
+
+    std::ofstream outputFile(output_file, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!outputFile.good()) {
+        std::cerr << "Failed to open output file: " << output_file << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Fixed seed, the same parameters always give the same file
+    std::mt19937 rng(1);
+    std::normal_distribution<double> deviation(1.0, FRAME_SIZE_DEVIATION);
+
+    std::vector<chunk_index_frame> frames;
+    std::vector<chunk_index_nal> nals;
+    std::vector<uint8_t> frame;
+    uint64_t offset = 0;
+
+    for (int i = 0; i < frame_count; ++i) {
+        frame.clear();
+        bool intra = (i % period == 0);
+
+        size_t frame_size = (size_t)std::max(1.0, (intra ? intra_size : inter_size) * deviation(rng));
+        size_t slice_size = std::max<size_t>(2, frame_size / slices);
+
+        // Parameter sets are repeated before each intra frame, as kvazaar does
+        if (intra) {
+            if (!vvc_enabled) {
+                write_nal(frame, false, HEVC_VPS, 0x0c, 22, rng);
+            }
+            write_nal(frame, vvc_enabled, vvc_enabled ? VVC_SPS : HEVC_SPS, 0x01, 40, rng);
+            write_nal(frame, vvc_enabled, vvc_enabled ? VVC_PPS : HEVC_PPS, 0xc1, 8, rng);
+        }
+
+        /* HEVC: first_slice_segment_in_pic_flag is set in the first slice.
+         * VVC: a single slice carries the picture header, with more slices there is a picture header NAL unit */
+        if (vvc_enabled && slices > 1) {
+            write_nal(frame, true, VVC_PH, 0x40, 6, rng);
+        }
+
+        for (int s = 0; s < slices; ++s) {
+            uint8_t type = intra ? (vvc_enabled ? VVC_IDR_W_RADL : HEVC_IDR_W_RADL) : (vvc_enabled ? VVC_TRAIL : HEVC_TRAIL_R);
+            bool first_flag = vvc_enabled ? (slices == 1) : (s == 0);
+
+            write_nal(frame, vvc_enabled, type, first_flag ? 0xa0 : 0x20, slice_size, rng);
+        }
+
+        outputFile.write((const char*)frame.data(), frame.size());
+        index_chunk(frame.data(), offset, frame.size(), vvc_enabled, i, frames, nals);
+        offset += frame.size();
+    }
+    outputFile.close();
+
+    std::string mem_file = get_chunk_filename(output_file);
+    if (!write_chunk_index(mem_file, frames, nals, vvc_enabled, fps, 1)) {
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Wrote " << offset << " bytes to " << output_file << " and the chunk index to " << mem_file << std::endl;
+    return EXIT_SUCCESS;
+}
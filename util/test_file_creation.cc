@@ -6,22 +6,68 @@
 #include <string>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <sstream>
 
 #include <stdlib.h>
+#include <sys/mman.h>
+
+/* One configuration to encode. In batch mode, the jobs are the combinations of the given inputs,
+ * QPs, intra periods, presets and picture splits, and all jobs of an input share its mapped YUV file */
+struct encode_job {
+    const uint8_t* yuv = nullptr;
+    size_t yuv_len = 0;
+    std::string output;
+    std::string memory_filename;
+    int width = 0;
+    int height = 0;
+    int qp = 0;
+    int fps = 0;
+    int period = 0;
+    std::string preset;
+    std::string split = "none"; // none, wpp or <columns>x<rows> tiles
+    int threads = -1;           // kvazaar worker threads, -1 to use the kvazaar default
+};
+
+// Per frame prints are disabled in batch mode since the encoders run concurrently
+bool verbose = true;
+
+int kvazaar_encode(const encode_job& job);
+int batch_encode(int argc, char** argv);
+
+bool encode_frame(kvz_picture* input, int& rvalue, std::ofstream& outputFile, const kvz_api* api, kvz_encoder* enc,
+    uint64_t& offset, std::vector<chunk_index_frame>& frames, std::vector<chunk_index_nal>& nals);
+void cleanup_kvazaar(kvz_picture* input, const kvz_api* api, kvz_encoder* enc, kvz_config* config);
 
+std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
 
-int kvazaar_encode(const std::string& input, const std::string& output, const std::string& memory_filename,
-    int width, int height, int qp, int fps, int period, std::string& preset);
-
-bool encode_frame(kvz_picture* input, int& rvalue, std::ofstream& outputFile, std::ofstream& memoryFile,
-    const kvz_api* api, kvz_encoder* enc);
-void cleanup_kvazaar(kvz_picture* input, const kvz_api* api, kvz_encoder* enc, kvz_config* config);
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
 
 int main(int argc, char** argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        return batch_encode(argc, argv);
+    }
+
     if (argc != 8) {
         fprintf(stderr, "usage: ./%s <filename> <width> <height> <qp> <fps> <period> <preset>\n", __FILE__);
+        fprintf(stderr, "       ./%s --batch <filename:{width}x{height},...> <fps> <qps> <periods> <presets> \
+<splits> <workers> <kvazaar threads>\n", __FILE__);
         return EXIT_FAILURE;
     }
 
@@ -43,65 +89,169 @@ int main(int argc, char** argv)
         output_file = "out_" + output_file;
     }
 
-    std::string mem_file = get_chunk_filename(output_file);
+    encode_job job;
+    job.output = output_file;
+    job.memory_filename = get_chunk_filename(output_file);
 
-    int width = atoi(argv[2]);
-    int height = atoi(argv[3]);
+    job.width = atoi(argv[2]);
+    job.height = atoi(argv[3]);
 
-    int qp = atoi(argv[4]);
-    int fps = atoi(argv[5]);
-    int intra_period = atoi(argv[6]);
+    job.qp = atoi(argv[4]);
+    job.fps = atoi(argv[5]);
+    job.period = atoi(argv[6]);
 
-    std::string preset = argv[7];
+    job.preset = argv[7];
 
-    if (!width || !height || !qp || !fps || !intra_period || preset == "")
+    if (!job.width || !job.height || !job.qp || !job.fps || !job.period || job.preset == "")
     {
         std::cerr << "Invalid command line arguments" << std::endl;
         return EXIT_FAILURE;
     }
 
-    return kvazaar_encode(input_file, output_file, mem_file, width, height, qp, fps, intra_period, preset);
+    job.yuv = (const uint8_t*)get_mem(input_file, job.yuv_len);
+    if (job.yuv == nullptr) {
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Opening files. Input: " << input_file << " Output: " << output_file << std::endl;
+    return kvazaar_encode(job);
 }
 
-int kvazaar_encode(const std::string& input, const std::string& output, const std::string& memory_filename,
-    int width, int height, int qp, int fps, int period, std::string& preset)
+/* Encode every combination of the comma separated lists with a fixed number of concurrent encoders.
+ * Output files are named <input>_<width>x<height>_qp<qp>_i<period>_<preset>_<split>.hevc */
+int batch_encode(int argc, char** argv)
 {
-    std::cout << "Opening files. Input: " << input << " Output: " << output << std::endl;
-    std::cout << "Parameters. Res: " << width << "x" << height << " fps: " << fps << " qp: " << qp << std::endl;
+    if (argc != 10) {
+        fprintf(stderr, "usage: ./%s --batch <filename:{width}x{height},...> <fps> <qps> <periods> <presets> \
+<splits> <workers> <kvazaar threads>\n", __FILE__);
+        return EXIT_FAILURE;
+    }
 
-    std::ifstream inputFile (input,  std::ios::in  | std::ios::binary);
-    std::ofstream outputFile(output, std::ios::out | std::ios::binary);
-    std::ofstream memoryFile(memory_filename, std::ios::out | std::ios::binary);
+    int fps      = atoi(argv[3]);
+    int workers  = atoi(argv[8]);
+    int threads  = atoi(argv[9]);
 
-    if (!inputFile.good())
-    {
-        if (inputFile.eof())
+    if (!fps || workers <= 0) {
+        std::cerr << "Invalid command line arguments" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<encode_job> jobs;
+    std::vector<std::pair<void*, size_t>> inputs;
+
+    for (auto& input : split_list(argv[2])) {
+        size_t separator = input.find_last_of(':');
+        int width = 0;
+        int height = 0;
+
+        if (separator == std::string::npos ||
+            sscanf(input.substr(separator + 1).c_str(), "%dx%d", &width, &height) != 2 || !width || !height)
         {
-            std::cerr << "Input eof before starting" << std::endl;
+            std::cerr << "Invalid input, expected <filename>:<width>x<height>: " << input << std::endl;
+            return EXIT_FAILURE;
         }
-        else if (inputFile.bad())
-        {
-            std::cerr << "Input bad before starting" << std::endl;
+
+        std::string input_file = input.substr(0, separator);
+        size_t len = 0;
+        void* mem = get_mem(input_file, len);
+        if (mem == nullptr) {
+            return EXIT_FAILURE;
         }
-        else if (inputFile.fail())
-        {
-            std::cerr << "Input fail before starting" << std::endl;
+        inputs.push_back({ mem, len });
+
+        std::string base = input_file.substr(0, input_file.find_last_of('.'));
+
+        for (auto& qp : split_list(argv[4])) {
+            for (auto& period : split_list(argv[5])) {
+                for (auto& preset : split_list(argv[6])) {
+                    for (auto& split : split_list(argv[7])) {
+                        encode_job job;
+                        job.yuv     = (const uint8_t*)mem;
+                        job.yuv_len = len;
+                        job.width   = width;
+                        job.height  = height;
+                        job.qp      = atoi(qp.c_str());
+                        job.fps     = fps;
+                        job.period  = atoi(period.c_str());
+                        job.preset  = preset;
+                        job.split   = split;
+                        job.threads = threads;
+                        job.output  = base + "_" + std::to_string(width) + "x" + std::to_string(height) + "_qp" +
+                            qp + "_i" + period + "_" + preset + "_" + split + ".hevc";
+                        job.memory_filename = get_chunk_filename(job.output);
+
+                        if (!job.qp || !job.period) {
+                            std::cerr << "Invalid QP or intra period: " << qp << ", " << period << std::endl;
+                            return EXIT_FAILURE;
+                        }
+                        jobs.push_back(job);
+                    }
+                }
+            }
         }
+    }
+
+    std::cout << "Encoding " << jobs.size() << " files with " << workers << " concurrent encoders" << std::endl;
+    verbose = false;
+
+    std::atomic<size_t> next_job(0);
+    std::atomic<int> failed(0);
+    std::mutex print_mutex;
+    std::vector<std::thread> pool;
+
+    for (int i = 0; i < workers; ++i) {
+        pool.emplace_back([&]() {
+            size_t j;
+            while ((j = next_job++) < jobs.size()) {
+                int rvalue = kvazaar_encode(jobs.at(j));
+
+                std::lock_guard<std::mutex> lock(print_mutex);
+                std::cout << "[" << j + 1 << "/" << jobs.size() << "] " << jobs.at(j).output
+                    << (rvalue == EXIT_SUCCESS ? " done" : " failed") << std::endl;
+                if (rvalue != EXIT_SUCCESS) {
+                    ++failed;
+                }
+            }
+        });
+    }
+
+    for (auto& worker : pool) {
+        worker.join();
+    }
 
+    for (auto& input : inputs) {
+        munmap(input.first, input.second);
+    }
+
+    if (failed) {
+        std::cerr << failed << " of " << jobs.size() << " encodings failed" << std::endl;
         return EXIT_FAILURE;
     }
+    return EXIT_SUCCESS;
+}
+
+int kvazaar_encode(const encode_job& job)
+{
+    int width = job.width;
+    int height = job.height;
+
+    if (verbose) {
+        std::cout << "Parameters. Res: " << width << "x" << height << " fps: " << job.fps << " qp: " << job.qp << std::endl;
+    }
 
-    if (!outputFile.good() || !memoryFile.good())
+    std::ofstream outputFile(job.output, std::ios::out | std::ios::binary);
+
+    if (!outputFile.good())
     {
-        if (outputFile.eof() || memoryFile.eof())
+        if (outputFile.eof())
         {
             std::cerr << "Output eof before starting" << std::endl;
         }
-        else if (outputFile.bad() || memoryFile.bad())
+        else if (outputFile.bad())
         {
             std::cerr << "Output bad before starting" << std::endl;
         }
-        else if (outputFile.fail() || memoryFile.fail())
+        else if (outputFile.fail())
         {
             std::cerr << "Output fail before starting" << std::endl;
         }
@@ -113,80 +263,96 @@ int kvazaar_encode(const std::string& input, const std::string& output, const st
     const kvz_api* api = kvz_api_get(8);
     kvz_config* config = api->config_alloc();
     api->config_init(config);
-    api->config_parse(config, "preset", preset.c_str());
+    api->config_parse(config, "preset", job.preset.c_str());
     config->width = width;
     config->height = height;
     config->hash = kvz_hash::KVZ_HASH_NONE;
-    config->intra_period = period;
-    config->qp = qp;
-    config->framerate_num = fps;
+    config->intra_period = job.period;
+    config->qp = job.qp;
+    config->framerate_num = job.fps;
     config->framerate_denom = 1;
 
+    // Explicit threading, so that concurrent encoders do not each start one thread per core
+    if (job.threads >= 0) {
+        api->config_parse(config, "threads", std::to_string(job.threads).c_str());
+    }
+
+    // Split each picture into several slices: one per CTU row with WPP or one per tile
+    if (job.split == "wpp") {
+        api->config_parse(config, "wpp", "1");
+        api->config_parse(config, "slices", "wpp");
+    }
+    else if (job.split != "none") {
+        if (!api->config_parse(config, "tiles", job.split.c_str())) {
+            std::cerr << "Invalid tile split, expected <columns>x<rows>: " << job.split << std::endl;
+            outputFile.close();
+            cleanup_kvazaar(nullptr, api, enc, config);
+            return EXIT_FAILURE;
+        }
+        api->config_parse(config, "slices", "tiles");
+    }
+
     enc = api->encoder_open(config);
     kvz_picture* img_in = api->picture_alloc(width, height);
 
     if (!enc || !img_in) {
         std::cerr << "Failed to open kvazaar encoder!" << std::endl;
-        inputFile.close();
         outputFile.close();
-        memoryFile.close();
         cleanup_kvazaar(img_in, api, enc, config);
         return EXIT_FAILURE;
     }
 
-    int frame_count = 1;
-    bool input_has_been_read = false;
+    // The chunk index is written once all frames have been encoded
+    uint64_t offset = 0;
+    std::vector<chunk_index_frame> frames;
+    std::vector<chunk_index_nal> nals;
 
-    while (!input_has_been_read) {
+    // The YUV file is mapped, frames are copied from it directly into the kvazaar picture
+    size_t luma_size = (size_t)width * height;
+    size_t frame_size = luma_size + luma_size / 2;
+    size_t input_frames = job.yuv_len / frame_size;
 
-        if (!inputFile.read((char*)img_in->y, width * height) ||
-            !inputFile.read((char*)img_in->u, width * height/4) ||
-            !inputFile.read((char*)img_in->v, width * height/4)) {
+    for (size_t frame_count = 1; frame_count <= input_frames; ++frame_count) {
+        const uint8_t* yuv = job.yuv + (frame_count - 1) * frame_size;
 
-            if (inputFile.eof())
-            {
-                std::cout << "End of input file reached" << std::endl;
-            }
-            else if (inputFile.bad())
-            {
-                std::cerr << "Input bad" << std::endl;
-            }
-            else if (inputFile.fail())
-            {
-                std::cerr << "Input fails" << std::endl;
-            }
-            else
-            {
-                std::cerr << "Unknown Input error" << std::endl;
-            }
+        memcpy(img_in->y, yuv, luma_size);
+        memcpy(img_in->u, yuv + luma_size, luma_size / 4);
+        memcpy(img_in->v, yuv + luma_size + luma_size / 4, luma_size / 4);
 
-            input_has_been_read = true;
-            inputFile.close();
-            continue;
+        if (verbose) {
+            std::cout << "Start encoding frame " << frame_count << std::endl;
         }
-
-        std::cout << "Start encoding frame " << frame_count << std::endl;
-        ++frame_count;
+        img_in->pts = frame_count - 1;
 
         // feed input to kvazaar and write output to file
         int rvalue = EXIT_FAILURE;
-        if (!encode_frame(img_in, rvalue, outputFile, memoryFile, api, enc))
+        if (!encode_frame(img_in, rvalue, outputFile, api, enc, offset, frames, nals))
         {
             // if encoding fails
             outputFile.close();
-            memoryFile.close();
             cleanup_kvazaar(img_in, api, enc, config);
             return rvalue;
         }
     }
 
+    if (verbose) {
+        std::cout << "End of input file reached" << std::endl;
+    }
+
     // write the rest of the frames that are being encoded to file
     int rvalue = EXIT_FAILURE;
-    while (encode_frame(nullptr, rvalue, outputFile, memoryFile, api, enc));
+    while (encode_frame(nullptr, rvalue, outputFile, api, enc, offset, frames, nals));
 
-    memoryFile.close();
     outputFile.close();
     cleanup_kvazaar(img_in, api, enc, config);
+
+    if (verbose) {
+        std::cout << "Writing chunk index of " << frames.size() << " chunks and " << nals.size() << " NAL units: "
+            << job.memory_filename << std::endl;
+    }
+    if (rvalue == EXIT_SUCCESS && !write_chunk_index(job.memory_filename, frames, nals, false, job.fps, 1)) {
+        rvalue = EXIT_FAILURE;
+    }
     return rvalue;
 }
 
@@ -211,8 +377,8 @@ void cleanup_kvazaar(kvz_picture* input, const kvz_api* api, kvz_encoder* enc, k
     }
 }
 
-bool encode_frame(kvz_picture* input, int& rvalue, std::ofstream& outputFile, std::ofstream& memoryFile, 
-    const kvz_api* api, kvz_encoder* enc)
+bool encode_frame(kvz_picture* input, int& rvalue, std::ofstream& outputFile, const kvz_api* api, kvz_encoder* enc,
+    uint64_t& offset, std::vector<chunk_index_frame>& frames, std::vector<chunk_index_nal>& nals)
 {
     kvz_picture* img_rec = nullptr;
     kvz_picture* img_src = nullptr;
@@ -237,22 +403,25 @@ bool encode_frame(kvz_picture* input, int& rvalue, std::ofstream& outputFile, st
     }
 
     if (chunks_out != NULL) {
-        uint64_t written = 0;
-
-        // Calculate the total size of the chunks
+        // Collect the chunks of the frame so that its NAL units can be indexed
+        std::vector<uint8_t> frame;
         for (kvz_data_chunk* chunk = chunks_out; chunk != nullptr; chunk = chunk->next) {
-            written += chunk->len;
+            frame.insert(frame.end(), chunk->data, chunk->data + chunk->len);
         }
+        api->chunk_free(chunks_out);
 
-        std::cout << "Write the size of the chunk: " << written << std::endl;
-        memoryFile.write((char*)(&written), sizeof(uint64_t));
+        if (verbose) {
+            std::cout << "Write the size of the chunk: " << frame.size() << std::endl;
+        }
 
-        // write the chunks into the file
-        for (kvz_data_chunk* chunk = chunks_out; chunk != nullptr; chunk = chunk->next) {
+        index_chunk(frame.data(), offset, frame.size(), false, img_src ? img_src->pts : frames.size(), frames, nals);
+        offset += frame.size();
 
-            outputFile.write((char*)(chunk->data), chunk->len);
-        }
+        // write the chunks into the file
+        outputFile.write((char*)frame.data(), frame.size());
     }
+    api->picture_free(img_rec);
+    api->picture_free(img_src);
 
     return true;
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <iostream>
 #include <cstdio>
 #include <cstdlib>
@@ -15,8 +16,246 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+bool map_chunk_index(const std::string& filename, chunk_index& index)
+{
+    int fd = open(filename.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(chunk_index_header)) {
+        close(fd);
+        return false;
+    }
+
+    // Check the magic before mapping, version 1 indices are read with get_chunk_sizes()
+    char magic[sizeof(CHUNK_INDEX_MAGIC)];
+    if (pread(fd, magic, sizeof(magic), 0) != sizeof(magic) || memcmp(magic, CHUNK_INDEX_MAGIC, sizeof(magic))) {
+        close(fd);
+        return false;
+    }
+
+    size_t len = st.st_size;
+    void* mem = mmap(NULL, len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+
+    if (mem == MAP_FAILED) {
+        std::cerr << "Failed to map chunk index: " << filename << std::endl;
+        return false;
+    }
+
+    const chunk_index_header* header = (const chunk_index_header*)mem;
+    if (header->version != CHUNK_INDEX_VERSION ||
+        header->frames_offset + header->frame_count * sizeof(chunk_index_frame) > len ||
+        header->nals_offset + header->nal_count * sizeof(chunk_index_nal) > len)
+    {
+        std::cerr << "Invalid chunk index: " << filename << std::endl;
+        munmap(mem, len);
+        return false;
+    }
+
+    index.header = header;
+    index.frames = (const chunk_index_frame*)((const uint8_t*)mem + header->frames_offset);
+    index.nals   = (const chunk_index_nal*)((const uint8_t*)mem + header->nals_offset);
+    index.mem    = mem;
+    index.len    = len;
+    return true;
+}
+
+void unmap_chunk_index(chunk_index& index)
+{
+    if (index.mem) {
+        munmap(index.mem, index.len);
+    }
+    index = {};
+}
+
+// HEVC: forbidden_zero_bit, 6 bits of type. VVC: second byte, 5 bits of type
+static uint8_t get_nal_type(const uint8_t* nal, uint32_t size, bool vvc)
+{
+    if (vvc) {
+        return (size > 1) ? (nal[1] >> 3) & 0x1f : 0;
+    }
+    return (size > 0) ? (nal[0] >> 1) & 0x3f : 0;
+}
+
+// IRAP pictures are IDR, CRA and BLA in HEVC and IDR, CRA and GDR in VVC
+static bool is_irap(uint8_t type, bool vvc)
+{
+    return (!vvc && type >= 16 && type <= 23) || (vvc && type >= 7 && type <= 10);
+}
+
+void index_chunk(const uint8_t* chunk, uint64_t offset, uint64_t size, bool vvc, int64_t pts,
+    std::vector<chunk_index_frame>& frames, std::vector<chunk_index_nal>& nals)
+{
+    chunk_index_frame frame = {};
+    frame.offset    = offset;
+    frame.size      = size;
+    frame.pts       = pts;
+    frame.first_nal = (uint32_t)nals.size();
+
+    const uint8_t* end = chunk + size;
+    const uint8_t* sc  = find_start_code(chunk, end);
+
+    while (sc != end) {
+        chunk_index_nal nal = {};
+        nal.start_code_len = (sc[2] == 1) ? 3 : 4;
+
+        const uint8_t* start = sc + nal.start_code_len;
+        sc = find_start_code(start, end);
+
+        nal.offset = offset + (start - chunk);
+        nal.size   = (uint32_t)(sc - start);
+
+        nal.type = get_nal_type(start, nal.size, vvc);
+        if (nal.size > 0 && is_irap(nal.type, vvc)) {
+            frame.intra = 1;
+        }
+
+        nals.push_back(nal);
+        frame.nal_count++;
+    }
+    frames.push_back(frame);
+}
+
+// NAL unit types that start a new access unit when they follow the last VCL NAL unit of a picture
+static bool starts_access_unit(uint8_t type, bool vvc)
+{
+    if (vvc) {
+        // OPI, DCI, VPS, SPS, PPS, prefix APS, PH, AUD, prefix SEI, reserved 26 and unspecified 28-29
+        return (type >= 12 && type <= 17) || type == 19 || type == 20 || type == 23 || type == 26 ||
+            type == 28 || type == 29;
+    }
+    // VPS, SPS, PPS, AUD, prefix SEI, reserved 41-44 and unspecified 48-55
+    return (type >= 32 && type <= 35) || type == 39 || (type >= 41 && type <= 44) || (type >= 48 && type <= 55);
+}
+
+static void close_access_unit(std::vector<chunk_index_frame>& frames, std::vector<chunk_index_nal>& nals,
+    uint64_t end_nal, uint64_t end_offset, bool vvc)
+{
+    chunk_index_frame& frame = frames.back();
+    frame.size      = end_offset - frame.offset;
+    frame.nal_count = (uint32_t)(end_nal - frame.first_nal);
+
+    for (uint64_t i = frame.first_nal; i < end_nal; ++i) {
+        if (nals[i].size > 0 && is_irap(nals[i].type, vvc)) {
+            frame.intra = 1;
+        }
+    }
+}
+
+void index_access_units(const uint8_t* data, uint64_t size, bool vvc,
+    std::vector<chunk_index_frame>& frames, std::vector<chunk_index_nal>& nals)
+{
+    const uint8_t* end = data + size;
+    const uint8_t* sc  = find_start_code(data, end);
+
+    bool open    = false;          // An access unit has been started
+    bool has_vcl = false;          // The current access unit has a VCL NAL unit
+    uint64_t pending = UINT64_MAX; // First NAL unit after the last VCL NAL unit that may start the next access unit
+    int64_t pts = 0;
+
+    while (sc != end) {
+        chunk_index_nal nal = {};
+        nal.start_code_len = (sc[2] == 1) ? 3 : 4;
+
+        const uint8_t* start = sc + nal.start_code_len;
+        sc = find_start_code(start, end);
+
+        nal.offset = start - data;
+        nal.size   = (uint32_t)(sc - start);
+        nal.type   = get_nal_type(start, nal.size, vvc);
+
+        bool vcl = (nal.size > 0) && (vvc ? nal.type < 12 : nal.type < 32);
+
+        /* The first bit after the two byte NAL unit header is first_slice_segment_in_pic_flag in HEVC and
+         * sh_picture_header_in_slice_header_flag in VVC. In the latter case the picture has only one slice */
+        bool new_picture = (vcl && nal.size > 2 && (start[2] & 0x80)) || (vvc && nal.size > 0 && nal.type == 19);
+
+        if (!open) {
+            chunk_index_frame frame = {};
+            frame.offset    = nal.offset - nal.start_code_len;
+            frame.pts       = pts++;
+            frame.first_nal = (uint32_t)nals.size();
+            frames.push_back(frame);
+            open = true;
+        }
+        else if (new_picture && has_vcl) {
+            uint64_t first = (pending != UINT64_MAX) ? pending : nals.size();
+            uint64_t first_offset = (first < nals.size()) ?
+                nals[first].offset - nals[first].start_code_len : nal.offset - nal.start_code_len;
+
+            close_access_unit(frames, nals, first, first_offset, vvc);
+
+            chunk_index_frame frame = {};
+            frame.offset    = first_offset;
+            frame.pts       = pts++;
+            frame.first_nal = (uint32_t)first;
+            frames.push_back(frame);
+            has_vcl = false;
+            pending = UINT64_MAX;
+        }
+
+        if (vcl) {
+            has_vcl = true;
+            pending = UINT64_MAX;
+        }
+        else if (has_vcl && pending == UINT64_MAX && nal.size > 0 && starts_access_unit(nal.type, vvc)) {
+            pending = nals.size();
+        }
+
+        nals.push_back(nal);
+    }
+
+    if (open) {
+        close_access_unit(frames, nals, nals.size(), size, vvc);
+    }
+}
+
+bool write_chunk_index(const std::string& filename, const std::vector<chunk_index_frame>& frames,
+    const std::vector<chunk_index_nal>& nals, bool vvc, uint32_t fps_num, uint32_t fps_den)
+{
+    std::ofstream indexFile(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!indexFile.good()) {
+        std::cerr << "Failed to open chunk index for writing: " << filename << std::endl;
+        return false;
+    }
+
+    chunk_index_header header = {};
+    memcpy(header.magic, CHUNK_INDEX_MAGIC, sizeof(header.magic));
+    header.version       = CHUNK_INDEX_VERSION;
+    header.codec         = vvc ? CHUNK_INDEX_VVC : CHUNK_INDEX_HEVC;
+    header.frame_count   = frames.size();
+    header.nal_count     = nals.size();
+    header.frames_offset = sizeof(chunk_index_header);
+    header.nals_offset   = header.frames_offset + frames.size() * sizeof(chunk_index_frame);
+    header.fps_num       = fps_num;
+    header.fps_den       = fps_den;
+
+    indexFile.write((const char*)&header, sizeof(header));
+    indexFile.write((const char*)frames.data(), frames.size() * sizeof(chunk_index_frame));
+    indexFile.write((const char*)nals.data(), nals.size() * sizeof(chunk_index_nal));
+    indexFile.close();
+
+    return indexFile.good();
+}
+
 void get_chunk_sizes(std::string filename, std::vector<uint64_t>& chunk_sizes)
 {
+    chunk_index index;
+    if (map_chunk_index(filename, index)) {
+        for (uint64_t i = 0; i < index.header->frame_count; ++i) {
+            chunk_sizes.push_back(index.frames[i].size);
+        }
+        unmap_chunk_index(index);
+        return;
+    }
+
     std::ifstream inputFile(filename, std::ios::in | std::ios::binary);
 
     if (!inputFile.good())
@@ -53,6 +292,47 @@ void get_chunk_sizes(std::string filename, std::vector<uint64_t>& chunk_sizes)
     inputFile.close();
 }
 
+void get_nal_table(uint8_t* mem, size_t len, std::string input_file, std::vector<std::pair<size_t, uint8_t*>>& nals)
+{
+    chunk_index index;
+    if (map_chunk_index(get_chunk_filename(input_file), index)) {
+        const chunk_index_nal* last = index.header->nal_count ? &index.nals[index.header->nal_count - 1] : nullptr;
+
+        // an index of some other file would point outside of this one
+        if (last && last->offset + last->size <= len) {
+            nals.reserve(index.header->nal_count);
+            for (uint64_t i = 0; i < index.header->nal_count; ++i) {
+                nals.emplace_back(index.nals[i].size, mem + index.nals[i].offset);
+            }
+            unmap_chunk_index(index);
+            return;
+        }
+        unmap_chunk_index(index);
+    }
+
+    scan_nal_units(mem, len, nals);
+}
+
+void scan_nal_units(uint8_t* mem, size_t len, std::vector<std::pair<size_t, uint8_t*>>& nals)
+{
+    uint8_t* end = mem + len;
+    uint8_t* p = (uint8_t*)find_start_code(mem, end);
+
+    while (p < end) {
+        // skip the zeros and the one of the start code
+        while (p < end && !*p) {
+            ++p;
+        }
+        if (p == end || ++p == end) {
+            break;
+        }
+
+        uint8_t* next = (uint8_t*)find_start_code(p, end);
+        nals.emplace_back(next - p, p);
+        p = next;
+    }
+}
+
 std::string get_chunk_filename(std::string& encoded_filename)
 {
     std::string mem_file = "";
@@ -98,26 +378,238 @@ void *get_mem(std::string filename, size_t& len)
     return mem;
 }
 
+/* Start code scanners. Each returns a pointer to the first 0x00 0x00 0x01 sequence in [p, end)
+ * or end if there is none. The vectorized versions compare a whole register against 0 and 1 and
+ * combine the masks so that bit i is set only if bytes i, i + 1 and i + 2 form a start code.
+ * The last two bytes of a register cannot be checked, so the scan advances by the register width - 2 */
+static const uint8_t *scan_start_code_scalar(const uint8_t *p, const uint8_t *end)
+{
+    // Word-at-a-time search, as in FFmpeg's ff_avc_find_startcode_internal()
+    const uint8_t *a = p + 4 - ((intptr_t)p & 3);
+
+    for (end -= 3; p < a && p < end; p++) {
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    }
+
+    for (end -= 3; p < end; p += 4) {
+        uint32_t x;
+        memcpy(&x, p, sizeof(x));
+        if ((x - 0x01010101) & (~x) & 0x80808080) { // generic
+            if (p[1] == 0) {
+                if (p[0] == 0 && p[2] == 1)
+                    return p;
+                if (p[2] == 0 && p[3] == 1)
+                    return p+1;
+            }
+            if (p[3] == 0) {
+                if (p[2] == 0 && p[4] == 1)
+                    return p+2;
+                if (p[4] == 0 && p[5] == 1)
+                    return p+3;
+            }
+        }
+    }
+
+    // Unlike in FFmpeg, the input is not padded so a start code may end at the last byte
+    for (end += 3; p <= end; p++) {
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    }
+
+    return end + 3;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static const uint8_t *scan_start_code_sse2(const uint8_t *p, const uint8_t *end)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi8(1);
+
+    for (; end - p >= 16; p += 14) {
+        __m128i v  = _mm_loadu_si128((const __m128i *)p);
+        uint32_t z = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+        uint32_t o = _mm_movemask_epi8(_mm_cmpeq_epi8(v, one));
+        uint32_t m = z & (z >> 1) & (o >> 2);
+
+        if (m)
+            return p + __builtin_ctz(m);
+    }
+    return scan_start_code_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const uint8_t *scan_start_code_avx2(const uint8_t *p, const uint8_t *end)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one  = _mm256_set1_epi8(1);
+
+    for (; end - p >= 32; p += 30) {
+        __m256i v  = _mm256_loadu_si256((const __m256i *)p);
+        uint32_t z = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+        uint32_t o = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, one));
+        uint32_t m = z & (z >> 1) & (o >> 2);
+
+        if (m)
+            return p + __builtin_ctz(m);
+    }
+    return scan_start_code_sse2(p, end);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static const uint8_t *scan_start_code_avx512(const uint8_t *p, const uint8_t *end)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one  = _mm512_set1_epi8(1);
+
+    for (; end - p >= 64; p += 62) {
+        __m512i v  = _mm512_loadu_si512((const void *)p);
+        uint64_t z = _mm512_cmpeq_epi8_mask(v, zero);
+        uint64_t o = _mm512_cmpeq_epi8_mask(v, one);
+        uint64_t m = z & (z >> 1) & (o >> 2);
+
+        if (m)
+            return p + __builtin_ctzll(m);
+    }
+    return scan_start_code_avx2(p, end);
+}
+#endif
+
+start_code_scanner get_start_code_scanner(START_CODE_SCANNER type)
+{
+    switch (type) {
+        case SCANNER_SCALAR:
+            return scan_start_code_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+        case SCANNER_SSE2:
+            return __builtin_cpu_supports("sse2") ? scan_start_code_sse2 : nullptr;
+        case SCANNER_AVX2:
+            return __builtin_cpu_supports("avx2") ? scan_start_code_avx2 : nullptr;
+        case SCANNER_AVX512:
+            return (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) ?
+                scan_start_code_avx512 : nullptr;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+static start_code_scanner select_start_code_scanner()
+{
+    const START_CODE_SCANNER types[] = { SCANNER_AVX512, SCANNER_AVX2, SCANNER_SSE2, SCANNER_SCALAR };
+
+    for (auto type : types) {
+        if (start_code_scanner scanner = get_start_code_scanner(type))
+            return scanner;
+    }
+    return scan_start_code_scalar;
+}
+
+const uint8_t *find_start_code(const uint8_t *p, const uint8_t *end)
+{
+    // The fastest scanner supported by the CPU is selected on first use
+    static const start_code_scanner scanner = select_start_code_scanner();
+
+    const uint8_t *out = (end - p >= 3) ? scanner(p, end) : end;
+    if (p < out && out < end && !out[-1]) out--;
+    return out;
+}
+
 int get_next_frame_start(uint8_t *data, uint32_t offset, uint32_t data_len, uint8_t& start_len)
 {
-    uint8_t zeros = 0;
-    uint32_t pos  = 0;
+    const uint8_t *end = data + data_len;
+    const uint8_t *sc  = find_start_code(data + offset, end);
+
+    if (sc == end)
+        return -1;
+
+    // Count every zero byte before the 0x01 (not only the two or three of the start code)
+    const uint8_t *one = sc;
+    while (*one == 0)
+        one++;
+
+    const uint8_t *first = sc;
+    while (first > data + offset && first[-1] == 0)
+        first--;
+
+    start_len = (uint8_t)(one - first + 1);
+    return (int)(one - data) + 1;
+}
+
+bool get_send_schedule(const std::string& pacing, std::string input_file, size_t frames,
+    std::vector<uint64_t>& schedule)
+{
+    size_t first = pacing.find('@');
+    size_t second = (first == std::string::npos) ? std::string::npos : pacing.find('@', first + 1);
+
+    double fps = atof(pacing.substr(0, first).c_str());
+    std::string trace = (first == std::string::npos) ? "" : pacing.substr(first + 1, second - first - 1);
+    double speed = (second == std::string::npos) ? 1 : atof(pacing.substr(second + 1).c_str());
+
+    if (fps <= 0 || speed <= 0) {
+        std::cerr << "Invalid pacing, expected <fps>[@<trace file|index>[@<speed>]]: " << pacing << std::endl;
+        return false;
+    }
 
-    while (offset + pos < data_len) {
-        if (zeros >= 2 && data[offset + pos] == 1) {
-            start_len = zeros + 1;
-            return offset + pos + 1;
+    // Frame times in seconds from the trace
+    std::vector<double> times;
+
+    if (trace == "index") {
+        chunk_index index;
+        if (!map_chunk_index(get_chunk_filename(input_file), index)) {
+            std::cerr << "Pacing from the index requires a version 2 chunk index" << std::endl;
+            return false;
         }
 
-        if (data[offset + pos] == 0)
-            zeros++;
-        else
-            zeros = 0;
+        // without a frame rate in the index, timestamps are in frames of the given fps
+        double timescale = index.header->fps_num ? (double)index.header->fps_den / index.header->fps_num : 1 / fps;
+        for (uint64_t i = 0; i < index.header->frame_count; ++i) {
+            times.push_back((index.frames[i].pts - index.frames[0].pts) * timescale);
+        }
+        unmap_chunk_index(index);
+    }
+    else if (!trace.empty()) {
+        std::ifstream trace_file(trace);
+        if (!trace_file.good()) {
+            std::cerr << "Failed to open trace file: " << trace << std::endl;
+            return false;
+        }
 
-        pos++;
+        std::string line;
+        while (std::getline(trace_file, line)) {
+            if (!line.empty() && line[0] != '#') {
+                times.push_back(atof(line.c_str()));
+            }
+        }
+
+        for (size_t i = 1; i < times.size(); ++i) {
+            times[i] -= times[0];
+        }
+        if (!times.empty()) {
+            times[0] = 0;
+        }
     }
 
-    return -1;
+    if (trace.empty() || times.size() < 2) {
+        if (!trace.empty()) {
+            std::cerr << "The trace has less than two frames, using " << fps << " fps" << std::endl;
+        }
+        times = { 0, 1 / fps };
+    }
+
+    /* Repeat the trace until all frames have a time. The gap between repetitions is the average frame interval.
+     * Reordered timestamps are clamped, frames are always sent in file order */
+    double cycle = times.back() + times.back() / (times.size() - 1);
+    uint64_t last = 0;
+
+    schedule.clear();
+    for (size_t i = 0; i < frames; ++i) {
+        double t = (i / times.size()) * cycle + times[i % times.size()];
+        last = std::max(last, (uint64_t)(t * 1000000 / speed));
+        schedule.push_back(last);
+    }
+    return true;
 }
 
 void write_send_results_to_file(const std::string& filename, 
@@ -1,16 +1,128 @@
 #pragma once
 
 #include <string>
+#include <utility>
 #include <vector>
+#include <cstdint>
 
+/* Chunk index, stored in the .m<ext> file next to the test file.
+ * Version 1 is a plain sequence of uint64_t chunk sizes. Version 2 starts with a chunk_index_header
+ * followed by the frame and NAL unit tables, so it can be memory mapped and used without any parsing.
+ * All fields are little endian */
+constexpr char CHUNK_INDEX_MAGIC[8] = { 'R', 'T', 'P', 'C', 'H', 'I', 'D', 'X' };
+constexpr uint32_t CHUNK_INDEX_VERSION = 2;
+
+enum CHUNK_INDEX_CODEC {
+    CHUNK_INDEX_HEVC = 0,
+    CHUNK_INDEX_VVC  = 1
+};
+
+struct chunk_index_header {
+    char magic[8];          // CHUNK_INDEX_MAGIC
+    uint32_t version;       // CHUNK_INDEX_VERSION
+    uint32_t codec;         // CHUNK_INDEX_CODEC
+    uint64_t frame_count;
+    uint64_t nal_count;
+    uint64_t frames_offset; // Offset of the chunk_index_frame table from the start of the index file
+    uint64_t nals_offset;   // Offset of the chunk_index_nal table from the start of the index file
+    uint32_t fps_num;       // Presentation timestamps are in units of fps_den / fps_num seconds
+    uint32_t fps_den;
+    uint64_t reserved;
+};
+
+struct chunk_index_frame {
+    uint64_t offset;        // Offset of the chunk in the test file, including the first start code
+    uint64_t size;          // Size of the chunk, the same as in version 1
+    int64_t pts;
+    uint32_t first_nal;     // Index of the first NAL unit of the chunk in the NAL unit table
+    uint32_t nal_count;
+    uint8_t intra;          // 1 if the chunk contains an IRAP picture
+    uint8_t reserved[7];
+};
+
+struct chunk_index_nal {
+    uint64_t offset;        // Offset of the NAL unit header in the test file, i.e. after the start code
+    uint32_t size;          // Size of the NAL unit without the start code
+    uint8_t type;           // nal_unit_type
+    uint8_t start_code_len; // 3 or 4
+    uint16_t reserved;
+};
+
+static_assert(sizeof(chunk_index_header) == 64, "chunk_index_header must be 64 bytes");
+static_assert(sizeof(chunk_index_frame) == 40, "chunk_index_frame must be 40 bytes");
+static_assert(sizeof(chunk_index_nal) == 16, "chunk_index_nal must be 16 bytes");
+
+// A memory mapped version 2 chunk index
+struct chunk_index {
+    const chunk_index_header* header = nullptr;
+    const chunk_index_frame* frames = nullptr;
+    const chunk_index_nal* nals = nullptr;
+    void* mem = nullptr;
+    size_t len = 0;
+};
+
+/* Map a version 2 chunk index. Returns false without printing anything if the file is a version 1 index,
+ * so that the caller can fall back to get_chunk_sizes() */
+bool map_chunk_index(const std::string& filename, chunk_index& index);
+void unmap_chunk_index(chunk_index& index);
+
+// Append a chunk of size bytes, located at offset in the test file, and its NAL units to the index tables
+void index_chunk(const uint8_t* chunk, uint64_t offset, uint64_t size, bool vvc, int64_t pts,
+    std::vector<chunk_index_frame>& frames, std::vector<chunk_index_nal>& nals);
+
+/* Split a whole Annex-B stream of size bytes into access units and append them to the index tables.
+ * A new access unit starts from the first VCL NAL unit of a picture (first_slice_segment_in_pic_flag in HEVC,
+ * picture header NAL unit or picture header in slice header in VVC), or from the AUD, parameter set or
+ * prefix SEI NAL unit preceding it. Presentation timestamps are the access unit numbers in decoding order */
+void index_access_units(const uint8_t* data, uint64_t size, bool vvc,
+    std::vector<chunk_index_frame>& frames, std::vector<chunk_index_nal>& nals);
+
+bool write_chunk_index(const std::string& filename, const std::vector<chunk_index_frame>& frames,
+    const std::vector<chunk_index_nal>& nals, bool vvc, uint32_t fps_num, uint32_t fps_den);
+
+// Read the chunk sizes from either version of the chunk index
 void get_chunk_sizes(std::string filename, std::vector<uint64_t>& chunk_sizes);
 
 std::string get_chunk_filename(std::string& input_filename);
 
+/* NAL units of the whole test file in mem as (size, pointer) pairs, without start codes. They are taken from
+ * the version 2 chunk index of input_file if there is one, otherwise the file is scanned once. This way
+ * senders do not have to look for start codes while sending */
+void get_nal_table(uint8_t* mem, size_t len, std::string input_file, std::vector<std::pair<size_t, uint8_t*>>& nals);
+
+// Append the NAL units found in the len bytes at mem to nals with one pass of the start code scanner
+void scan_nal_units(uint8_t* mem, size_t len, std::vector<std::pair<size_t, uint8_t*>>& nals);
+
 void* get_mem(std::string encoded_filename, size_t& len);
 
 int get_next_frame_start(uint8_t* data, uint32_t offset, uint32_t data_len, uint8_t& start_len);
 
+// Start code scanner implementations. Unsupported ones are not returned by get_start_code_scanner()
+enum START_CODE_SCANNER {
+    SCANNER_SCALAR = 0,
+    SCANNER_SSE2   = 1,
+    SCANNER_AVX2   = 2,
+    SCANNER_AVX512 = 3
+};
+
+// Returns a pointer to the first 0x00 0x00 0x01 in [p, end) or end if there is none
+typedef const uint8_t *(*start_code_scanner)(const uint8_t *p, const uint8_t *end);
+
+start_code_scanner get_start_code_scanner(START_CODE_SCANNER type);
+
+/* Find the next Annex B start code in [p, end) with the fastest scanner the CPU supports.
+ * The returned pointer includes the leading zero of a four byte start code. Returns end if not found */
+const uint8_t *find_start_code(const uint8_t *p, const uint8_t *end);
+
+/* Send time of each frame in microseconds from the start of sending. The pacing argument is
+ * <fps>[@<trace>[@<speed>]]. Without a trace, frames are sent at a constant fps. The trace is either
+ * "index" for the presentation timestamps of the version 2 chunk index of input_file, or a text file
+ * with the capture time of one frame per line in seconds (e.g. frame.time_relative from a pcap).
+ * A trace shorter than the file is repeated. Speed scales the timestamps, 2 plays the trace twice as fast.
+ * Returns false if the trace cannot be read */
+bool get_send_schedule(const std::string& pacing, std::string input_file, size_t frames,
+    std::vector<uint64_t>& schedule);
+
 void write_send_results_to_file(const std::string& filename, 
     const size_t bytes, const uint64_t diff);
 
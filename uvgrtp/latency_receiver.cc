@@ -8,6 +8,7 @@
 #include <cstring>
 #include <algorithm>
 #include <chrono>
+#include <climits>
 
 bool frame_received = true;
 int total_frames_received = 0;
@@ -19,13 +20,13 @@ size_t n_non_vcl = 0;
 
 void hook_receiver(void* arg, uvg_rtp::frame::rtp_frame* frame)
 {
-    // send the frame immediately back
+    // send the frame immediately back, with its RTP timestamp so that the sender can tell which frame it belongs to
     uvgrtp::media_stream* receive = (uvgrtp::media_stream*)arg;
     int flags = 0;
     if(atlas_enabled) {
         flags = RTP_NO_H26X_SCL;
     }
-    if((receive->push_frame(frame->payload, frame->payload_len, flags)) != RTP_OK) {
+    if((receive->push_frame(frame->payload, frame->payload_len, frame->header.timestamp, flags)) != RTP_OK) {
         std::cout << "Error sending frame" << std::endl;
     }
     frame_received = true;
@@ -43,10 +44,14 @@ void hook_receiver(void* arg, uvg_rtp::frame::rtp_frame* frame)
         }
 }
 
+/* By default the test ends after EXPECTED_FRAMES NAL units or 250 ms without any. With a timeout, NAL units are
+ * echoed until nothing has been received for that long, for senders like the live sender that have a different
+ * number of NAL units and may take a while to start */
 int receiver(std::string local_address, int local_port, std::string remote_address, int remote_port,
-    bool vvc_enabled, bool srtp_enabled, bool atlas)
+    bool vvc_enabled, bool srtp_enabled, bool atlas, int timeout)
 {
-    int timout = 250;
+    int timout = timeout ? timeout : 250;
+    int expected_frames = timeout ? INT_MAX : EXPECTED_FRAMES;
     uvgrtp::context rtp_ctx;
     uvgrtp::session* session = nullptr;
     uvgrtp::media_stream* receive = nullptr;
@@ -57,13 +62,13 @@ int receiver(std::string local_address, int local_port, std::string remote_addre
     // the receiving end is not measured in latency tests
     receive->install_receive_hook(receive, hook_receiver);
     
-    while (frame_received && total_frames_received < EXPECTED_FRAMES)
+    while (frame_received && total_frames_received < expected_frames)
     {
         frame_received = false;
         std::this_thread::sleep_for(std::chrono::milliseconds(timout));
     }
 
-    if (total_frames_received < EXPECTED_FRAMES)
+    if (total_frames_received < expected_frames)
     {
         std::cout << "Received " << total_frames_received << " frames. No more frames received for "
             << timout << " ms." << std::endl;
@@ -76,9 +81,9 @@ int receiver(std::string local_address, int local_port, std::string remote_addre
 
 int main(int argc, char **argv)
 {
-    if (argc != 7) {
+    if (argc != 7 && argc != 8) {
         fprintf(stderr, "usage: ./%s <local address> <local port> <remote address> <remote port> \
-            <format> <srtp>\n", __FILE__);
+            <format> <srtp> [inactivity timeout ms]\n", __FILE__);
         return EXIT_FAILURE;
     }
 
@@ -89,6 +94,8 @@ int main(int argc, char **argv)
     bool vvc_enabled = get_vvc_state(argv[5]);
     atlas_enabled = get_atlas_state(argv[5]);
     bool srtp_enabled = get_srtp_state(argv[6]);
+    int timeout = (argc == 8) ? atoi(argv[7]) : 0;
 
-    return receiver(local_address, local_port, remote_address, remote_port, vvc_enabled, srtp_enabled, atlas_enabled);
+    return receiver(local_address, local_port, remote_address, remote_port, vvc_enabled, srtp_enabled, atlas_enabled,
+        timeout);
 }
@@ -10,6 +10,9 @@
 #include <string>
 #include <chrono>
 #include <vector>
+#include <atomic>
+#include <fstream>
+#include <mutex>
 
 std::chrono::high_resolution_clock::time_point frame_send_time;
 
@@ -38,6 +41,90 @@ bool vvc_headers = false;
 int total_frames_received = 0;
 bool atlas_enabled = false;
 
+/* With a version 2 chunk index, a frame is complete once all of its VCL NAL units (slices) have
+ * been echoed back. This gives the frame latency regardless of how many NAL units a frame has.
+ * The echo receiver sends the NAL units back in order. In the scan mode their RTP timestamps come from uvgRTP,
+ * so an echoed slice is matched to the sent slices by order and size. A sent slice whose size does not match the next echoed
+ * one was lost, and its frame is not complete. Slices of a frame that arrive after the next frame has
+ * been sent still count towards their own frame */
+struct frame_state {
+    std::chrono::high_resolution_clock::time_point sent;
+    uint64_t latency = 0;       // microseconds from sending the frame to receiving its last slice
+    uint32_t vcl_expected = 0;
+    uint32_t vcl_received = 0;
+    bool lost = false;
+    bool complete = false;
+};
+
+struct vcl_nal {
+    uint32_t size;  // without the start code
+    uint32_t frame;
+};
+
+// Shared between the sending thread and the receive hook
+std::mutex frame_mutex;
+std::vector<frame_state> frame_table = {};
+std::vector<vcl_nal> vcl_nals = {};     // VCL NAL units of the file in sending order
+size_t vcl_sent = 0;                    // number of VCL NAL units sent so far
+size_t next_vcl = 0;                    // the first sent VCL NAL unit that has not been echoed or lost
+
+bool is_vcl(uint8_t nal_type)
+{
+    return vvc_headers ? nal_type < 12 : nal_type < 32;
+}
+
+// Offset of the NAL unit header in a received NAL unit, after the 3 or 4 byte start code if there is one
+static size_t nal_header_offset(const uint8_t* payload, size_t len)
+{
+    size_t zeros = 0;
+    while (zeros < len && zeros < 3 && payload[zeros] == 0) {
+        ++zeros;
+    }
+    return (zeros >= 2 && zeros < len && payload[zeros] == 1) ? zeros + 1 : 0;
+}
+
+static void build_frame_table(const chunk_index& index)
+{
+    frame_table.resize(index.header->frame_count);
+
+    for (uint32_t f = 0; f < index.header->frame_count; ++f) {
+        for (uint32_t n = 0; n < index.frames[f].nal_count; ++n) {
+            const chunk_index_nal& nal = index.nals[index.frames[f].first_nal + n];
+
+            if (is_vcl(nal.type)) {
+                vcl_nals.push_back({ nal.size, f });
+                frame_table[f].vcl_expected++;
+            }
+        }
+    }
+}
+
+static void match_vcl_nal(uint32_t size)
+{
+    std::lock_guard<std::mutex> lock(frame_mutex);
+
+    // only slices that have been sent can come back
+    size_t n = next_vcl;
+    while (n < vcl_sent && vcl_nals[n].size != size) {
+        ++n;
+    }
+    if (n == vcl_sent) {
+        return;
+    }
+
+    for (; next_vcl < n; ++next_vcl) {
+        frame_table[vcl_nals[next_vcl].frame].lost = true;
+    }
+    ++next_vcl;
+
+    frame_state& frame = frame_table[vcl_nals[n].frame];
+    if (++frame.vcl_received == frame.vcl_expected && !frame.lost) {
+        frame.latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - frame.sent).count();
+        frame.complete = true;
+    }
+}
+
 uint64_t get_diff()
 {
     return std::chrono::duration_cast<std::chrono::microseconds>(
@@ -118,12 +205,60 @@ static void hook_sender(void *arg, uvg_rtp::frame::rtp_frame *frame)
                 //std::cout << "Non-VCL HEVC NAL unit received" << std::endl;
             }
         }
+
+        size_t hdr = nal_header_offset(frame->payload, frame->payload_len);
+
+        if (!atlas_enabled && frame->payload_len > hdr + 2) {
+            uint8_t nal_type = vvc_headers ? (frame->payload[hdr + 1] >> 3) & 0x1f : (frame->payload[hdr] >> 1) & 0x3f;
+
+            if (is_vcl(nal_type)) {
+                match_vcl_nal((uint32_t)(frame->payload_len - hdr));
+            }
+        }
         ++total_frames_received;
     }
 }
 
+/* <scan|index>;<NAL units per frame>;<VCL NAL units per frame>;<frames sent>;<frames complete>;<avg ms>;<max ms>
+ * into latency_results_nals, for comparing the latency of files with a different number of slices per frame */
+static void write_nal_latency_results(bool nal_index, const chunk_index& index, uint64_t frames_sent)
+{
+    uint64_t vcl_nals = 0;
+    for (uint64_t i = 0; i < index.header->nal_count; ++i) {
+        vcl_nals += is_vcl(index.nals[i].type);
+    }
+
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    uint64_t complete = 0;
+    {
+        std::lock_guard<std::mutex> lock(frame_mutex);
+
+        for (auto& frame : frame_table) {
+            if (frame.complete) {
+                sum += frame.latency;
+                max = std::max(max, frame.latency);
+                complete++;
+            }
+        }
+    }
+
+    double frame_count = (double)index.header->frame_count;
+    double avg = complete ? sum / 1000.0 / complete : 0;
+
+    std::ofstream result_file("latency_results_nals", std::ios::out | std::ios::app | std::ios::ate);
+    result_file << (nal_index ? "index" : "scan") << ";" << index.header->nal_count / frame_count << ";"
+        << vcl_nals / frame_count << ";" << frames_sent << ";" << complete << ";" << avg << ";"
+        << max / 1000.0 << std::endl;
+    result_file.close();
+
+    std::cout << complete << "/" << frames_sent << " frames complete with "
+        << vcl_nals / frame_count << " slices per frame, avg " << avg << " ms, max " << max / 1000.0 << " ms" << std::endl;
+}
+
 static int sender(std::string input_file, std::string local_address, int local_port, 
-    std::string remote_address, int remote_port, float fps, bool vvc_enabled, bool srtp_enabled, bool atlas)
+    std::string remote_address, int remote_port, float fps, bool vvc_enabled, bool srtp_enabled, bool atlas,
+    bool nal_index, std::string pacing)
 {
     vvc_headers = vvc_enabled;
 
@@ -140,6 +275,8 @@ static int sender(std::string input_file, std::string local_address, int local_p
     void* mem = get_mem(input_file, len);
     std::vector<uint64_t> chunk_sizes; // For HEVC/VVC
     v3c_file_map mmap; // For Atlas
+    chunk_index index; // For sending NAL units from the index and the frame latencies
+    std::vector<uint64_t> schedule; // Send time of each chunk
 
     if(atlas_enabled) {
         mmap_v3c_file((char*)mem, len, mmap);
@@ -151,6 +288,18 @@ static int sender(std::string input_file, std::string local_address, int local_p
             return EXIT_FAILURE;
         }
         std::cout << "Starting latency send test with " << chunk_sizes.size() << " chunks" << std::endl;
+
+        if (!get_send_schedule(pacing, input_file, chunk_sizes.size(), schedule)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!map_chunk_index(get_chunk_filename(input_file), index) && nal_index) {
+            std::cerr << "Sending NAL units from the index requires a version 2 chunk index" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (index.mem) {
+            build_frame_table(index);
+        }
     }
     if (mem == nullptr)
     {
@@ -207,11 +356,31 @@ static int sender(std::string input_file, std::string local_address, int local_p
     else {
         for (auto& chunk_size : chunk_sizes)
         {
+            const chunk_index_frame* frame = index.mem ? &index.frames[current_frame] : nullptr;
+
             // record send time
             frame_send_time = std::chrono::high_resolution_clock::now();
-            if ((ret = send->push_frame((uint8_t*)mem + offset, chunk_size, 0)) != RTP_OK) {
+            if (frame) {
+                std::lock_guard<std::mutex> lock(frame_mutex);
+                frame_table[current_frame].sent = frame_send_time;
+                vcl_sent += frame_table[current_frame].vcl_expected;
+            }
+            if (nal_index) {
+                // push each NAL unit separately, all with the timestamp of the frame
+                uint32_t ts = (uint32_t)(schedule[current_frame] * 90 / 1000);
+                for (uint32_t n = 0; n < frame->nal_count && ret == RTP_OK; ++n) {
+                    const chunk_index_nal& nal = index.nals[frame->first_nal + n];
+                    ret = send->push_frame((uint8_t*)mem + nal.offset, nal.size, ts, RTP_NO_H26X_SCL);
+                }
+            }
+            else {
+                ret = send->push_frame((uint8_t*)mem + offset, chunk_size, 0);
+            }
+
+            if (ret != RTP_OK) {
                 fprintf(stderr, "push_frame() failed!\n");
                 cleanup_uvgrtp(rtp_ctx, session, send);
+                unmap_chunk_index(index);
                 return EXIT_FAILURE;
             }
 
@@ -222,8 +391,8 @@ static int sender(std::string input_file, std::string local_address, int local_p
             auto runtime = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
                 std::chrono::high_resolution_clock::now() - start).count();
 
-            if (runtime < current_frame * period)
-                std::this_thread::sleep_for(std::chrono::microseconds(current_frame * period - runtime));
+            if (current_frame < schedule.size() && runtime < schedule[current_frame])
+                std::this_thread::sleep_for(std::chrono::microseconds(schedule[current_frame] - runtime));
         }
     }
     
@@ -243,6 +412,11 @@ static int sender(std::string input_file, std::string local_address, int local_p
     write_latency_results_to_file("latency_results", frames, total_intra / (float)nintras, total_inter / (float)ninters,
         total / (float)frames);
 
+    if (index.mem) {
+        write_nal_latency_results(nal_index, index, current_frame);
+        unmap_chunk_index(index);
+    }
+
     std::cout << "Ending latency send test with " << total_frames_received << " frames received" << std::endl;
 
     return EXIT_SUCCESS;
@@ -250,8 +424,8 @@ static int sender(std::string input_file, std::string local_address, int local_p
 
 int main(int argc, char **argv)
 {
-    if (argc != 9) {
-        fprintf(stderr, "usage: ./%s <input file> <local address> <local port> <remote address> <remote port> <fps> <format> <srtp> \n", __FILE__);
+    if (argc != 9 && argc != 10) {
+        fprintf(stderr, "usage: ./%s <input file> <local address> <local port> <remote address> <remote port> <fps>[@<trace file|index>[@<speed>]] <format> <srtp> [scan|index]\n", __FILE__);
         return EXIT_FAILURE;
     }
 
@@ -266,6 +440,8 @@ int main(int argc, char **argv)
     bool vvc_enabled           = get_vvc_state(argv[7]);
     atlas_enabled              = get_atlas_state(argv[7]);
     bool srtp_enabled          = get_srtp_state(argv[8]);
+    bool nal_index             = (argc == 10 && std::string(argv[9]) == "index");
 
-    return sender(input_file, local_address, local_port, remote_address, remote_port, fps, vvc_enabled, srtp_enabled, atlas_enabled);
+    return sender(input_file, local_address, local_port, remote_address, remote_port, fps, vvc_enabled, srtp_enabled,
+        atlas_enabled, nal_index, argv[6]);
 }
\ No newline at end of file
@@ -0,0 +1,324 @@
+#include <kvazaar.h>
+
+#include "uvgrtp_util.hh"
+#include "../util/util.hh"
+#include "../util/spsc_queue.hh"
+
+#include <uvgrtp/lib.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Live encode-and-send latency test. Raw frames are taken from a YUV file at the given framerate as if they
+ * were captured from a camera, encoded with kvazaar and handed to the RTP sender thread through a lock-free
+ * queue. The uvgRTP latency receiver echoes every NAL unit back with its RTP timestamp, and a frame is
+ * complete once all of its NAL units have returned. Per frame, the time is split into encoding, waiting in
+ * the queue, packetization and sending, and the network round trip */
+
+constexpr size_t QUEUE_SIZE = 64;
+
+// How long to wait for the echoes of the last frames after everything has been sent
+constexpr int RECEIVE_TIMEOUT_MS = 1000;
+
+/* One frame of the input file on its way from capture to the RTP sender and back. The table of frames is
+ * allocated before the test and indexed by pts. A frame is sent with the RTP timestamp pts * rtp_ts_step,
+ * so the receive hook finds the frame of an echoed NAL unit from its timestamp */
+struct live_frame {
+    int64_t pts = 0;
+    bool intra = false;
+    long long capture = 0;   // All times are get_current_time() in us
+    long long encoded = 0;
+    long long dequeued = 0;
+    long long sent = 0;
+    long long complete = 0;
+    uint32_t nal_count = 0;
+    uint32_t echoed_nals = 0;            // Owned by the receive hook
+    std::atomic<bool> in_flight{false};  // Set by the RTP sender thread before the first NAL unit is sent
+    std::vector<uint8_t> data;
+};
+
+std::vector<live_frame> frame_table;
+uint32_t rtp_ts_step = 1;
+
+// Encoder -> RTP sender
+spsc_queue<live_frame*> encoded_frames(QUEUE_SIZE);
+
+std::atomic<bool> encoding_done(false);
+std::atomic<size_t> frames_sent(0);
+std::atomic<size_t> frames_complete(0);
+
+void hook_sender(void* arg, uvg_rtp::frame::rtp_frame* frame)
+{
+    (void)arg;
+
+    if (!frame) {
+        return;
+    }
+
+    // echoes of lost or unknown frames do not affect the other frames
+    size_t pts = frame->header.timestamp / rtp_ts_step;
+
+    if (pts < frame_table.size() && frame_table[pts].in_flight.load(std::memory_order_acquire)) {
+        live_frame& sent = frame_table[pts];
+
+        if (++sent.echoed_nals == sent.nal_count) {
+            sent.complete = get_current_time();
+            ++frames_complete;
+        }
+    }
+    (void)uvg_rtp::frame::dealloc_frame(frame);
+}
+
+void rtp_sender_thread(uvgrtp::media_stream* send)
+{
+    live_frame* frame = nullptr;
+
+    while (true) {
+        if (!encoded_frames.try_pop(frame)) {
+            if (encoding_done && encoded_frames.empty()) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        frame->dequeued = get_current_time();
+
+        // The hook must know about the frame before its first NAL unit can be echoed back
+        frame->in_flight.store(true, std::memory_order_release);
+
+        if (send->push_frame(frame->data.data(), frame->data.size(), (uint32_t)(frame->pts * rtp_ts_step), 0) != RTP_OK) {
+            std::cerr << "push_frame() failed!" << std::endl;
+        }
+        frame->sent = get_current_time();
+        ++frames_sent;
+    }
+}
+
+bool output_frames(const kvz_api* api, kvz_encoder* enc, kvz_picture* input)
+{
+    kvz_picture* img_rec = nullptr;
+    kvz_picture* img_src = nullptr;
+    uint32_t len_out = 0;
+    kvz_frame_info info_out;
+    kvz_data_chunk* chunks_out = nullptr;
+
+    if (!api->encoder_encode(enc, input, &chunks_out, &len_out, &img_rec, &img_src, &info_out)) {
+        std::cerr << "Failed to encode image" << std::endl;
+        return false;
+    }
+
+    if (chunks_out == nullptr) {
+        return input != nullptr;
+    }
+
+    // kvazaar may output frames later than they were given, the source picture tells which frame this is
+    live_frame* frame = &frame_table.at(img_src ? img_src->pts : 0);
+
+    for (kvz_data_chunk* chunk = chunks_out; chunk != nullptr; chunk = chunk->next) {
+        frame->data.insert(frame->data.end(), chunk->data, chunk->data + chunk->len);
+    }
+    api->chunk_free(chunks_out);
+
+    frame->encoded = get_current_time();
+
+    std::vector<chunk_index_frame> index_frames;
+    std::vector<chunk_index_nal> index_nals;
+    index_chunk(frame->data.data(), 0, frame->data.size(), false, frame->pts, index_frames, index_nals);
+    frame->nal_count = index_frames.back().nal_count;
+    frame->intra     = index_frames.back().intra;
+
+    api->picture_free(img_rec);
+    api->picture_free(img_src);
+
+    while (!encoded_frames.try_push(frame)) {
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+void write_live_results(const std::vector<const live_frame*>& frames, size_t frames_encoded)
+{
+    // <pts>;<intra>;<encode ms>;<queue ms>;<send ms>;<network ms>;<total ms>
+    std::ofstream result_file("latency_results_live", std::ios::out | std::ios::app | std::ios::ate);
+
+    double total = 0;
+    double total_intra = 0;
+    double total_inter = 0;
+    size_t nintras = 0;
+    double stages[4] = { 0 };
+
+    for (auto frame : frames) {
+        double encode  = (frame->encoded - frame->capture) / 1000.0;
+        double queue   = (frame->dequeued - frame->encoded) / 1000.0;
+        double send    = (frame->sent - frame->dequeued) / 1000.0;
+        double network = (frame->complete - frame->sent) / 1000.0;
+        double latency = (frame->complete - frame->capture) / 1000.0;
+
+        result_file << frame->pts << ";" << frame->intra << ";" << encode << ";" << queue << ";" << send << ";"
+            << network << ";" << latency << std::endl;
+
+        stages[0] += encode;
+        stages[1] += queue;
+        stages[2] += send;
+        stages[3] += network;
+        total += latency;
+
+        if (frame->intra) {
+            total_intra += latency;
+            ++nintras;
+        }
+        else {
+            total_inter += latency;
+        }
+    }
+    result_file.close();
+
+    size_t count = std::max<size_t>(1, frames.size());
+    size_t ninters = frames.size() - nintras;
+
+    std::cout << frames.size() << "/" << frames_encoded << " frames complete. Average encode " << stages[0] / count
+        << " ms, queue " << stages[1] / count << " ms, send " << stages[2] / count << " ms, network "
+        << stages[3] / count << " ms, total " << total / count << " ms" << std::endl;
+
+    write_latency_results_to_file("latency_results", frames.size(), nintras ? total_intra / nintras : 0,
+        ninters ? total_inter / ninters : 0, total / count);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 12 && argc != 13) {
+        fprintf(stderr, "usage: ./%s <yuv file> <width> <height> <local address> <local port> <remote address> \
+            <remote port> <fps> <qp> <intra period> <preset> [kvazaar threads]\n", __FILE__);
+        return EXIT_FAILURE;
+    }
+
+    std::string input_file     = argv[1];
+    int width                  = atoi(argv[2]);
+    int height                 = atoi(argv[3]);
+    std::string local_address  = argv[4];
+    int local_port             = atoi(argv[5]);
+    std::string remote_address = argv[6];
+    int remote_port            = atoi(argv[7]);
+    int fps                    = atoi(argv[8]);
+    int qp                     = atoi(argv[9]);
+    int period                 = atoi(argv[10]);
+    std::string preset         = argv[11];
+    int threads                = (argc == 13) ? atoi(argv[12]) : -1;
+
+    if (!width || !height || !fps || qp < 0 || qp > 51) {
+        std::cerr << "Invalid command line arguments" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t len = 0;
+    const uint8_t* yuv = (const uint8_t*)get_mem(input_file, len);
+    if (yuv == nullptr) {
+        return EXIT_FAILURE;
+    }
+
+    size_t luma_size = (size_t)width * height;
+    size_t frame_size = luma_size + luma_size / 2;
+    size_t input_frames = len / frame_size;
+
+    frame_table = std::vector<live_frame>(input_frames);
+    rtp_ts_step = std::max(1, 90000 / fps);
+
+    const kvz_api* api = kvz_api_get(8);
+    kvz_config* config = api->config_alloc();
+    api->config_init(config);
+    api->config_parse(config, "preset", preset.c_str());
+    config->width = width;
+    config->height = height;
+    config->hash = kvz_hash::KVZ_HASH_NONE;
+    config->intra_period = period;
+    config->qp = qp;
+    config->framerate_num = fps;
+    config->framerate_denom = 1;
+
+    if (threads >= 0) {
+        api->config_parse(config, "threads", std::to_string(threads).c_str());
+    }
+
+    kvz_encoder* enc = api->encoder_open(config);
+    kvz_picture* img_in = api->picture_alloc(width, height);
+
+    if (!enc || !img_in) {
+        std::cerr << "Failed to open kvazaar encoder!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    uvgrtp::context rtp_ctx;
+    uvgrtp::session* session = nullptr;
+    uvgrtp::media_stream* send = nullptr;
+
+    intialize_uvgrtp(rtp_ctx, &session, &send, remote_address, local_address,
+        local_port, remote_port, false, false, true, false);
+    send->install_receive_hook(nullptr, hook_sender);
+
+    std::cout << "Starting live latency send test with " << input_frames << " frames of " << width << "x" << height
+        << " at " << fps << " fps" << std::endl;
+
+    // give the receiver a moment to get ready
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+
+    std::thread sender(rtp_sender_thread, send);
+
+    uint64_t period_us = 1000000 / fps;
+    bool ok = true;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < input_frames && ok; ++i) {
+        // wait until the frame would be captured
+        auto runtime = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        if (runtime < i * period_us) {
+            std::this_thread::sleep_for(std::chrono::microseconds(i * period_us - runtime));
+        }
+
+        frame_table[i].pts = i;
+        frame_table[i].capture = get_current_time();
+
+        const uint8_t* frame = yuv + i * frame_size;
+        memcpy(img_in->y, frame, luma_size);
+        memcpy(img_in->u, frame + luma_size, luma_size / 4);
+        memcpy(img_in->v, frame + luma_size + luma_size / 4, luma_size / 4);
+        img_in->pts = i;
+
+        ok = output_frames(api, enc, img_in);
+    }
+
+    // flush the frames that are still being encoded
+    while (ok && output_frames(api, enc, nullptr));
+
+    encoding_done = true;
+    sender.join();
+
+    // the test ends when every sent frame has come back or the echoes have stopped for good
+    auto deadline = std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(RECEIVE_TIMEOUT_MS);
+    while (frames_complete < frames_sent && std::chrono::high_resolution_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    cleanup_uvgrtp(rtp_ctx, session, send);
+
+    api->encoder_close(enc);
+    api->picture_free(img_in);
+    api->config_destroy(config);
+
+    std::vector<const live_frame*> completed_frames;
+    for (auto& f : frame_table) {
+        if (f.complete) {
+            completed_frames.push_back(&f);
+        }
+    }
+    write_live_results(completed_frames, frames_sent);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,6 +1,7 @@
 #include "uvgrtp_util.hh"
 #include "v3c_util.hh"
 #include "../util/util.hh"
+#include "../util/stream_reader.hh"
 
 #include <uvgrtp/lib.hh>
 #include <uvgrtp/clock.hh>
@@ -10,20 +11,24 @@
 #include <cstdlib>
 #include <string>
 #include <iostream>
+#include <fstream>
 #include <vector>
 
+#include <time.h>
+
 void sender_thread(void* mem, std::string local_address, uint16_t local_port,
     std::string remote_address, uint16_t remote_port, int thread_num, int fps, bool vvc, bool srtp, 
-    const std::string result_file, std::vector<uint64_t> chunk_sizes);
+    const std::string result_file, std::vector<uint64_t> chunk_sizes, const chunk_index* index, bool nal_index,
+    stream_reader* reader, std::vector<uint64_t> schedule);
 
 void sender_func(uvgrtp::media_stream* stream, const char* cbuf, const std::vector<v3c_unit_info> &units, rtp_flags_t flags, int fmt,
     std::atomic<uint64_t> &net_bytes_sent, int fps, const std::string result_file);
 
 int main(int argc, char **argv)
 {
-    if (argc != 11) {
+    if (argc != 11 && argc != 12) {
         fprintf(stderr, "usage: ./%s <input file> <result file> <local address> <local port> <remote address> <remote port> \
-            <number of threads> <fps> <format> <srtp> \n", __FILE__);
+            <number of threads> <fps>[@<trace file|index>[@<speed>]] <format> <srtp> [scan|index][+stream]\n", __FILE__);
         return EXIT_FAILURE;
     }
 
@@ -41,11 +46,18 @@ int main(int argc, char **argv)
     bool atlas_enabled         = get_atlas_state(argv[9]);
     bool srtp_enabled          = get_srtp_state(argv[10]);
 
+    /* scan: uvgRTP looks for the start codes in each chunk (default)
+     * index: the NAL units are taken from the chunk index and sent without start code lookup
+     * +stream: the file is read while sending with stream_reader instead of being mapped with get_mem() */
+    std::string mode           = (argc == 12) ? argv[11] : "scan";
+    bool nal_index             = mode.find("index") != std::string::npos;
+    bool stream_input          = mode.find("stream") != std::string::npos && !atlas_enabled;
+
     std::cout << "Starting uvgRTP sender tests. " << local_address << ":" << local_port
         << "->" << remote_address << ":" << remote_port << std::endl;
 
     size_t len   = 0;
-    void *mem    = get_mem(input_file, len);
+    void *mem    = stream_input ? nullptr : get_mem(input_file, len);
     if(atlas_enabled) {
         v3c_file_map mmap;
         mmap_v3c_file((char*)mem, len, mmap);
@@ -64,18 +76,42 @@ int main(int argc, char **argv)
         std::vector<uint64_t> chunk_sizes;
         get_chunk_sizes(get_chunk_filename(input_file), chunk_sizes);
 
-        if (mem == nullptr || chunk_sizes.empty())
+        if ((mem == nullptr && !stream_input) || chunk_sizes.empty())
         {
             std::cerr << "Failed to get file: " << input_file << std::endl;
             std::cerr << "or chunk location file: " << get_chunk_filename(input_file) << std::endl;
             return EXIT_FAILURE;
         }
 
+        std::vector<uint64_t> schedule;
+        if (!get_send_schedule(argv[8], input_file, chunk_sizes.size(), schedule)) {
+            return EXIT_FAILURE;
+        }
+
+        // The index also gives the number of NAL units per frame for the results
+        chunk_index index;
+        if (!map_chunk_index(get_chunk_filename(input_file), index) && nal_index) {
+            std::cerr << "Sending NAL units from the index requires a version 2 chunk index: "
+                << get_chunk_filename(input_file) << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // With +stream, the file is read once and every stream is sent from the same buffers
+        stream_reader* reader = nullptr;
+        if (stream_input) {
+            reader = new stream_reader(input_file, chunk_sizes, nthreads);
+            if (!reader->start()) {
+                delete reader;
+                unmap_chunk_index(index);
+                return EXIT_FAILURE;
+            }
+        }
+
         std::vector<std::thread*> threads;
 
         for (int i = 0; i < nthreads; ++i) {
             threads.push_back(new std::thread(sender_thread, mem, local_address, local_port, remote_address, 
-                remote_port, i, fps, vvc_enabled, srtp_enabled, result_file, chunk_sizes));
+                remote_port, i, fps, vvc_enabled, srtp_enabled, result_file, chunk_sizes, index.mem ? &index : nullptr, nal_index, reader, schedule));
         }
 
         for (unsigned int i = 0; i < threads.size(); ++i) {
@@ -88,13 +124,16 @@ int main(int argc, char **argv)
         }
 
         threads.clear();
+        delete reader;
+        unmap_chunk_index(index);
     }
     return EXIT_SUCCESS;
 }
 
 void sender_thread(void* mem, std::string local_address, uint16_t local_port,
     std::string remote_address, uint16_t remote_port, int thread_num, int fps, bool vvc, bool srtp, 
-    const std::string result_file, std::vector<uint64_t> chunk_sizes)
+    const std::string result_file, std::vector<uint64_t> chunk_sizes, const chunk_index* index, bool nal_index,
+    stream_reader* reader, std::vector<uint64_t> schedule)
 {
     uvgrtp::context rtp_ctx;
     uvgrtp::session* session = nullptr;
@@ -109,15 +148,44 @@ void sender_thread(void* mem, std::string local_address, uint16_t local_port,
 
     size_t bytes_sent = 0;
     uint64_t current_frame = 0;
-    uint64_t period = (uint64_t)((1000 / (double)fps) * 1000);
     rtp_error_t ret = RTP_OK;
 
+    // CPU time this thread spends in push_frame(), i.e. packetization and sending
+    uint64_t cpu_ns = 0;
+    struct timespec cpu_start, cpu_end;
+
     // start the sending test
     std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
 
     for (auto& chunk_size : chunk_sizes)
     {
-        if ((ret = send->push_frame((uint8_t*)mem + bytes_sent, chunk_size, 0)) != RTP_OK) {
+        // With a reader, chunks are read from the file just ahead of sending. This stream is consumer thread_num
+        uint8_t* chunk = reader ? (uint8_t*)reader->next_chunk(thread_num, start + std::chrono::microseconds(schedule[current_frame]))
+                                : (uint8_t*)mem + bytes_sent;
+        if (chunk == nullptr) {
+            break;
+        }
+
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+
+        if (nal_index) {
+            // All NAL units of the chunk share the RTP timestamp, so it is given explicitly (90 kHz clock)
+            const chunk_index_frame& frame = index->frames[current_frame];
+            uint32_t ts = (uint32_t)(schedule[current_frame] * 90 / 1000);
+
+            for (uint32_t n = 0; n < frame.nal_count && ret == RTP_OK; ++n) {
+                const chunk_index_nal& nal = index->nals[frame.first_nal + n];
+                ret = send->push_frame(chunk + (nal.offset - frame.offset), nal.size, ts, RTP_NO_H26X_SCL);
+            }
+        }
+        else {
+            ret = send->push_frame(chunk, chunk_size, 0);
+        }
+
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+        cpu_ns += (cpu_end.tv_sec - cpu_start.tv_sec) * 1000000000ULL + cpu_end.tv_nsec - cpu_start.tv_nsec;
+
+        if (ret != RTP_OK) {
 
             fprintf(stderr, "push_frame() failed!\n");
 
@@ -125,6 +193,9 @@ void sender_thread(void* mem, std::string local_address, uint16_t local_port,
             std::cerr << "Send test push failed! Please fix benchmark suite." << std::endl;
             std::this_thread::sleep_for(std::chrono::milliseconds(500));
             cleanup_uvgrtp(rtp_ctx, session, send);
+            if (reader) {
+                reader->finish(thread_num);
+            }
             return;
         }
 
@@ -135,19 +206,52 @@ void sender_thread(void* mem, std::string local_address, uint16_t local_port,
             std::chrono::high_resolution_clock::now() - start
             ).count();
 
-        // this enforces the fps restriction by waiting until it is time to send next frame
+        // this enforces the fps restriction (or the trace) by waiting until it is time to send next frame
         // if this was eliminated, the test would be just about sending as fast as possible.
         // if the library falls behind, it is allowed to catch up if it can do it.
-        if (runtime < current_frame * period)
-            std::this_thread::sleep_for(std::chrono::microseconds(current_frame * period - runtime));
+        if (current_frame < schedule.size() && runtime < schedule[current_frame])
+            std::this_thread::sleep_for(std::chrono::microseconds(schedule[current_frame] - runtime));
     }
 
     // here we take the time and see how long it actually
     auto end = std::chrono::high_resolution_clock::now();
     uint64_t diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
+    if (reader) {
+        reader->finish(thread_num);
+    }
+
     write_send_results_to_file(result_file, bytes_sent, diff);
     cleanup_uvgrtp(rtp_ctx, session, send);
+
+    /* <mode>;<frames>;<NAL units per frame>;<CPU us per frame>;<total CPU ms>. Compare the modes to see the
+     * cost of start code lookup and files with a different number of slices to see the cost per NAL unit */
+    double nals_per_frame = index ? index->header->nal_count / (double)index->header->frame_count : 0;
+
+    std::ofstream cpu_file(result_file + "_cpu", std::ios::out | std::ios::app | std::ios::ate);
+    cpu_file << (nal_index ? "index" : "scan") << ";" << current_frame << ";" << nals_per_frame << ";"
+        << (current_frame ? cpu_ns / 1000.0 / current_frame : 0) << ";" << cpu_ns / 1000000.0 << std::endl;
+    cpu_file.close();
+
+    std::cout << "push_frame() CPU time: " << (current_frame ? cpu_ns / 1000.0 / current_frame : 0)
+        << " us per frame (" << (nal_index ? "index" : "scan") << ", " << nals_per_frame << " NAL units per frame)" << std::endl;
+
+    if (reader) {
+        // <frames>;<late frames>;<total late ms>;<max late ms>;<startup ms>, lateness is from the send time of the frame
+        uint64_t late_us = 0;
+        uint64_t max_late_us = 0;
+        for (auto& late : reader->late_chunks(thread_num)) {
+            late_us += late.second;
+            max_late_us = std::max(max_late_us, late.second);
+
+            std::cout << "Frame " << late.first << " was not read in time, " << late.second << " us late" << std::endl;
+        }
+
+        std::ofstream stream_file(result_file + "_stream", std::ios::out | std::ios::app | std::ios::ate);
+        stream_file << current_frame << ";" << reader->late_chunks(thread_num).size() << ";" << late_us / 1000.0 << ";"
+            << max_late_us / 1000.0 << ";" << reader->startup_us() / 1000.0 << std::endl;
+        stream_file.close();
+    }
 }
 
 void sender_func(uvgrtp::media_stream* stream, const char* cbuf, const std::vector<v3c_unit_info> &units, rtp_flags_t flags, int fmt,
@@ -1,5 +1,10 @@
 #include "v3c_util.hh"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
 uint32_t combineBytes(uint8_t byte1, uint8_t byte2, uint8_t byte3, uint8_t byte4) {
     return (static_cast<uint32_t>(byte1) << 24) |
         (static_cast<uint32_t>(byte2) << 16) |
@@ -282,9 +287,8 @@ char* get_cmem(std::string filename)
 
 v3c_streams init_v3c_streams(uvgrtp::session* sess, uint16_t src_port, uint16_t dst_port, int flags, bool rec)
 {
-    flags |= RCE_NO_H26X_PREPEND_SC;
     v3c_streams streams = {};
-    /* debug code, alternative to below socket mux initialization
+    /* debug code, alternative to socket mux initialization
     if (rec) {
         streams.ad = sess->create_stream(5000, 5001, RTP_FORMAT_ATLAS, flags);
         streams.ovd = sess->create_stream(5002, 5003, RTP_FORMAT_H265, flags);
@@ -298,47 +302,179 @@ v3c_streams init_v3c_streams(uvgrtp::session* sess, uint16_t src_port, uint16_t
         streams.gvd = sess->create_stream(6002, 6000, RTP_FORMAT_H265, flags);
         streams.avd = sess->create_stream(5007, 5006, RTP_FORMAT_H265, flags);
     }*/
-    streams.ad = sess->create_stream(src_port, dst_port, RTP_FORMAT_ATLAS, flags);
-    streams.ovd = sess->create_stream(src_port, dst_port, RTP_FORMAT_H265, flags);
-    streams.gvd = sess->create_stream(src_port, dst_port, RTP_FORMAT_H265, flags);
-    streams.avd = sess->create_stream(src_port, dst_port, RTP_FORMAT_H265, flags);
-
-    streams.gvd->configure_ctx(RCC_UDP_RCV_BUF_SIZE, 40 * 1000 * 1000);
-    streams.avd->configure_ctx(RCC_UDP_RCV_BUF_SIZE, 40 * 1000 * 1000);
-    streams.gvd->configure_ctx(RCC_UDP_SND_BUF_SIZE, 40 * 1000 * 1000);
-    streams.avd->configure_ctx(RCC_UDP_SND_BUF_SIZE, 40 * 1000 * 1000); 
-
-    streams.gvd->configure_ctx(RCC_RING_BUFFER_SIZE, 40 * 1000 * 1000);
-    streams.avd->configure_ctx(RCC_RING_BUFFER_SIZE, 40 * 1000 * 1000);
-    streams.gvd->configure_ctx(RCC_PKT_MAX_DELAY, 1000);
-    streams.avd->configure_ctx(RCC_PKT_MAX_DELAY, 1000);
-    
-    if (rec) {
-        streams.ad->configure_ctx(RCC_REMOTE_SSRC, 2);
-        streams.ovd->configure_ctx(RCC_REMOTE_SSRC, 3);
-        streams.gvd->configure_ctx(RCC_REMOTE_SSRC, 4);
-        streams.avd->configure_ctx(RCC_REMOTE_SSRC, 5);
-
-        streams.ad->configure_ctx(RCC_SSRC, 22);
-        streams.ovd->configure_ctx(RCC_SSRC, 33);
-        streams.gvd->configure_ctx(RCC_SSRC, 44);
-        streams.avd->configure_ctx(RCC_SSRC, 55);
+    std::vector<v3c_substream> substreams = init_v3c_substreams(sess, src_port, dst_port, flags, rec, get_default_v3c_layout());
+    if (substreams.empty()) {
+        return streams;
     }
-    else {
-        streams.ad->configure_ctx(RCC_SSRC, 2);
-        streams.ovd->configure_ctx(RCC_SSRC, 3);
-        streams.gvd->configure_ctx(RCC_SSRC, 4);
-        streams.avd->configure_ctx(RCC_SSRC, 5);
 
-        streams.ad->configure_ctx(RCC_REMOTE_SSRC, 22);
-        streams.ovd->configure_ctx(RCC_REMOTE_SSRC, 33);
-        streams.gvd->configure_ctx(RCC_REMOTE_SSRC, 44);
-        streams.avd->configure_ctx(RCC_REMOTE_SSRC, 55);
-    }
+    streams.ad = substreams.at(0).stream;
+    streams.ovd = substreams.at(1).stream;
+    streams.gvd = substreams.at(2).stream;
+    streams.avd = substreams.at(3).stream;
+
     //streams.gvd->configure_ctx(RCC_FPS_NUMERATOR, 10);
     return streams;
 }
 
+/* The SSRCs are derived from the object and sub-bitstream so that both ends agree on them without signaling.
+ * Bits 0-3 hold the map index, 4-10 the attribute index, 11-16 the atlas ID, 17-19 the unit type + 1 and 20-29 the object.
+ * The receiving end uses the same value with the highest bit set */
+static uint32_t get_v3c_substream_ssrc(const v3c_substream_key& key, uint16_t object, bool rec)
+{
+    uint32_t ssrc = ((uint32_t)(object & 0x3ff) << 20) | ((uint32_t)((key.vuh_unit_type + 1) & 0x07) << 17) |
+        ((uint32_t)(key.vuh_atlas_id & 0x3f) << 11) | ((uint32_t)(key.vuh_attribute_index & 0x7f) << 4) |
+        (uint32_t)(key.vuh_map_index & 0x0f);
+
+    return rec ? (ssrc | 0x80000000) : ssrc;
+}
+
+std::vector<v3c_substream> init_v3c_substreams(uvgrtp::session* sess, uint16_t src_port, uint16_t dst_port, int flags, bool rec,
+    const std::vector<v3c_substream_key>& keys, uint16_t object)
+{
+    flags |= RCE_NO_H26X_PREPEND_SC;
+    src_port = get_v3c_object_port(src_port, object);
+    dst_port = get_v3c_object_port(dst_port, object);
+
+    std::vector<v3c_substream> substreams = {};
+
+    for (auto& key : keys) {
+        uint8_t type = key.vuh_unit_type;
+        rtp_format_t fmt = (type == V3C_AD || type == V3C_CAD) ? RTP_FORMAT_ATLAS : RTP_FORMAT_H265;
+        v3c_substream substream = { key, sess->create_stream(src_port, dst_port, fmt, flags) };
+
+        if (!substream.stream) {
+            std::cerr << "Failed to create media stream for V3C unit type " << (uint32_t)type << std::endl;
+            destroy_v3c_substreams(sess, substreams);
+            return {};
+        }
+
+        // Geometry, attribute and packed video carry most of the data
+        if (type == V3C_GVD || type == V3C_AVD || type == V3C_PVD) {
+            substream.stream->configure_ctx(RCC_UDP_RCV_BUF_SIZE, 40 * 1000 * 1000);
+            substream.stream->configure_ctx(RCC_UDP_SND_BUF_SIZE, 40 * 1000 * 1000);
+            substream.stream->configure_ctx(RCC_RING_BUFFER_SIZE, 40 * 1000 * 1000);
+            substream.stream->configure_ctx(RCC_PKT_MAX_DELAY, 1000);
+        }
+
+        substream.stream->configure_ctx(RCC_SSRC, get_v3c_substream_ssrc(key, object, rec));
+        substream.stream->configure_ctx(RCC_REMOTE_SSRC, get_v3c_substream_ssrc(key, object, !rec));
+        substreams.push_back(substream);
+    }
+    return substreams;
+}
+
+uint16_t get_v3c_object_port(uint16_t port, uint16_t object)
+{
+    return port + 2 * object;
+}
+
+void destroy_v3c_substreams(uvgrtp::session* sess, std::vector<v3c_substream>& substreams)
+{
+    for (auto& s : substreams) {
+        sess->destroy_stream(s.stream);
+        s.stream = nullptr;
+    }
+}
+
+v3c_substream_key get_v3c_substream_key(const v3c_unit_header& hdr)
+{
+    v3c_substream_key key = {};
+    key.vuh_unit_type = hdr.vuh_unit_type;
+
+    switch (hdr.vuh_unit_type) {
+    case V3C_AD:
+        key.vuh_atlas_id = hdr.ad.vuh_atlas_id;
+        break;
+    case V3C_OVD:
+        key.vuh_atlas_id = hdr.ovd.vuh_atlas_id;
+        break;
+    case V3C_GVD:
+        key.vuh_atlas_id = hdr.gvd.vuh_atlas_id;
+        key.vuh_map_index = hdr.gvd.vuh_map_index;
+        break;
+    case V3C_AVD:
+        key.vuh_atlas_id = hdr.avd.vuh_atlas_id;
+        key.vuh_attribute_index = hdr.avd.vuh_attribute_index;
+        key.vuh_map_index = hdr.avd.vuh_map_index;
+        break;
+    case V3C_PVD:
+        key.vuh_atlas_id = hdr.pvd.vuh_atlas_id;
+        break;
+    default: // VPS and CAD have no atlas id
+        break;
+    }
+    return key;
+}
+
+std::map<v3c_substream_key, std::vector<v3c_unit_info>> get_v3c_substreams(const v3c_file_map& mmap)
+{
+    std::map<v3c_substream_key, std::vector<v3c_unit_info>> substreams = {};
+
+    for (auto units : { &mmap.ad_units, &mmap.ovd_units, &mmap.gvd_units, &mmap.avd_units, &mmap.pvd_units, &mmap.cad_units }) {
+        for (auto& unit : *units) {
+            substreams[get_v3c_substream_key(unit.header)].push_back(unit);
+        }
+    }
+    return substreams;
+}
+
+std::vector<v3c_substream_key> get_default_v3c_layout()
+{
+    v3c_substream_key ad = {};
+    v3c_substream_key ovd = {};
+    v3c_substream_key gvd = {};
+    v3c_substream_key avd = {};
+    ad.vuh_unit_type = V3C_AD;
+    ovd.vuh_unit_type = V3C_OVD;
+    gvd.vuh_unit_type = V3C_GVD;
+    avd.vuh_unit_type = V3C_AVD;
+
+    return { ad, ovd, gvd, avd };
+}
+
+std::string v3c_layout_to_string(const std::vector<v3c_substream_key>& keys)
+{
+    std::string layout = "";
+
+    for (auto& key : keys) {
+        if (!layout.empty()) {
+            layout += ",";
+        }
+        layout += std::to_string(key.vuh_unit_type) + "." + std::to_string(key.vuh_atlas_id) + "." +
+            std::to_string(key.vuh_attribute_index) + "." + std::to_string(key.vuh_map_index);
+    }
+    return layout;
+}
+
+std::vector<v3c_substream_key> parse_v3c_layout(const std::string& layout)
+{
+    std::vector<v3c_substream_key> keys = {};
+    size_t pos = 0;
+
+    while (pos < layout.size()) {
+        size_t end = layout.find(',', pos);
+        if (end == std::string::npos) {
+            end = layout.size();
+        }
+
+        unsigned int type = 0, atlas = 0, attribute = 0, map = 0;
+        if (sscanf(layout.substr(pos, end - pos).c_str(), "%u.%u.%u.%u", &type, &atlas, &attribute, &map) != 4 || type > V3C_CAD) {
+            std::cerr << "Invalid V3C sub-bitstream layout entry: " << layout.substr(pos, end - pos) << std::endl;
+            return {};
+        }
+
+        v3c_substream_key key = {};
+        key.vuh_unit_type = (uint8_t)type;
+        key.vuh_atlas_id = (uint8_t)atlas;
+        key.vuh_attribute_index = (uint8_t)attribute;
+        key.vuh_map_index = (uint8_t)map;
+        keys.push_back(key);
+
+        pos = end + 1;
+    }
+    return keys;
+}
+
 v3c_file_map init_mmap()
 {
     v3c_file_map mmap = {};
@@ -375,7 +511,7 @@ void create_v3c_unit(v3c_unit_info& current_unit, char* buf, uint64_t& ptr, uint
     if (v3c_type == V3C_AD || v3c_type == V3C_CAD) {
         v3c_size_int++; // NAL size precision for Atlas V3C units
     }
-    std::cout << "init v3c unit of size " << v3c_size_int << std::endl;
+    //std::cout << "init v3c unit of size " << v3c_size_int << std::endl;
     convert_size_big_endian(v3c_size_int, v3c_size_arr, v3c_precision);
     memcpy(&buf[ptr], v3c_size_arr, v3c_precision);
     ptr += v3c_precision;
@@ -487,7 +623,7 @@ uint64_t reconstruct_v3c_gop(bool hdr_byte, char* &buf, uint64_t& ptr, v3c_file_
     uint64_t gvd_size = V3C_SIZE_PRECISION + 4 + mmap.gvd_units.at(index).ptr + mmap.gvd_units.at(index).nal_infos.size() * VIDEO_NAL_SIZE_PRECISION;
     uint64_t avd_size = V3C_SIZE_PRECISION + 4 + mmap.avd_units.at(index).ptr + mmap.avd_units.at(index).nal_infos.size() * VIDEO_NAL_SIZE_PRECISION;
     gop_size += vps_size + ad_size + ovd_size + gvd_size + avd_size;
-    std::cout << "Initializing GoP buffer of " << gop_size << " bytes" << std::endl;
+    //std::cout << "Initializing GoP buffer of " << gop_size << " bytes" << std::endl;
 
     // Commented out because we want to write the whole file into the buffer, not GoP by GoP
     //buf = new char[gop_size];
@@ -602,4 +738,158 @@ uint64_t get_gop_size(bool hdr_byte, uint64_t index, v3c_file_map& mmap)
     uint64_t avd_size = V3C_SIZE_PRECISION + 4 + mmap.avd_units.at(index).ptr + mmap.avd_units.at(index).nal_infos.size() * VIDEO_NAL_SIZE_PRECISION;
     gop_size += vps_size + ad_size + ovd_size + gvd_size + avd_size;
     return gop_size;
-}
\ No newline at end of file
+}
+
+bool is_v3c_param_set(uint8_t vuh_unit_type, uint8_t nalu_t)
+{
+    if (vuh_unit_type == V3C_AD && nalu_t > 35) { // Atlas parameter set NAL unit
+        return true;
+    }
+    return nalu_t >= 32 && nalu_t <= 34; // Video parameter set NAL unit
+}
+
+// Split the NAL units of a V3C unit into coded pictures (atlas frames for Atlas data)
+static std::vector<std::vector<nal_info>> split_into_pictures(const uint8_t* bytes, const v3c_unit_info& unit)
+{
+    std::vector<std::vector<nal_info>> pictures = {};
+    std::vector<nal_info> pending = {}; // Non-VCL NAL units that precede the next picture
+    bool atlas = (unit.header.vuh_unit_type == V3C_AD || unit.header.vuh_unit_type == V3C_CAD);
+
+    for (auto& i : unit.nal_infos) {
+        uint8_t nalu_t = (bytes[i.location] >> 1) & 0x3f;
+
+        /* Atlas: ACL NAL units are types 0-35 (TSA_N ... SKIP_R, the IRAP types BLA_W_LP ... GCRA 16-27
+         * and the reserved ACL types). HEVC: VCL NAL units are types 0-31 */
+        bool vcl = atlas ? (nalu_t <= 35) : (nalu_t < 32);
+
+        if (vcl) {
+            /* HEVC: first_slice_segment_in_pic_flag is the first bit after the 2 byte NAL unit header.
+             * Atlas: each ACL NAL unit is treated as one atlas frame (one tile per frame) */
+            bool first_slice = atlas || i.size < 3 || (bytes[i.location + 2] & 0x80);
+
+            if (first_slice || pictures.empty()) {
+                pictures.push_back(pending);
+            }
+            else {
+                pictures.back().insert(pictures.back().end(), pending.begin(), pending.end());
+            }
+            pending.clear();
+            pictures.back().push_back(i);
+            continue;
+        }
+
+        /* Suffix NAL units belong to the previous picture.
+         * Atlas: NAL_EOS 40, NAL_EOB 41, NAL_FD 42, NAL_SUFFIX_NSEI 44 and NAL_SUFFIX_ESEI 46.
+         * HEVC: EOS_NUT 36, EOB_NUT 37, FD_NUT 38 and SUFFIX_SEI_NUT 40 */
+        bool suffix = atlas ? (nalu_t >= 40 && nalu_t <= 42) || nalu_t == 44 || nalu_t == 46
+                            : (nalu_t >= 36 && nalu_t <= 38) || nalu_t == 40;
+
+        if (suffix && !pictures.empty()) {
+            pictures.back().push_back(i);
+        }
+        else {
+            pending.push_back(i);
+        }
+    }
+
+    if (!pending.empty()) {
+        if (pictures.empty()) {
+            pictures.push_back(pending);
+        }
+        else {
+            pictures.back().insert(pictures.back().end(), pending.begin(), pending.end());
+        }
+    }
+    return pictures;
+}
+
+std::vector<v3c_frame> group_v3c_frames(const char* cbuf, const std::vector<const std::vector<v3c_unit_info>*>& components)
+{
+    std::vector<v3c_frame> frames = {};
+    const uint8_t* bytes = (const uint8_t*)cbuf;
+
+    // Each V3C unit of a sub-bitstream contains one GoP. A sub-bitstream with fewer units has nothing in the later GoPs
+    size_t gops = 0;
+    for (auto c : components) {
+        gops = std::max(gops, c->size());
+    }
+
+    for (size_t g = 0; g < gops; ++g) {
+        std::vector<std::vector<std::vector<nal_info>>> pictures(components.size());
+        size_t atlas_frames = 0;
+        size_t max_pictures = 0;
+
+        for (size_t c = 0; c < components.size(); ++c) {
+            if (g >= components.at(c)->size()) {
+                continue;
+            }
+            const v3c_unit_info& unit = components.at(c)->at(g);
+            pictures.at(c) = split_into_pictures(bytes, unit);
+
+            // Atlas data determines the V3C frames. Common atlas data is sparse, so it does not set the frame count
+            if (unit.header.vuh_unit_type == V3C_AD) {
+                atlas_frames = std::max(atlas_frames, pictures.at(c).size());
+            }
+            max_pictures = std::max(max_pictures, pictures.at(c).size());
+        }
+
+        // Without atlas data in the GoP, the sub-bitstream with the most pictures determines the V3C frames
+        size_t frame_count = atlas_frames ? atlas_frames : max_pictures;
+
+        if (frame_count == 0) {
+            continue;
+        }
+
+        size_t first = frames.size();
+        frames.resize(first + frame_count);
+
+        for (size_t f = first; f < frames.size(); ++f) {
+            frames.at(f).nals.resize(components.size());
+        }
+
+        for (size_t c = 0; c < components.size(); ++c) {
+            /* Picture k belongs to V3C frame k, frames past the last picture stay empty for this sub-bitstream.
+             * Sub-bitstreams with more pictures than V3C frames (e.g. several maps) send them in groups */
+            size_t per_frame = (pictures.at(c).size() + frame_count - 1) / frame_count;
+
+            for (size_t k = 0; k < pictures.at(c).size(); ++k) {
+                size_t f = std::min(k / per_frame, frame_count - 1);
+                auto& nals = frames.at(first + f).nals.at(c);
+                nals.insert(nals.end(), pictures.at(c).at(k).begin(), pictures.at(c).at(k).end());
+            }
+        }
+    }
+    return frames;
+}
+
+void schedule_v3c_frames(v3c_frame_release& release, uint64_t frame_count, float fps, std::vector<long long>* release_times)
+{
+    uint64_t period = (uint64_t)((1000 * 1000 / fps));
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    for (uint64_t f = 0; f < frame_count; ++f) {
+        {
+            std::lock_guard<std::mutex> lock(release.mtx);
+            if (release_times) {
+                release_times->push_back(std::chrono::time_point_cast<std::chrono::microseconds>(
+                    std::chrono::high_resolution_clock::now()).time_since_epoch().count());
+            }
+            release.released = f + 1;
+        }
+        release.cv.notify_all();
+
+        // wait until it is time to release the next frame. All sub-bitstreams share this deadline
+        auto runtime = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - start).count();
+
+        if (runtime < (f + 1) * period) {
+            std::this_thread::sleep_for(std::chrono::microseconds((f + 1) * period - runtime));
+        }
+    }
+}
+
+void wait_for_v3c_frame(v3c_frame_release& release, uint64_t index)
+{
+    std::unique_lock<std::mutex> lock(release.mtx);
+    release.cv.wait(lock, [&release, index] { return release.released > index; });
+}
@@ -5,6 +5,12 @@
 #include <cstring>
 #include <vector>
 #include <string>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <condition_variable>
+
+constexpr uint16_t V3C_MAX_OBJECTS = 1024;
 
 // vuh_unit_type definitions:
 enum V3C_UNIT_TYPE {
@@ -100,6 +106,21 @@ struct v3c_file_map {
     std::vector<v3c_unit_info> cad_units = {};
 };
 
+/* A v3c_frame contains the NAL units of every sub-bitstream that belong to the same V3C frame
+ - nals has one vector per sub-bitstream, in the order the sub-bitstreams were given to group_v3c_frames()
+ - The vector of a sub-bitstream that has no unit or picture for the frame is empty
+ - The senders release all sub-bitstreams of a frame together on one deadline */
+struct v3c_frame {
+    std::vector<std::vector<nal_info>> nals = {};
+};
+
+// Shared between the frame scheduler and the sender threads of each sub-bitstream
+struct v3c_frame_release {
+    std::mutex mtx;
+    std::condition_variable cv;
+    uint64_t released = 0; // Number of V3C frames released for sending so far
+};
+
 struct v3c_streams {
     uvgrtp::media_stream* vps = nullptr;
     uvgrtp::media_stream* ad = nullptr;
@@ -108,6 +129,26 @@ struct v3c_streams {
     uvgrtp::media_stream* avd = nullptr;
 };
 
+/* A v3c_substream_key identifies one V3C sub-bitstream, for example the second geometry map of atlas 1.
+ - Fields that are not present in the V3C unit header of the type are zero */
+struct v3c_substream_key {
+    uint8_t vuh_unit_type = 0;
+    uint8_t vuh_atlas_id = 0;
+    uint8_t vuh_attribute_index = 0;
+    uint8_t vuh_map_index = 0;
+
+    bool operator<(const v3c_substream_key& other) const {
+        return std::tie(vuh_unit_type, vuh_atlas_id, vuh_attribute_index, vuh_map_index) <
+            std::tie(other.vuh_unit_type, other.vuh_atlas_id, other.vuh_attribute_index, other.vuh_map_index);
+    }
+};
+
+// Each V3C sub-bitstream is sent in its own media stream. All media streams of an object share the same ports
+struct v3c_substream {
+    v3c_substream_key key = {};
+    uvgrtp::media_stream* stream = nullptr;
+};
+
 uint32_t combineBytes(uint8_t byte1, uint8_t byte2, uint8_t byte3, uint8_t byte4);
 uint32_t combineBytes(uint8_t byte1, uint8_t byte2, uint8_t byte3);
 uint32_t combineBytes(uint8_t byte1, uint8_t byte2);
@@ -128,6 +169,32 @@ void parse_v3c_header(v3c_unit_header &hdr, char* buf, uint64_t ptr);
 // Initialize a media stream for all 5 components of a V3C Stream
 v3c_streams init_v3c_streams(uvgrtp::session* sess, uint16_t src_port, uint16_t dst_port, int flags, bool rec);
 
+/* Initialize a media stream for each given V3C sub-bitstream.
+ * When several point cloud objects are streamed at once, each object has its own index. It is part of the SSRCs,
+ * and get_v3c_object_port() gives the ports of the object */
+std::vector<v3c_substream> init_v3c_substreams(uvgrtp::session* sess, uint16_t src_port, uint16_t dst_port, int flags, bool rec,
+    const std::vector<v3c_substream_key>& keys, uint16_t object = 0);
+
+// Port used by the media streams of an object. Objects are two ports apart so that RTCP can use port + 1
+uint16_t get_v3c_object_port(uint16_t port, uint16_t object);
+
+// Destroy the media streams created with init_v3c_substreams()
+void destroy_v3c_substreams(uvgrtp::session* sess, std::vector<v3c_substream>& substreams);
+
+// Get the sub-bitstream a V3C unit belongs to
+v3c_substream_key get_v3c_substream_key(const v3c_unit_header& hdr);
+
+// Sort the V3C units of a memory map by sub-bitstream. VPS units are not included
+std::map<v3c_substream_key, std::vector<v3c_unit_info>> get_v3c_substreams(const v3c_file_map& mmap);
+
+// The sub-bitstreams of the default layout: AD, OVD, GVD and AVD of atlas 0
+std::vector<v3c_substream_key> get_default_v3c_layout();
+
+/* Sub-bitstream layouts are given to the receivers as a string of comma separated
+ * <unit type>.<atlas id>.<attribute index>.<map index> entries, for example "1.0.0.0,2.0.0.0,3.0.0.0,3.0.0.1,4.0.0.0" */
+std::string v3c_layout_to_string(const std::vector<v3c_substream_key>& keys);
+std::vector<v3c_substream_key> parse_v3c_layout(const std::string& layout);
+
 // Initialize a memory map of a V3C file
 v3c_file_map init_mmap();
 
@@ -143,4 +210,16 @@ uint64_t reconstruct_v3c_gop(bool hdr_byte, char* &buf, uint64_t& ptr, v3c_file_
 // Check if there is a complete GoP in the memory map
 bool is_gop_ready(uint64_t index, v3c_file_map& mmap);
 
-uint64_t get_gop_size(bool hdr_byte, uint64_t index, v3c_file_map& mmap);
\ No newline at end of file
+uint64_t get_gop_size(bool hdr_byte, uint64_t index, v3c_file_map& mmap);
+
+// Check if a NAL unit of a V3C sub-bitstream is a parameter set (these are not counted as frames)
+bool is_v3c_param_set(uint8_t vuh_unit_type, uint8_t nalu_t);
+
+// Group the NAL units of the given sub-bitstreams into V3C frames by GoP and atlas frame, based on the NAL unit headers
+std::vector<v3c_frame> group_v3c_frames(const char* cbuf, const std::vector<const std::vector<v3c_unit_info>*>& components);
+
+// Release frame_count V3C frames to the sender threads at the given frame rate, optionally logging the release times
+void schedule_v3c_frames(v3c_frame_release& release, uint64_t frame_count, float fps, std::vector<long long>* release_times);
+
+// Block until the V3C frame in index has been released by schedule_v3c_frames()
+void wait_for_v3c_frame(v3c_frame_release& release, uint64_t index);
\ No newline at end of file
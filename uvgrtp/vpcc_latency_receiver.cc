@@ -13,10 +13,11 @@ bool frame_received = true;
 int TIMEOUT = 300;
 bool srtp_enabled = false;
 
-int ad = 0;
-int ovd = 0;
-int gvd = 0;
-int avd = 0;
+// Each sub-bitstream echoes the received NAL units back through its own media stream
+struct echo_stream {
+    uvgrtp::media_stream* stream = nullptr;
+    size_t nals = 0;
+};
 
 // encryption parameters
 enum Key_length{SRTP_128 = 128, SRTP_196 = 196, SRTP_256 = 256};
@@ -25,44 +26,18 @@ constexpr int KEY_SIZE_BYTES = KEY_S/8;
 constexpr int SALT_S = 112;
 constexpr int SALT_SIZE_BYTES = SALT_S/8;
 
-void ad_hook_rec(void* arg, uvg_rtp::frame::rtp_frame* frame)
+void hook_rec(void* arg, uvg_rtp::frame::rtp_frame* frame)
 {
-    uvgrtp::media_stream* receive = (uvgrtp::media_stream*)arg;
-    if((receive->push_frame(frame->payload, frame->payload_len, RTP_NO_H26X_SCL)) != RTP_OK) {
+    echo_stream* receive = (echo_stream*)arg;
+    if((receive->stream->push_frame(frame->payload, frame->payload_len, RTP_NO_H26X_SCL)) != RTP_OK) {
         std::cout << "Error sending frame" << std::endl;
     }
     frame_received = true;
-    ad++;
-}
-void ovd_hook_rec(void* arg, uvg_rtp::frame::rtp_frame* frame)
-{
-    uvgrtp::media_stream* receive = (uvgrtp::media_stream*)arg;
-    if((receive->push_frame(frame->payload, frame->payload_len, RTP_NO_H26X_SCL)) != RTP_OK) {
-        std::cout << "Error sending frame" << std::endl;
-    }
-    frame_received = true;
-    ovd++;
-}
-void gvd_hook_rec(void* arg, uvg_rtp::frame::rtp_frame* frame)
-{
-    uvgrtp::media_stream* receive = (uvgrtp::media_stream*)arg;
-    if((receive->push_frame(frame->payload, frame->payload_len, RTP_NO_H26X_SCL)) != RTP_OK) {
-        std::cout << "Error sending frame" << std::endl;
-    }
-    frame_received = true;
-    gvd++;
-}
-void avd_hook_rec(void* arg, uvg_rtp::frame::rtp_frame* frame)
-{
-    uvgrtp::media_stream* receive = (uvgrtp::media_stream*)arg;
-    if((receive->push_frame(frame->payload, frame->payload_len, RTP_NO_H26X_SCL)) != RTP_OK) {
-        std::cout << "Error sending frame" << std::endl;
-    }
-    frame_received = true;
-    avd++;
+    receive->nals++;
 }
 
-int receiver(std::string local_address, int local_port, std::string remote_address, int remote_port)
+int receiver(std::string local_address, int local_port, std::string remote_address, int remote_port,
+    const std::vector<v3c_substream_key>& keys, int objects)
 {
     uvgrtp::context rtp_ctx;
     uvgrtp::session* sess = rtp_ctx.create_session(remote_address, local_address);
@@ -71,7 +46,20 @@ int receiver(std::string local_address, int local_port, std::string remote_addre
     if (srtp_enabled) {
         flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_KEYSIZE_256;
     }
-    v3c_streams streams = init_v3c_streams(sess, local_port, remote_port, flags, true);
+
+    // Every object has its own set of media streams with its own ports and SSRCs
+    std::vector<std::vector<v3c_substream>> substreams(objects);
+    for (int o = 0; o < objects; ++o) {
+        substreams.at(o) = init_v3c_substreams(sess, local_port, remote_port, flags, true, keys, o);
+
+        if (substreams.at(o).empty()) {
+            for (auto& s : substreams) {
+                destroy_v3c_substreams(sess, s);
+            }
+            rtp_ctx.destroy_session(sess);
+            return EXIT_FAILURE;
+        }
+    }
 
     if (srtp_enabled) {
         std::cout << "SRTP enabled" << std::endl;
@@ -85,16 +73,22 @@ int receiver(std::string local_address, int local_port, std::string remote_addre
         for (int i = 0; i < SALT_SIZE_BYTES; ++i)
             salt[i] = i * 2;
 
-        streams.ad->add_srtp_ctx(key, salt);
-        streams.ovd->add_srtp_ctx(key, salt);
-        streams.gvd->add_srtp_ctx(key, salt);
-        streams.avd->add_srtp_ctx(key, salt);
+        for (auto& object : substreams) {
+            for (auto& s : object) {
+                s.stream->add_srtp_ctx(key, salt);
+            }
+        }
     }
 
-    streams.ad->install_receive_hook(streams.ad, ad_hook_rec);
-    streams.ovd->install_receive_hook(streams.ovd, ovd_hook_rec);
-    streams.gvd->install_receive_hook(streams.gvd, gvd_hook_rec);
-    streams.avd->install_receive_hook(streams.avd, avd_hook_rec);
+    std::vector<std::vector<echo_stream>> echoes(objects);
+    for (int o = 0; o < objects; ++o) {
+        for (auto& s : substreams.at(o)) {
+            echoes.at(o).push_back({ s.stream, 0 });
+        }
+        for (size_t i = 0; i < substreams.at(o).size(); ++i) {
+            substreams.at(o).at(i).stream->install_receive_hook(&echoes.at(o).at(i), hook_rec);
+        }
+    }
     
     while (frame_received)
     {
@@ -104,15 +98,16 @@ int receiver(std::string local_address, int local_port, std::string remote_addre
     std::cout << "No more frames received for " << TIMEOUT << " ms, end round" << std::endl;
 
     // Debug prints
-    std::cout << "AD NALS received: " << ad << std::endl;
-    std::cout << "OVD NALS received: " << ovd << std::endl;
-    std::cout << "GVD NALS received: " << gvd << std::endl;
-    std::cout << "AVD NALS received: " << avd << std::endl;
-
-    sess->destroy_stream(streams.ad);
-    sess->destroy_stream(streams.ovd);
-    sess->destroy_stream(streams.gvd);
-    sess->destroy_stream(streams.avd);
+    for (int o = 0; o < objects; ++o) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            std::cout << "Object " << o << ", V3C unit type " << (uint32_t)keys.at(i).vuh_unit_type << " NALS received: "
+                << echoes.at(o).at(i).nals << std::endl;
+        }
+    }
+
+    for (auto& object : substreams) {
+        destroy_v3c_substreams(sess, object);
+    }
     rtp_ctx.destroy_session(sess);
 
     return EXIT_SUCCESS;
@@ -120,9 +115,9 @@ int receiver(std::string local_address, int local_port, std::string remote_addre
 
 int main(int argc, char **argv)
 {
-    if (argc != 7) {
+    if (argc < 7 || argc > 9) {
         fprintf(stderr, "usage: ./%s <local address> <local port> <remote address> <remote port> \
-            <format> <srtp>\n", __FILE__);
+            <format> <srtp> [sub-bitstream layout|default] [number of objects]\n", __FILE__);
         return EXIT_FAILURE;
     }
 
@@ -133,6 +128,19 @@ int main(int argc, char **argv)
     //bool vvc_enabled = get_vvc_state(argv[5]);
     //bool atlas_enabled = get_atlas_state(argv[5]);
     srtp_enabled = get_srtp_state(argv[6]);
+    int objects = (argc == 9) ? atoi(argv[8]) : 1;
+
+    // The layout is printed by the sender. Without it, the default AD/OVD/GVD/AVD layout is used
+    bool default_layout = argc < 8 || std::string(argv[7]) == "default";
+    std::vector<v3c_substream_key> keys = default_layout ? get_default_v3c_layout() : parse_v3c_layout(argv[7]);
+    if (keys.empty()) {
+        return EXIT_FAILURE;
+    }
+
+    if (objects < 1 || objects > V3C_MAX_OBJECTS) {
+        std::cerr << "The number of objects must be between 1 and " << V3C_MAX_OBJECTS << std::endl;
+        return EXIT_FAILURE;
+    }
 
-    return receiver(local_address, local_port, remote_address, remote_port);
+    return receiver(local_address, local_port, remote_address, remote_port, keys, objects);
 }
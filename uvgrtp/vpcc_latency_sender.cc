@@ -10,17 +10,35 @@
 #include <string>
 #include <chrono>
 #include <vector>
-
-// Send and receive times for each stream
-std::vector<long long> ad_send = {};
-std::vector<long long> ovd_send = {};
-std::vector<long long> gvd_send = {};
-std::vector<long long> avd_send = {};
-    
-std::vector<long long> ad_recv = {};
-std::vector<long long> ovd_recv = {};
-std::vector<long long> gvd_recv = {};
-std::vector<long long> avd_recv = {};
+#include <map>
+#include <fstream>
+
+// Release time of each V3C frame
+std::vector<long long> frame_release = {};
+
+// Receive time and size of an echoed NAL unit. The size is used to match it to the sent NAL unit
+struct nal_recv {
+    long long time = 0;
+    size_t size = 0;
+};
+
+// Send and receive times of the logged NAL units of one sub-bitstream
+struct component_times {
+    int fmt = 0;
+    std::vector<long long> send = {};
+    std::vector<nal_recv> recv = {};
+};
+
+// Reception of one sub-bitstream of a V3C frame
+struct component_frame {
+    bool has_nals = false;  // false if the frame has no logged NAL units in this sub-bitstream
+    bool lost = false;      // true if any logged NAL unit of the frame was lost
+    long long done = 0;     // receive time of the last NAL unit of the frame
+};
+
+// Component latencies are collected into 1 ms buckets. The last bucket holds everything above
+constexpr long long HISTOGRAM_BUCKET_US = 1000;
+constexpr size_t HISTOGRAM_BUCKETS = 50;
 
 // encryption parameters
 enum Key_length{SRTP_128 = 128, SRTP_196 = 196, SRTP_256 = 256};
@@ -31,49 +49,97 @@ constexpr int SALT_SIZE_BYTES = SALT_S/8;
 
 bool srtp_enabled = false;
 
-void sender_func(uvgrtp::media_stream* stream, const char* cbuf, int fmt, float fps, const std::vector<v3c_unit_info> &units,
-    std::vector<long long> &send_times);
+void sender_func(uvgrtp::media_stream* stream, const char* cbuf, int fmt, const std::vector<v3c_frame> &frames,
+    size_t component, v3c_frame_release &release, std::vector<long long> &send_times);
 
-static void ad_hook(void *arg, uvg_rtp::frame::rtp_frame *frame)
+static void hook(void *arg, uvg_rtp::frame::rtp_frame *frame)
 {
-    (void)arg;
+    component_times* times = (component_times*)arg;
     uint8_t nalu_t = (frame->payload[0] >> 1) & 0x3f;
-    if(nalu_t < 36 ) { // Atlas streams: only log time for ACL NAL units
-        ad_recv.push_back(get_current_time());
+    if (!is_v3c_param_set(times->fmt, nalu_t)) { // Only log time for non-parameter set NAL units
+        times->recv.push_back({ get_current_time(), frame->payload_len });
     }
     (void)uvg_rtp::frame::dealloc_frame(frame);
 }
-static void ovd_hook(void *arg, uvg_rtp::frame::rtp_frame *frame)
+
+/* Match the receive times of a sub-bitstream to the sent NAL units and find when each frame was completed.
+ * The NAL units are echoed back in order, so a sent NAL unit whose size does not match the next received
+ * one was lost */
+static std::vector<component_frame> match_component_frames(const char* cbuf, const std::vector<v3c_frame>& frames,
+    size_t component, const component_times& times, size_t& lost_nals)
 {
-    (void)arg;
-    uint8_t nalu_t = (frame->payload[0] >> 1) & 0x3f;
-    if (nalu_t < 32 || nalu_t > 34) { // HEVC streams: only log time for VCL NAL units
-        ovd_recv.push_back(get_current_time());
+    std::vector<component_frame> result(frames.size());
+    size_t r = 0;
+
+    for (size_t f = 0; f < frames.size(); ++f) {
+        for (auto& nal : frames.at(f).nals.at(component)) {
+            uint8_t nalu_t = (((uint8_t*)cbuf)[nal.location] >> 1) & 0x3f;
+            if (is_v3c_param_set(times.fmt, nalu_t)) {
+                continue;
+            }
+            result.at(f).has_nals = true;
+
+            if (r == times.recv.size() || times.recv.at(r).size != nal.size) {
+                result.at(f).lost = true;
+                ++lost_nals;
+                continue;
+            }
+            result.at(f).done = std::max(result.at(f).done, times.recv.at(r).time);
+            ++r;
+        }
     }
-    (void)uvg_rtp::frame::dealloc_frame(frame);
+    return result;
 }
-static void gvd_hook(void *arg, uvg_rtp::frame::rtp_frame *frame)
+
+// Write <count>;<avg>;<p50>;<p95>;<p99>;<max> in ms followed by the histogram bucket counts
+static void write_latency_distribution(std::ofstream& file, std::vector<long long>& latencies)
 {
-    (void)arg;
-    uint8_t nalu_t = (frame->payload[0] >> 1) & 0x3f;
-    if (nalu_t < 32 || nalu_t > 34) { // HEVC streams: only log time for VCL NAL units
-        gvd_recv.push_back(get_current_time());
+    std::sort(latencies.begin(), latencies.end());
+    std::vector<size_t> histogram(HISTOGRAM_BUCKETS, 0);
+    float total = 0;
+
+    for (auto l : latencies) {
+        histogram.at(std::min((size_t)(l / HISTOGRAM_BUCKET_US), HISTOGRAM_BUCKETS - 1))++;
+        total += l;
     }
-    (void)uvg_rtp::frame::dealloc_frame(frame);
-}
-static void avd_hook(void *arg, uvg_rtp::frame::rtp_frame *frame)
-{
-    (void)arg;
-    uint8_t nalu_t = (frame->payload[0] >> 1) & 0x3f;
-    if (nalu_t < 32 || nalu_t > 34) { // HEVC streams: only log time for VCL NAL units
-        avd_recv.push_back(get_current_time());
+
+    auto percentile = [&latencies](float p) {
+        return latencies.empty() ? 0.f : latencies.at(std::min(latencies.size() - 1, (size_t)(p * latencies.size()))) / 1000.f;
+    };
+
+    file << latencies.size() << ";" << (latencies.empty() ? 0.f : total / 1000 / latencies.size()) << ";" << percentile(0.5f)
+        << ";" << percentile(0.95f) << ";" << percentile(0.99f) << ";" << (latencies.empty() ? 0.f : latencies.back() / 1000.f);
+
+    for (auto h : histogram) {
+        file << ";" << h;
     }
-    (void)uvg_rtp::frame::dealloc_frame(frame);
+    file << std::endl;
 }
 
 static int sender(std::string input_file, std::string local_address, int local_port, 
-    std::string remote_address, int remote_port, float fps)
+    std::string remote_address, int remote_port, float fps, int objects)
 {
+    size_t len = 0;
+    void* mem = get_mem(input_file, len);
+    if (mem == nullptr) {
+        return EXIT_FAILURE;
+    }
+    v3c_file_map mmap;
+
+    mmap_v3c_file((char*)mem, len, mmap);
+    char* cbuf = (char*)mem;
+
+    // Every sub-bitstream in the file is sent in its own media stream, the same as in vpcc_sender
+    std::map<v3c_substream_key, std::vector<v3c_unit_info>> units = get_v3c_substreams(mmap);
+    std::vector<v3c_substream_key> keys = {};
+    std::vector<const std::vector<v3c_unit_info>*> components = {};
+
+    for (auto& u : units) {
+        keys.push_back(u.first);
+        components.push_back(&u.second);
+    }
+    std::cout << "V3C sub-bitstream layout: " << v3c_layout_to_string(keys) << std::endl;
+
     uvgrtp::context rtp_ctx;
     uvgrtp::session* sess = rtp_ctx.create_session(remote_address, local_address);
 
@@ -81,7 +147,20 @@ static int sender(std::string input_file, std::string local_address, int local_p
     if (srtp_enabled) {
         flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_KEYSIZE_256;
     }
-    v3c_streams streams = init_v3c_streams(sess, local_port, remote_port, flags, false);
+
+    // Every object has its own set of media streams with its own ports and SSRCs
+    std::vector<std::vector<v3c_substream>> substreams(objects);
+    for (int o = 0; o < objects; ++o) {
+        substreams.at(o) = init_v3c_substreams(sess, local_port, remote_port, flags, false, keys, o);
+
+        if (substreams.at(o).empty()) {
+            for (auto& s : substreams) {
+                destroy_v3c_substreams(sess, s);
+            }
+            rtp_ctx.destroy_session(sess);
+            return EXIT_FAILURE;
+        }
+    }
 
     if (srtp_enabled) {
         std::cout << "SRTP enabled" << std::endl;
@@ -95,188 +174,195 @@ static int sender(std::string input_file, std::string local_address, int local_p
         for (int i = 0; i < SALT_SIZE_BYTES; ++i)
             salt[i] = i * 2;
 
-        streams.ad->add_srtp_ctx(key, salt);
-        streams.ovd->add_srtp_ctx(key, salt);
-        streams.gvd->add_srtp_ctx(key, salt);
-        streams.avd->add_srtp_ctx(key, salt);
+        for (auto& object : substreams) {
+            for (auto& s : object) {
+                s.stream->add_srtp_ctx(key, salt);
+            }
+        }
     }
+    std::cout << "Starting latency send test with VPCC file, " << objects << " object(s)" << std::endl;
 
-    size_t len = 0;
-    void* mem = get_mem(input_file, len);
-    if (mem == nullptr) {
-        return EXIT_FAILURE;
+    // times.at(o).at(c) holds the times of component c of object o
+    std::vector<std::vector<component_times>> times(objects, std::vector<component_times>(keys.size()));
+
+    for (int o = 0; o < objects; ++o) {
+        for (size_t c = 0; c < keys.size(); ++c) {
+            times.at(o).at(c).fmt = keys.at(c).vuh_unit_type;
+            substreams.at(o).at(c).stream->install_receive_hook(&times.at(o).at(c), hook);
+        }
     }
-    v3c_file_map mmap;
 
-    mmap_v3c_file((char*)mem, len, mmap);
-    char* cbuf = (char*)mem;
-    std::cout << "Starting latency send test with VPCC file" << std::endl;
-    
-    streams.ad->install_receive_hook(nullptr, ad_hook);
-    streams.ovd->install_receive_hook(nullptr, ovd_hook);
-    streams.gvd->install_receive_hook(nullptr, gvd_hook);
-    streams.avd->install_receive_hook(nullptr, avd_hook);
+    // NAL units of all sub-bitstreams are grouped into V3C frames and released on a common deadline
+    std::vector<v3c_frame> frames = group_v3c_frames(cbuf, components);
+    v3c_frame_release release;
+
+    /* Start sending data, all objects stream the same file */
+    std::vector<std::unique_ptr<std::thread>> threads;
+    for (int o = 0; o < objects; ++o) {
+        for (size_t c = 0; c < keys.size(); ++c) {
+            threads.push_back(std::unique_ptr<std::thread>(new std::thread(sender_func, substreams.at(o).at(c).stream, cbuf,
+                times.at(o).at(c).fmt, std::ref(frames), c, std::ref(release), std::ref(times.at(o).at(c).send))));
+        }
+    }
 
     // Sleep a moment to make sure that the receiver is ready
     std::this_thread::sleep_for(std::chrono::milliseconds(40)); 
 
-    /* Start sending data */
-    std::unique_ptr<std::thread> ad_thread =
-        std::unique_ptr<std::thread>(new std::thread(sender_func, streams.ad, cbuf, V3C_AD, fps, mmap.ad_units, std::ref(ad_send)));
-
-    std::unique_ptr<std::thread> ovd_thread =
-        std::unique_ptr<std::thread>(new std::thread(sender_func, streams.ovd, cbuf, V3C_OVD, fps, mmap.ovd_units, std::ref(ovd_send)));
-
-    std::unique_ptr<std::thread> gvd_thread =
-        std::unique_ptr<std::thread>(new std::thread(sender_func, streams.gvd, cbuf, V3C_GVD, fps, mmap.gvd_units, std::ref(gvd_send)));
-
-    std::unique_ptr<std::thread> avd_thread =
-        std::unique_ptr<std::thread>(new std::thread(sender_func, streams.avd, cbuf, V3C_AVD, fps, mmap.avd_units, std::ref(avd_send)));
+    schedule_v3c_frames(release, frames.size(), fps, &frame_release);
 
-
-    if (ad_thread && ad_thread->joinable())
-    {
-        ad_thread->join();
-    }
-    if (ovd_thread && ovd_thread->joinable())
-    {
-        ovd_thread->join();
-    }
-    if (gvd_thread && gvd_thread->joinable())
-    {
-        gvd_thread->join();
-    }
-    if (avd_thread && avd_thread->joinable())
-    {
-        avd_thread->join();
+    for (auto& t : threads) {
+        if (t && t->joinable())
+        {
+            t->join();
+        }
     }
 
     // just so we don't exit before last frame has arrived. Does not affect results
     std::this_thread::sleep_for(std::chrono::milliseconds(400)); 
     
-    sess->destroy_stream(streams.ad);
-    sess->destroy_stream(streams.ovd);
-    sess->destroy_stream(streams.gvd);
-    sess->destroy_stream(streams.avd);
+    for (auto& object : substreams) {
+        destroy_v3c_substreams(sess, object);
+    }
     rtp_ctx.destroy_session(sess);
 
-    /* Debug prints
-    std::cout << "ad_send size " << ad_send.size() << " ad_recv size " << ad_recv.size() << std::endl;
-    std::cout << "ovd_send size " << ovd_send.size() << " ovd_recv size " << ovd_recv.size() << std::endl;
-    std::cout << "gvd_send size " << gvd_send.size() << " gvd_recv size " << gvd_recv.size() << std::endl;
-    std::cout << "avd_send size " << avd_send.size() << " avd_recv size " << avd_recv.size() << std::endl;*/
-
-    // Check for frame loss
-    if(ad_send.size() !=  ad_recv.size() ||
-        ovd_send.size() !=  ovd_recv.size() ||
-        gvd_send.size() !=  gvd_recv.size() ||
-        avd_send.size() !=  avd_recv.size() ) 
-    {
-        std::cout << "Frame loss, writing 0, to be ignored" << std::endl;
+    /* Full-frame latency of each object. Frames where any NAL unit was lost are not complete and are left out
+     * of the full-frame latency, but the other sub-bitstreams of those frames are still accounted for.
+     * If no frame was received in full, 0 is written and the round is ignored */
+    int full_frames = 0;
+    float total_time = 0;
+    std::ofstream object_results;
+    std::ofstream component_results;
+    object_results.open("latency_results_objects", std::ios::out | std::ios::app | std::ios::ate);
+    component_results.open("latency_results_components", std::ios::out | std::ios::app | std::ios::ate);
+
+    for (int o = 0; o < objects; ++o) {
+        std::vector<std::vector<component_frame>> received(keys.size());
+        std::vector<size_t> lost_nals(keys.size(), 0);
+
+        for (size_t c = 0; c < keys.size(); ++c) {
+            received.at(c) = match_component_frames(cbuf, frames, c, times.at(o).at(c), lost_nals.at(c));
+        }
+
+        // Latencies of each component and the number of frames where the component was the last one to complete
+        std::vector<std::vector<long long>> component_latencies(keys.size());
+        std::vector<size_t> critical_path(keys.size(), 0);
+        size_t object_frames = 0;
+        size_t partial_frames = 0;
+        float object_time = 0;
+        long long object_max = 0;
+
+        for (size_t i = 0; i < frames.size(); ++i) {
+            // All components of a V3C frame are released together
+            long long full_frame_send_time = frame_release.at(i);
+
+            // Find the time when reception of a full frame was completed, i.e. the last NAL unit of the frame in any component
+            long long full_frame_recv_time = full_frame_send_time;
+            size_t last_component = 0;
+            bool complete = true;
+
+            for (size_t c = 0; c < keys.size(); ++c) {
+                component_frame& cf = received.at(c).at(i);
+                if (!cf.has_nals) {
+                    continue;
+                }
+                if (cf.lost) {
+                    complete = false;
+                    continue;
+                }
+                component_latencies.at(c).push_back(cf.done - full_frame_send_time);
+
+                if (cf.done > full_frame_recv_time) {
+                    full_frame_recv_time = cf.done;
+                    last_component = c;
+                }
+            }
+
+            if (!complete) {
+                ++partial_frames;
+                continue;
+            }
+
+            long long diff_between_full_frames = full_frame_recv_time - full_frame_send_time;
+            object_time += diff_between_full_frames;
+            object_max = std::max(object_max, diff_between_full_frames);
+            critical_path.at(last_component)++;
+            ++object_frames;
+        }
+
+        // <object>;<unit type>;<lost NAL units>;<frames on critical path>;<latency distribution>
+        for (size_t c = 0; c < keys.size(); ++c) {
+            component_results << o << ";" << (uint32_t)keys.at(c).vuh_unit_type << ";" << lost_nals.at(c) << ";"
+                << critical_path.at(c) << ";";
+            write_latency_distribution(component_results, component_latencies.at(c));
+
+            std::cout << "Object " << o << ", V3C unit type " << (uint32_t)keys.at(c).vuh_unit_type << ": "
+                << lost_nals.at(c) << " NAL units lost, last to complete in " << critical_path.at(c) << " frames" << std::endl;
+        }
+
+        if (partial_frames > 0) {
+            std::cout << "Object " << o << ": " << partial_frames << " frames received partially" << std::endl;
+        }
+
+        // <object>;<full frames>;<average latency ms>;<maximum latency ms>
+        object_results << o << ";" << object_frames << ";" << (object_frames ? object_time / 1000 / (float)object_frames : 0)
+            << ";" << object_max / 1000.f << std::endl;
+        if (objects > 1) {
+            std::cout << "Object " << o << ": full frames " << object_frames << ", average latency "
+                << (object_frames ? object_time / 1000 / (float)object_frames : 0) << " ms" << std::endl;
+        }
+
+        full_frames += object_frames;
+        total_time += object_time;
+    }
+    object_results.close();
+    component_results.close();
+
+    if (full_frames == 0) {
+        std::cout << "No full frames received, writing 0, to be ignored" << std::endl;
         write_latency_results_to_file("latency_results", 0, 0, 0, 0);
         return EXIT_SUCCESS;
     }
 
-    // No frame loss -> total number of transferred FULL frames is equal to ad_send.size() (or any other)
-    int full_frames = ad_send.size();
-    float total_time = 0;
-    for (auto i = 0; i < full_frames; ++i) {
-        // Find the time when a full frame was sent. For GVD and AVD its every fourth NAL unit send time, as a frame is composed of 4 NAL units
-        auto full_frame_send_time = find_earliest_time_point(ad_send.at(i),
-        ovd_send.at(i),
-        gvd_send.at((i)*4),
-        avd_send.at((i)*4));
-
-        // Find the time when reception of a full frame was completed
-        auto full_frame_recv_time = find_latest_time_point(ad_recv.at(i),
-        ovd_recv.at(i),
-        gvd_recv.at(i*4),
-        avd_recv.at(i*4));
-
-        long long diff_between_full_frames = full_frame_recv_time - full_frame_send_time;
-        total_time += diff_between_full_frames;
-    }
     std::cout << "full frames " << full_frames << ", total time " << total_time << std::endl;
     write_latency_results_to_file("latency_results", full_frames, total_time / 1000 / (float)full_frames, 0, 0);
 
     std::cout << "Ending latency send test with " << full_frames << " full frames received" << std::endl;
-
-    // DEBUG PRINTS
-    /*for(auto i = 0; i < avd_recv.size(); ++i) {
-        std::cout << i << " send " << avd_send.at(i) << " us recv " << avd_recv.at(i) << " us diff " << avd_recv.at(i) - avd_send.at(i) << " us" << std::en>
-    }*/
-    /*for(auto i = 0; i < avd_nals_s.size(); ++i) {
-        std::cout << i << " send " << avd_nals_s.at(i).send_time << " us recv " << avd_nals_r.at(i).recv_time << " us diff " << avd_nals_r.at(i).recv_time - avd_nals_s.at(i).send_time << " us " << "send nalu_t " << (uint32_t)avd_nals_s.at(i).nal_type << " recv nalu_t " << (uint32_t)avd_nals_r.at(i).nal_type <<
-        " send size " << avd_nals_s.at(i).nal_size << " recv size " << avd_nals_r.at(i).nal_size << std::endl;
-    }*/
     return EXIT_SUCCESS;
 }
 
-void sender_func(uvgrtp::media_stream* stream, const char* cbuf, int fmt, float fps, const std::vector<v3c_unit_info> &units,
-    std::vector<long long> &send_times)
+void sender_func(uvgrtp::media_stream* stream, const char* cbuf, int fmt, const std::vector<v3c_frame> &frames,
+    size_t component, v3c_frame_release &release, std::vector<long long> &send_times)
 {
-    uint64_t current_frame = 0;
-    uint64_t temp_nalu = 0; // GVD and AVD streams have 4 NAL units per frame. This variable is used to keep track of this
-    uint64_t period = (uint64_t)((1000 * 1000 / fps) );
     uint8_t* bytes = (uint8_t*)cbuf;
     rtp_error_t ret = RTP_OK;
-    bool param_set = false; // For parameter set NAL units, special treatment
 
     /* Sending logic goes as follows:
-    -Check NAL unit type:
+    -Wait for the frame scheduler to release the next V3C frame. All components share the same release deadline.
+    -Send the NAL units of this component that belong to the frame as fast as possible:
         -Parameter set NAL units: DO NOT log time, send unit and immediately proceed to the next NAL unit.
-        -AD or OVD stream: Each frame is composed of a single NAL unit. Log time, send unit and wait for the remaining interval depending on frame rate
-        -GVD or AVD stream: Each frame is composed of 4 NAL units. Log send time of first one and send the remaining 3 as fast
-         as possible. Then wait for the interval. Note: The send times of the remaining 3 also get logged, but only the first one is currently used in
-         calculations, as it is the "start" of the frame. */
-
-    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
-    for (auto& p : units) {
-        for (auto& i : p.nal_infos) {
-            param_set = false; // Check the type of this NAL unit
+        -Other NAL units: Log send time and send unit. The number of NAL units per frame is derived from the
+         bitstream (first slice flags), so the receive times can be matched to frames without assuming a constant. */
+
+    for (uint64_t f = 0; f < frames.size(); ++f) {
+        wait_for_v3c_frame(release, f);
+
+        for (auto& i : frames.at(f).nals.at(component)) {
             uint8_t nalu_t = (bytes[i.location] >> 1) & 0x3f;
-            if(fmt == V3C_AD && nalu_t > 35 ) { // Check if Atlas parameter set NAL unit 
-                param_set = true;
-            }
-            else if (nalu_t >= 32 && nalu_t <= 34) { // Check if video parameter set NAL unit 
-                param_set = true;
-            }
-            if(!param_set) {  // Only log send times for non-parameter set NAL units
+            if (!is_v3c_param_set(fmt, nalu_t)) {  // Only log send times for non-parameter set NAL units
                 send_times.push_back(get_current_time());
             }
             if ((ret = stream->push_frame(bytes + i.location, i.size, RTP_NO_H26X_SCL)) != RTP_OK) { // Send frame
                 std::cout << "Failed to send RTP frame!" << std::endl;
             }
-            if(param_set) { // If this is a parameter set NALU, immediately send the next NAL unit
-                continue;
-            }
-            temp_nalu++; // temp_nalu used to count the temporary 4 NAL units that make up a GVD or AVD frame
-            if (fmt == V3C_GVD || fmt == V3C_AVD) { // If this is GVD or AVD stream, send 4 frames as fast as we can, then wait for frame interval
-                if(temp_nalu < 4) {
-                    continue;
-                }
-                temp_nalu = 0;
-                current_frame += 1;
-            }
-            else {
-                temp_nalu = 0;
-                current_frame += 1;
-            }
-
-            // wait until is the time to send next latency test frame
-            auto runtime = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
-                std::chrono::high_resolution_clock::now() - start).count();
-
-            if (runtime < current_frame * period)
-                std::this_thread::sleep_for(std::chrono::microseconds(current_frame * period - runtime));
         }
     }
 }
 
 int main(int argc, char **argv)
 {
-    if (argc != 9) {
-        fprintf(stderr, "usage: ./%s <input file> <local address> <local port> <remote address> <remote port> <fps> <format> <srtp> \n", __FILE__);
+    if (argc != 9 && argc != 10) {
+        fprintf(stderr, "usage: ./%s <input file> <local address> <local port> <remote address> <remote port> <fps> <format> <srtp> \
+            [number of objects]\n", __FILE__);
         return EXIT_FAILURE;
     }
 
@@ -290,6 +376,12 @@ int main(int argc, char **argv)
     float fps                  = atof(argv[6]);
     //bool vvc_enabled           = get_vvc_state(argv[7]);
     srtp_enabled               = get_srtp_state(argv[8]);
+    int objects                = (argc == 10) ? atoi(argv[9]) : 1;
+
+    if (objects < 1 || objects > V3C_MAX_OBJECTS) {
+        std::cerr << "The number of objects must be between 1 and " << V3C_MAX_OBJECTS << std::endl;
+        return EXIT_FAILURE;
+    }
 
-    return sender(input_file, local_address, local_port, remote_address, remote_port, fps);
+    return sender(input_file, local_address, local_port, remote_address, remote_port, fps, objects);
 }
\ No newline at end of file
@@ -36,9 +36,9 @@ void hook(void* arg, uvg_rtp::frame::rtp_frame* frame);
 
 int main(int argc, char** argv)
 {
-    if (argc != 9) {
+    if (argc < 9 || argc > 11) {
         fprintf(stderr, "usage: ./%s <result file> <local address> <local port> <remote address> <remote port> \
-            <number of threads> <format> <srtp>\n", __FILE__);
+            <number of threads> <format> <srtp> [sub-bitstream layout|default] [number of objects]\n", __FILE__);
         return EXIT_FAILURE;
     }
 
@@ -53,7 +53,21 @@ int main(int argc, char** argv)
     //bool atlas_enabled  = get_atlas_state(argv[7]);
     srtp_enabled          = get_srtp_state(argv[8]);
 
-    std::cout << "Starting uvgRTP V-PCC receiver tests. " << local_address << ":" << local_port 
+    int objects           = (argc == 11) ? atoi(argv[10]) : 1;
+
+    // The layout is printed by the sender. Without it, the default AD/OVD/GVD/AVD layout is used
+    bool default_layout = argc < 10 || std::string(argv[9]) == "default";
+    std::vector<v3c_substream_key> keys = default_layout ? get_default_v3c_layout() : parse_v3c_layout(argv[9]);
+    if (keys.empty()) {
+        return EXIT_FAILURE;
+    }
+
+    if (objects < 1 || objects > V3C_MAX_OBJECTS) {
+        std::cerr << "The number of objects must be between 1 and " << V3C_MAX_OBJECTS << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Starting uvgRTP V-PCC receiver tests with " << objects << " object(s). " << local_address << ":" << local_port 
         << "<-" << remote_address << ":" << remote_port << std::endl;
 
     uvgrtp::context rtp_ctx;
@@ -63,7 +77,20 @@ int main(int argc, char** argv)
     if (srtp_enabled) {
         flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_KEYSIZE_256;
     }
-    v3c_streams streams = init_v3c_streams(sess, local_port, remote_port, flags, true);
+
+    // Every object has its own set of media streams with its own ports and SSRCs
+    std::vector<std::vector<v3c_substream>> substreams(objects);
+    for (int o = 0; o < objects; ++o) {
+        substreams.at(o) = init_v3c_substreams(sess, local_port, remote_port, flags, true, keys, o);
+
+        if (substreams.at(o).empty()) {
+            for (auto& s : substreams) {
+                destroy_v3c_substreams(sess, s);
+            }
+            rtp_ctx.destroy_session(sess);
+            return EXIT_FAILURE;
+        }
+    }
 
     if (srtp_enabled) {
         std::cout << "SRTP enabled" << std::endl;
@@ -77,21 +104,22 @@ int main(int argc, char** argv)
         for (int i = 0; i < SALT_SIZE_BYTES; ++i)
             salt[i] = i * 2;
 
-        streams.ad->add_srtp_ctx(key, salt);
-        streams.ovd->add_srtp_ctx(key, salt);
-        streams.gvd->add_srtp_ctx(key, salt);
-        streams.avd->add_srtp_ctx(key, salt);
+        for (auto& object : substreams) {
+            for (auto& s : object) {
+                s.stream->add_srtp_ctx(key, salt);
+            }
+        }
     }
 
-    stream_results ad_r;
-    stream_results ovd_r;
-    stream_results gvd_r;
-    stream_results avd_r;
+    std::vector<std::vector<stream_results>> results(objects);
+
+    for (int o = 0; o < objects; ++o) {
+        results.at(o).resize(substreams.at(o).size());
 
-    streams.ad->install_receive_hook(&ad_r, hook);
-    streams.ovd->install_receive_hook(&ovd_r, hook);
-    streams.gvd->install_receive_hook(&gvd_r, hook);
-    streams.avd->install_receive_hook(&avd_r, hook);
+        for (size_t i = 0; i < substreams.at(o).size(); ++i) {
+            substreams.at(o).at(i).stream->install_receive_hook(&results.at(o).at(i), hook);
+        }
+    }
     
     while (frame_received)
     {
@@ -100,20 +128,45 @@ int main(int argc, char** argv)
     }
     std::cout << "No more frames received for " << TIMEOUT << " ms, end round" << std::endl;
 
-    sess->destroy_stream(streams.ad);
-    sess->destroy_stream(streams.ovd);
-    sess->destroy_stream(streams.gvd);
-    sess->destroy_stream(streams.avd);
+    for (auto& object : substreams) {
+        destroy_v3c_substreams(sess, object);
+    }
     rtp_ctx.destroy_session(sess);
 
-    // Calculate results
-    long long start = find_earliest_time_point(ad_r.start, ovd_r.start, gvd_r.start, avd_r.start);
-    long long end   = find_latest_time_point(ad_r.last, ovd_r.last, gvd_r.last, avd_r.last);
+    /* Calculate results. The result file gets the aggregate of all objects.
+     * Sub-bitstreams that received nothing do not affect the timing */
+    long long start = 0;
+    long long end   = 0;
+    size_t total_packets_received = 0;
+    size_t total_bytes_received = 0;
+
+    for (int o = 0; o < objects; ++o) {
+        long long object_start = 0;
+        long long object_end   = 0;
+        size_t object_bytes_received = 0;
+
+        for (auto& r : results.at(o)) {
+            if (r.packets_received == 0) {
+                continue;
+            }
+            object_start = (object_start == 0) ? r.start : std::min(object_start, r.start);
+            object_end   = std::max(object_end, r.last);
+            object_bytes_received += r.bytes_received;
+            total_packets_received += r.packets_received;
+        }
+        if (objects > 1) {
+            std::cout << "Object " << o << ": " << object_bytes_received << " bytes in " << (object_end - object_start) / 1000
+                << " ms" << std::endl;
+        }
+
+        if (object_bytes_received > 0) {
+            start = (start == 0) ? object_start : std::min(start, object_start);
+            end   = std::max(end, object_end);
+        }
+        total_bytes_received += object_bytes_received;
+    }
     long long diff = end - start;
 
-    size_t total_packets_received = ad_r.packets_received + ovd_r.packets_received + gvd_r.packets_received + avd_r.packets_received;
-    size_t total_bytes_received = ad_r.bytes_received + ovd_r.bytes_received + gvd_r.bytes_received + avd_r.bytes_received;
-
     write_receive_results_to_file(result_filename, total_bytes_received, total_packets_received, diff);
 
     return EXIT_SUCCESS;
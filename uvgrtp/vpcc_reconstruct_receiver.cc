@@ -0,0 +1,273 @@
+#include "uvgrtp_util.hh"
+#include "v3c_util.hh"
+#include "../util/util.hh"
+
+#include <uvgrtp/lib.hh>
+#include <uvgrtp/clock.hh>
+
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+int TIMEOUT = 1000;
+
+bool srtp_enabled = false;
+
+// encryption parameters
+enum Key_length{SRTP_128 = 128, SRTP_196 = 196, SRTP_256 = 256};
+constexpr Key_length KEY_S = SRTP_256;
+constexpr int KEY_SIZE_BYTES = KEY_S/8;
+constexpr int SALT_S = 112;
+constexpr int SALT_SIZE_BYTES = SALT_S/8;
+
+/* Received NAL units of one sub-bitstream. The reference file stands in for the information that would be
+ * signaled out of band (V3C parameter sets, V3C unit headers and the number of NAL units in each V3C unit) */
+struct component_state {
+    std::vector<v3c_unit_info>* units = nullptr;         // Received V3C units
+    const std::vector<v3c_unit_info>* ref = nullptr;     // V3C units of the reference file
+    size_t packets_received = 0;
+    size_t bytes_received = 0;
+    long long start = 0;
+    long long last = 0;
+};
+
+std::atomic<bool> frame_received(true);
+
+void hook(void* arg, uvgrtp::frame::rtp_frame* frame);
+
+int main(int argc, char **argv)
+{
+    if (argc != 10 && argc != 11) {
+        fprintf(stderr, "usage: ./%s <result file> <local address> <local port> <remote address> <remote port> \
+            <number of threads> <format> <srtp> <reference file> [output file]\n", __FILE__);
+        return EXIT_FAILURE;
+    }
+
+    std::string result_filename = argv[1];
+    std::string local_address   = argv[2];
+    int local_port              = atoi(argv[3]);
+    std::string remote_address  = argv[4];
+    int remote_port             = atoi(argv[5]);
+
+    //int nthreads               = atoi(argv[6]);
+    srtp_enabled                = get_srtp_state(argv[8]);
+    std::string reference_file  = argv[9];
+    std::string output_file     = (argc == 11) ? argv[10] : "";
+
+    size_t len = 0;
+    void* mem = get_mem(reference_file, len);
+    if (mem == nullptr) {
+        return EXIT_FAILURE;
+    }
+    char* cbuf = (char*)mem;
+    v3c_file_map ref;
+    mmap_v3c_file(cbuf, len, ref);
+
+    // reconstruct_v3c_gop() builds GoPs of AD, OVD, GVD and AVD units, i.e. the default layout
+    std::vector<v3c_substream_key> keys = {};
+    for (auto& u : get_v3c_substreams(ref)) {
+        keys.push_back(u.first);
+    }
+    std::string layout = v3c_layout_to_string(keys);
+    if (layout != v3c_layout_to_string(get_default_v3c_layout())) {
+        std::cerr << "Only the default V3C sub-bitstream layout can be reconstructed, " << reference_file
+            << " has the layout " << layout << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Starting uvgRTP V-PCC reconstruction receiver. " << local_address << ":" << local_port
+        << "<-" << remote_address << ":" << remote_port << std::endl;
+
+    uvgrtp::context rtp_ctx;
+    uvgrtp::session* sess = rtp_ctx.create_session(remote_address, local_address);
+
+    int flags = 0;
+    if (srtp_enabled) {
+        flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_KEYSIZE_256;
+    }
+
+    std::vector<v3c_substream> substreams = init_v3c_substreams(sess, local_port, remote_port, flags, true, keys);
+    if (substreams.empty()) {
+        rtp_ctx.destroy_session(sess);
+        return EXIT_FAILURE;
+    }
+
+    if (srtp_enabled) {
+        std::cout << "SRTP enabled" << std::endl;
+        uint8_t key[KEY_SIZE_BYTES]   = { 0 };
+        uint8_t salt[SALT_SIZE_BYTES] = { 0 };
+
+        // initialize SRTP key and salt with dummy values
+        for (int i = 0; i < KEY_SIZE_BYTES; ++i)
+            key[i] = i;
+
+        for (int i = 0; i < SALT_SIZE_BYTES; ++i)
+            salt[i] = i * 2;
+
+        for (auto& s : substreams) {
+            s.stream->add_srtp_ctx(key, salt);
+        }
+    }
+
+    v3c_file_map rec;
+    std::vector<component_state> states = {
+        { &rec.ad_units, &ref.ad_units }, { &rec.ovd_units, &ref.ovd_units },
+        { &rec.gvd_units, &ref.gvd_units }, { &rec.avd_units, &ref.avd_units } };
+
+    for (size_t i = 0; i < substreams.size(); ++i) {
+        substreams.at(i).stream->install_receive_hook(&states.at(i), hook);
+    }
+
+    while (frame_received)
+    {
+        frame_received = false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(TIMEOUT));
+    }
+    std::cout << "No more frames received for " << TIMEOUT << " ms, end round" << std::endl;
+
+    destroy_v3c_substreams(sess, substreams);
+    rtp_ctx.destroy_session(sess);
+
+    // Network receive results, the same as in vpcc_receiver
+    long long start = 0;
+    long long end   = 0;
+    size_t total_packets_received = 0;
+    size_t total_bytes_received = 0;
+
+    for (auto& s : states) {
+        if (s.packets_received == 0) {
+            continue;
+        }
+        start = (start == 0) ? s.start : std::min(start, s.start);
+        end   = std::max(end, s.last);
+        total_packets_received += s.packets_received;
+        total_bytes_received += s.bytes_received;
+    }
+    write_receive_results_to_file(result_filename, total_bytes_received, total_packets_received, end - start);
+
+    /* The VPS units are not sent over RTP. Take them from the reference file */
+    for (auto& vps : ref.vps_units) {
+        v3c_unit_info unit = { vps.header, {}, 0, true };
+        unit.nal_infos.push_back({ 0, vps.nal_infos.at(0).size, cbuf + vps.nal_infos.at(0).location });
+        rec.vps_units.push_back(unit);
+    }
+
+    // Only complete GoPs are reconstructed. Sizes are known beforehand, so the output is written into one buffer
+    uint64_t gops = 0;
+    uint64_t output_size = 0;
+    while (gops < ref.vps_units.size() && is_gop_ready(gops, rec)) {
+        output_size += get_gop_size(gops == 0, gops, rec);
+        ++gops;
+    }
+
+    char* output = new char[output_size];
+    uint64_t ptr = 0;
+    std::vector<uint64_t> gop_offsets = {};
+
+    long long reconstruct_start = get_current_time();
+    for (uint64_t i = 0; i < gops; ++i) {
+        gop_offsets.push_back(ptr);
+        reconstruct_v3c_gop(i == 0, output, ptr, rec, i);
+    }
+    long long reconstruct_time = get_current_time() - reconstruct_start;
+    gop_offsets.push_back(ptr);
+
+    /* create_v3c_unit() frees the received NAL units of the reconstructed GoPs. Free the ones left in
+     * incomplete GoPs, the reconstructed units still hold their freed pointers and are skipped */
+    for (auto units : { &rec.ad_units, &rec.ovd_units, &rec.gvd_units, &rec.avd_units }) {
+        for (size_t u = gops; u < units->size(); ++u) {
+            for (auto& nal : units->at(u).nal_infos) {
+                delete[] nal.buf;
+                nal.buf = nullptr;
+            }
+        }
+    }
+
+    /* Verify each GoP byte for byte. In the reference file, a GoP starts from the size field of its VPS unit,
+     * except for the first one which also has the sample stream header byte */
+    uint8_t v3c_size_precision = ((uint8_t)cbuf[0] >> 5) + 1;
+    uint64_t verified = 0;
+
+    for (uint64_t i = 0; i < gops; ++i) {
+        uint64_t ref_start = (i == 0) ? 0 : ref.vps_units.at(i).nal_infos.at(0).location - v3c_size_precision;
+        uint64_t ref_end   = (i + 1 < ref.vps_units.size()) ?
+            ref.vps_units.at(i + 1).nal_infos.at(0).location - v3c_size_precision : len;
+        uint64_t rec_size  = gop_offsets.at(i + 1) - gop_offsets.at(i);
+
+        if (rec_size != ref_end - ref_start) {
+            std::cout << "GoP " << i << ": reconstructed " << rec_size << " bytes, expected " << ref_end - ref_start << std::endl;
+            continue;
+        }
+
+        auto mismatch = std::mismatch(output + gop_offsets.at(i), output + gop_offsets.at(i + 1), cbuf + ref_start);
+        if (mismatch.first != output + gop_offsets.at(i + 1)) {
+            std::cout << "GoP " << i << ": first difference at byte " << mismatch.second - cbuf << " of the reference file" << std::endl;
+            continue;
+        }
+        ++verified;
+    }
+
+    if (!output_file.empty()) {
+        std::ofstream out(output_file, std::ios::out | std::ios::binary);
+        out.write(output, ptr);
+        out.close();
+    }
+    delete[] output;
+
+    // <GoPs in file>;<GoPs reconstructed>;<GoPs verified>;<bytes>;<reconstruction time ms>;<GoPs/s>;<MB/s>
+    float reconstruct_s = reconstruct_time / 1000000.f;
+    std::string reconstruct_results = result_filename + "_reconstruction";
+    std::ofstream result_file(reconstruct_results, std::ios::out | std::ios::app | std::ios::ate);
+    result_file << ref.vps_units.size() << ";" << gops << ";" << verified << ";" << ptr << ";" << reconstruct_time / 1000.f
+        << ";" << (reconstruct_s > 0 ? gops / reconstruct_s : 0) << ";" << (reconstruct_s > 0 ? ptr / 1000000.f / reconstruct_s : 0)
+        << std::endl;
+    result_file.close();
+
+    std::cout << "Reconstructed " << gops << "/" << ref.vps_units.size() << " GoPs (" << ptr << " bytes) in "
+        << reconstruct_time / 1000.f << " ms, " << verified << " GoPs identical to " << reference_file << std::endl;
+
+    return EXIT_SUCCESS;
+}
+
+void hook(void* arg, uvgrtp::frame::rtp_frame* frame)
+{
+    component_state* state = (component_state*)arg;
+
+    if (!frame) {
+        std::cerr << "Receiver test failed!" << std::endl;
+        return;
+    }
+
+    if (state->packets_received == 0) {
+        state->start = get_current_time();
+    }
+    state->last = get_current_time();
+    state->bytes_received += frame->payload_len;
+    state->packets_received++;
+    frame_received = true;
+
+    // Start the next V3C unit once the current one has all of its NAL units
+    std::vector<v3c_unit_info>* units = state->units;
+    if (units->empty() || units->back().ready) {
+        if (units->size() == state->ref->size()) {
+            (void)uvg_rtp::frame::dealloc_frame(frame);
+            return;
+        }
+        units->push_back({ state->ref->at(units->size()).header, {}, 0, false });
+    }
+
+    char* buf = new char[frame->payload_len];
+    memcpy(buf, frame->payload, frame->payload_len);
+    units->back().nal_infos.push_back({ units->back().ptr, frame->payload_len, buf });
+    units->back().ptr += frame->payload_len;
+
+    if (units->back().nal_infos.size() == state->ref->at(units->size() - 1).nal_infos.size()) {
+        units->back().ready = true;
+    }
+    (void)uvg_rtp::frame::dealloc_frame(frame);
+}
@@ -11,6 +11,7 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <map>
 
 struct stream_results { // Save stats of each stream
     size_t bytes_sent = 0;
@@ -25,20 +26,29 @@ constexpr int KEY_SIZE_BYTES = KEY_S/8;
 constexpr int SALT_S = 112;
 constexpr int SALT_SIZE_BYTES = SALT_S/8;
 
+// A mapped input file, shared by all objects that stream it
+struct v3c_input {
+    char* cbuf = nullptr;
+    std::map<v3c_substream_key, std::vector<v3c_unit_info>> units = {};
+    std::vector<v3c_substream_key> keys = {};
+    std::vector<v3c_frame> frames = {};
+};
+
 bool srtp_enabled = false;
 
-void sender_func(uvgrtp::media_stream* stream, const char* cbuf, int fmt, float fps, const std::vector<v3c_unit_info> &units,
-    stream_results &res);
+bool load_v3c_input(const std::string& filename, v3c_input& input);
+void sender_func(uvgrtp::media_stream* stream, const char* cbuf, float fps, const std::vector<v3c_frame> &frames,
+    size_t component, v3c_frame_release &release, stream_results &res);
 
 int main(int argc, char **argv)
 {
-    if (argc != 11) {
-        fprintf(stderr, "usage: ./%s <input file> <result file> <local address> <local port> <remote address> <remote port> \
-            <number of threads> <fps> <format> <srtp> \n", __FILE__);
+    if (argc != 11 && argc != 12) {
+        fprintf(stderr, "usage: ./%s <input file(s)> <result file> <local address> <local port> <remote address> <remote port> \
+            <number of threads> <fps> <format> <srtp> [number of objects]\n", __FILE__);
         return EXIT_FAILURE;
     }
 
-    std::string input_file     = argv[1];
+    std::string input_files    = argv[1];
     std::string result_file    = argv[2];
 
     std::string local_address  = argv[3];
@@ -50,10 +60,47 @@ int main(int argc, char **argv)
     //bool vvc_enabled           = get_vvc_state(argv[9]);
     //bool atlas_enabled         = get_atlas_state(argv[9]);
     srtp_enabled                 = get_srtp_state(argv[10]);
+    int objects                  = (argc == 12) ? atoi(argv[11]) : 1;
+
+    if (objects < 1 || objects > V3C_MAX_OBJECTS) {
+        std::cerr << "The number of objects must be between 1 and " << V3C_MAX_OBJECTS << std::endl;
+        return EXIT_FAILURE;
+    }
 
-    std::cout << "Starting uvgRTP V-PCC sender round. " << local_address << ":" << local_port
+    std::cout << "Starting uvgRTP V-PCC sender round with " << objects << " object(s). " << local_address << ":" << local_port
         << "->" << remote_address << ":" << remote_port << std::endl;
 
+    /* Each object streams one of the comma separated input files. If there are fewer files than objects,
+     * the files are reused so that the objects share the same mapped input */
+    std::vector<v3c_input> inputs;
+    size_t pos = 0;
+
+    while (pos < input_files.size()) {
+        size_t end = input_files.find(',', pos);
+        if (end == std::string::npos) {
+            end = input_files.size();
+        }
+        inputs.emplace_back();
+        if (!load_v3c_input(input_files.substr(pos, end - pos), inputs.back())) {
+            return EXIT_FAILURE;
+        }
+        pos = end + 1;
+    }
+
+    if (inputs.empty()) {
+        std::cerr << "No input files given" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // The receiver uses one layout for all objects
+    for (auto& input : inputs) {
+        if (v3c_layout_to_string(input.keys) != v3c_layout_to_string(inputs.front().keys)) {
+            std::cerr << "The input files have different sub-bitstream layouts" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::cout << "V3C sub-bitstream layout: " << v3c_layout_to_string(inputs.front().keys) << std::endl;
+
     uvgrtp::context rtp_ctx;
     uvgrtp::session* sess = rtp_ctx.create_session(remote_address, local_address);
 
@@ -61,7 +108,21 @@ int main(int argc, char **argv)
     if (srtp_enabled) {
         flags |= RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_KEYSIZE_256;
     }
-    v3c_streams streams = init_v3c_streams(sess, local_port, remote_port, flags, false);
+
+    // Every object has its own set of media streams with its own ports and SSRCs
+    std::vector<std::vector<v3c_substream>> substreams(objects);
+    for (int o = 0; o < objects; ++o) {
+        substreams.at(o) = init_v3c_substreams(sess, local_port, remote_port, flags, false,
+            inputs.at(o % inputs.size()).keys, o);
+
+        if (substreams.at(o).empty()) {
+            for (auto& s : substreams) {
+                destroy_v3c_substreams(sess, s);
+            }
+            rtp_ctx.destroy_session(sess);
+            return EXIT_FAILURE;
+        }
+    }
 
     if (srtp_enabled) {
         std::cout << "SRTP enabled" << std::endl;
@@ -75,147 +136,138 @@ int main(int argc, char **argv)
         for (int i = 0; i < SALT_SIZE_BYTES; ++i)
             salt[i] = i * 2;
 
-        streams.ad->add_srtp_ctx(key, salt);
-        streams.ovd->add_srtp_ctx(key, salt);
-        streams.gvd->add_srtp_ctx(key, salt);
-        streams.avd->add_srtp_ctx(key, salt);
+        for (auto& object : substreams) {
+            for (auto& s : object) {
+                s.stream->add_srtp_ctx(key, salt);
+            }
+        }
     }
 
-    size_t len = 0;
-    void* mem = get_mem(input_file, len);
-    if (mem == nullptr) {
-        return EXIT_FAILURE;
+    // All objects are released on a common deadline, so the frame rate is the same for every object
+    size_t frame_count = 0;
+    for (auto& input : inputs) {
+        frame_count = std::max(frame_count, input.frames.size());
     }
-    v3c_file_map mmap;
-
-    mmap_v3c_file((char*)mem, len, mmap);
-    char* cbuf = (char*)mem;
+    v3c_frame_release release;
 
-    stream_results ad_r  = {0,0,0};
-    stream_results ovd_r = {0,0,0};
-    stream_results gvd_r = {0,0,0};
-    stream_results avd_r = {0,0,0};
+    std::vector<std::vector<stream_results>> results(objects);
+    std::vector<std::unique_ptr<std::thread>> threads;
 
-   // Sleep a moment to make sure that the receiver is ready
-    std::this_thread::sleep_for(std::chrono::milliseconds(40)); 
-    
-        /* Start sending data */
-    std::unique_ptr<std::thread> ad_thread =
-        std::unique_ptr<std::thread>(new std::thread(sender_func, streams.ad, cbuf, V3C_AD, fps, mmap.ad_units, std::ref(ad_r)));
-
-    std::unique_ptr<std::thread> ovd_thread =
-        std::unique_ptr<std::thread>(new std::thread(sender_func, streams.ovd, cbuf, V3C_OVD, fps, mmap.ovd_units, std::ref(ovd_r)));
+    /* Start sending data, one thread per sub-bitstream of each object */
+    for (int o = 0; o < objects; ++o) {
+        v3c_input& input = inputs.at(o % inputs.size());
+        results.at(o).resize(substreams.at(o).size(), {0,0,0});
 
-    std::unique_ptr<std::thread> gvd_thread =
-        std::unique_ptr<std::thread>(new std::thread(sender_func, streams.gvd, cbuf, V3C_GVD, fps, mmap.gvd_units, std::ref(gvd_r)));
+        for (size_t i = 0; i < substreams.at(o).size(); ++i) {
+            threads.push_back(std::unique_ptr<std::thread>(new std::thread(sender_func, substreams.at(o).at(i).stream, input.cbuf,
+                fps, std::ref(input.frames), i, std::ref(release), std::ref(results.at(o).at(i)))));
+        }
+    }
 
-    std::unique_ptr<std::thread> avd_thread =
-        std::unique_ptr<std::thread>(new std::thread(sender_func, streams.avd, cbuf, V3C_AVD, fps, mmap.avd_units, std::ref(avd_r)));
+    // Sleep a moment to make sure that the receiver is ready
+    std::this_thread::sleep_for(std::chrono::milliseconds(90));
 
+    schedule_v3c_frames(release, frame_count, fps, nullptr);
 
-    if (ad_thread && ad_thread->joinable())
-    {
-        ad_thread->join();
-    }
-    if (ovd_thread && ovd_thread->joinable())
-    {
-        ovd_thread->join();
-    }
-    if (gvd_thread && gvd_thread->joinable())
-    {
-        gvd_thread->join();
+    for (auto& t : threads) {
+        if (t && t->joinable())
+        {
+            t->join();
+        }
     }
-    if (avd_thread && avd_thread->joinable())
-    {
-        avd_thread->join();
+    for (auto& object : substreams) {
+        destroy_v3c_substreams(sess, object);
     }
-    sess->destroy_stream(streams.ad);
-    sess->destroy_stream(streams.ovd);
-    sess->destroy_stream(streams.gvd);
-    sess->destroy_stream(streams.avd);
     rtp_ctx.destroy_session(sess);
 
-    // Calculate results
-    size_t total_bytes_sent = ad_r.bytes_sent + ovd_r.bytes_sent + gvd_r.bytes_sent + avd_r.bytes_sent;
+    // Calculate results. The result file gets the aggregate of all objects
+    size_t total_bytes_sent = 0;
+    uint64_t start = results.front().front().start;
+    uint64_t end   = results.front().front().end;
+
+    for (int o = 0; o < objects; ++o) {
+        size_t object_bytes_sent = 0;
+        uint64_t object_start = results.at(o).front().start;
+        uint64_t object_end   = results.at(o).front().end;
 
-    long long start = find_earliest_time_point(ad_r.start, ovd_r.start, gvd_r.start, avd_r.start);
-    long long end   = find_latest_time_point(ad_r.end, ovd_r.end, gvd_r.end, avd_r.end);
-    long long diff = end - start;
+        for (auto& r : results.at(o)) {
+            object_bytes_sent += r.bytes_sent;
+            object_start = std::min(object_start, r.start);
+            object_end   = std::max(object_end, r.end);
+        }
+        if (objects > 1) {
+            std::cout << "Object " << o << ": " << object_bytes_sent << " bytes in " << (object_end - object_start) / 1000
+                << " ms" << std::endl;
+        }
+
+        total_bytes_sent += object_bytes_sent;
+        start = std::min(start, object_start);
+        end   = std::max(end, object_end);
+    }
+    uint64_t diff = end - start;
 
-    write_send_results_to_file(result_file, total_bytes_sent, (uint64_t)diff);
+    write_send_results_to_file(result_file, total_bytes_sent, diff);
     
     return EXIT_SUCCESS;
 }
 
-void sender_func(uvgrtp::media_stream* stream, const char* cbuf, int fmt, float fps, const std::vector<v3c_unit_info> &units,
-    stream_results &res)
+bool load_v3c_input(const std::string& filename, v3c_input& input)
+{
+    size_t len = 0;
+    void* mem = get_mem(filename, len);
+    if (mem == nullptr) {
+        return false;
+    }
+    v3c_file_map mmap;
+
+    mmap_v3c_file((char*)mem, len, mmap);
+    input.cbuf = (char*)mem;
+
+    // Every sub-bitstream in the file (atlases, attributes, maps, PVD, CAD) is sent in its own media stream
+    input.units = get_v3c_substreams(mmap);
+    std::vector<const std::vector<v3c_unit_info>*> components = {};
+
+    for (auto& u : input.units) {
+        input.keys.push_back(u.first);
+        components.push_back(&u.second);
+    }
+
+    // NAL units of all sub-bitstreams are grouped into V3C frames and released on a common deadline
+    input.frames = group_v3c_frames(input.cbuf, components);
+    return true;
+}
+
+void sender_func(uvgrtp::media_stream* stream, const char* cbuf, float fps, const std::vector<v3c_frame> &frames,
+    size_t component, v3c_frame_release &release, stream_results &res)
 {
     stream->configure_ctx(RCC_FPS_NUMERATOR, fps);
     stream->configure_ctx(RCC_UDP_SND_BUF_SIZE, 40 * 1000 * 1000);
-    std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Wait a moment to make sure that the receiver is ready
 
-    uint64_t temp_nalu = 0;
-    uint64_t current_frame = 0;
-    uint64_t period = (uint64_t)((1000 / (double)fps) * 1000);
     uint8_t* bytes = (uint8_t*)cbuf;
     rtp_error_t ret = RTP_OK;
-    bool param_set = false; // For parameter set NAL units, special treatment
     /* Sending logic goes as follows:
-    -Check NAL unit type:
-     -Parameter set NAL units: DO NOT log time, send unit and immediately proceed to the next NAL unit.
-     -AD or OVD stream: Each frame is composed of a single NAL unit. Log time, send unit and wait for the remaining interval depending on frame rate
-     -GVD or AVD stream: Each frame is composed of 4 NAL units. Log send time of first one and send the remaining 3 as fast
-      as possible. Then wait for the interval. Note: The send times of the remaining 3 also get logged, but only the first one is currently used in
-      calculations, as it is the "start" of the frame. */
+    -The frame scheduler releases V3C frames at the given frame rate. A V3C frame contains all NAL units of
+     this component that belong to it, including parameter sets, so the component sends them as fast as possible
+     and then waits for the scheduler to release the next frame. */
 
     size_t bytes_sent = 0;
-    // start the sending test
-    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
-    res.start = get_current_time();
-
-    for (auto& p : units) {
-        for (auto i : p.nal_infos) {
-            param_set = false; // Check the type of this NAL unit
-            uint8_t nalu_t = (bytes[i.location] >> 1) & 0x3f;
-            if(fmt == V3C_AD && nalu_t > 35 ) { // Check if Atlas parameter set NAL unit 
-                param_set = true;
-            }
-            else if (nalu_t >= 32 && nalu_t <= 34) { // Check if video parameter set NAL unit 
-                param_set = true;
-            }
+
+    for (uint64_t f = 0; f < frames.size(); ++f) {
+        wait_for_v3c_frame(release, f);
+
+        // start the sending test
+        if (f == 0) {
+            res.start = get_current_time();
+        }
+
+        for (auto& i : frames.at(f).nals.at(component)) {
             if ((ret = stream->push_frame(bytes + i.location, i.size, RTP_NO_H26X_SCL)) != RTP_OK) {
                 std::cout << "Failed to send RTP frame!" << std::endl;
             }
             bytes_sent += i.size;
-            if(param_set) { // If this is a parameter set NALU, immediately send the next NAL unit
-                continue;
-            }
-            temp_nalu++; // temp_nalu used to count the temporary 4 NAL units that make up a GVD or AVD frame
-            if (fmt == V3C_GVD || fmt == V3C_AVD) { // If this is GVD or AVD stream, send 4 frames as fast as we can, then wait for frame interval
-                if(temp_nalu < 4) {
-                    continue;
-                }
-                temp_nalu = 0;
-                current_frame += 1;
-            }
-            else {
-                temp_nalu = 0;
-                current_frame += 1;
-            }
-            auto runtime = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
-            std::chrono::high_resolution_clock::now() - start).count();
-
-            // this enforces the fps restriction by waiting until it is time to send next frame
-            // if this was eliminated, the test would be just about sending as fast as possible.
-            // if the library falls behind, it is allowed to catch up if it can do it.
-            if (runtime < current_frame * period) {
-                std::this_thread::sleep_for(std::chrono::microseconds(current_frame * period - runtime));
-            }
         }
     }
     // here we take the time and see how long it actually
-    //auto end = std::chrono::high_resolution_clock::now();
     res.end = get_current_time();
     res.bytes_sent = bytes_sent;
-    //uint64_t diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-}
\ No newline at end of file
+}